@@ -94,12 +94,42 @@ static ncclResult_t setFilesLimit() {
   return ncclSuccess;
 }
 
+// Once all ranks have checked in, the root either sends each rank the address
+// of its ring neighbour (flat), or sends the whole address table to the first
+// ranks of a k-ary tree, and each rank forwards it to its own children. The
+// latter makes the fan-out logarithmic in the number of ranks, and gives every
+// rank the listen address of all peers without an extra AllGather.
+NCCL_PARAM(BootstrapTreeArity, "BOOTSTRAP_TREE_ARITY", -2);
+#define BOOTSTRAP_TREE_NRANKS_THRESHOLD 128
+#define BOOTSTRAP_TREE_DEFAULT_ARITY 8
+
+static int bootstrapTreeArity(int nranks) {
+  int arity = ncclParamBootstrapTreeArity();
+  if (arity == -2) arity = nranks > BOOTSTRAP_TREE_NRANKS_THRESHOLD ? BOOTSTRAP_TREE_DEFAULT_ARITY : 0;
+  return std::max(arity, 0);
+}
+
+// Children of rank r are (r+1)*arity ... (r+1)*arity+arity-1; the root sends to ranks 0 ... arity-1.
+static ncclResult_t bootstrapTreeForward(int first, int arity, int nranks, uint64_t magic, volatile uint32_t* abortFlag,
+    union ncclSocketAddress* rankAddressesRoot, union ncclSocketAddress* rankAddresses) {
+  for (int c=first; c<std::min(first+arity, nranks); c++) {
+    struct ncclSocket sock;
+    NCCLCHECK(ncclSocketInit(&sock, rankAddressesRoot+c, magic, ncclSocketTypeBootstrap, abortFlag));
+    NCCLCHECK(ncclSocketConnect(&sock));
+    NCCLCHECK(bootstrapNetSend(&sock, &arity, sizeof(int)));
+    NCCLCHECK(bootstrapNetSend(&sock, rankAddressesRoot, nranks*sizeof(union ncclSocketAddress)));
+    NCCLCHECK(bootstrapNetSend(&sock, rankAddresses, nranks*sizeof(union ncclSocketAddress)));
+    NCCLCHECK(ncclSocketClose(&sock));
+  }
+  return ncclSuccess;
+}
+
 static void *bootstrapRoot(void* rargs) {
   struct bootstrapRootArgs* args = (struct bootstrapRootArgs*)rargs;
   struct ncclSocket* listenSock = args->listenSock;
   uint64_t magic = args->magic;
   ncclResult_t res = ncclSuccess;
-  int nranks = 0, c = 0;
+  int nranks = 0, c = 0, arity;
   struct extInfo info;
   union ncclSocketAddress *rankAddresses = NULL;
   union ncclSocketAddress *rankAddressesRoot = NULL; // for initial rank <-> root information exchange
@@ -141,12 +171,21 @@ static void *bootstrapRoot(void* rargs) {
   } while (c < nranks);
   TRACE(NCCL_INIT, "COLLECTED ALL %d HANDLES", nranks);
 
+  arity = bootstrapTreeArity(nranks);
+  if (arity > 0) {
+    // Hand the address table to the top of the tree, ranks take care of the rest
+    NCCLCHECKGOTO(bootstrapTreeForward(0, arity, nranks, magic, NULL, rankAddressesRoot, rankAddresses), res, out);
+    TRACE(NCCL_INIT, "SENT OUT %d HANDLES TO %d RANKS", nranks, std::min(arity, nranks));
+    goto out;
+  }
+
   // Send the connect handle for the next rank in the AllGather ring
   for (int r=0; r<nranks; ++r) {
     int next = (r+1) % nranks;
     struct ncclSocket sock;
     NCCLCHECKGOTO(ncclSocketInit(&sock, rankAddressesRoot+r, magic, ncclSocketTypeBootstrap), res, out);
     NCCLCHECKGOTO(ncclSocketConnect(&sock), res, out);
+    NCCLCHECKGOTO(bootstrapNetSend(&sock, &arity, sizeof(int)), res, out);
     NCCLCHECKGOTO(bootstrapNetSend(&sock, rankAddresses+next, sizeof(union ncclSocketAddress)), res, out);
     NCCLCHECKGOTO(ncclSocketClose(&sock), res, out);
   }
@@ -204,20 +243,33 @@ ncclResult_t bootstrapGetUniqueId(struct ncclBootstrapHandle* handle) {
   return ncclSuccess;
 }
 
-struct unexConn {
+// Messages received from a peer while waiting for another tag, hashed on (peer, tag)
+struct unexMsg {
   int peer;
   int tag;
-  struct ncclSocket sock;
-  struct unexConn* next;
+  int size;
+  char* data;
+  struct unexMsg* next;
 };
+#define BOOTSTRAP_UNEX_BUCKETS 64
 
 struct bootstrapState {
   struct ncclSocket listenSock;
   struct ncclSocket ringRecvSocket;
   struct ncclSocket ringSendSocket;
+  int nSteps; // Number of AllGather steps using stepSendSockets/stepRecvSockets, 0 means ring AllGather
+  struct ncclSocket* stepSendSockets;
+  struct ncclSocket* stepRecvSockets;
   union ncclSocketAddress* peerCommAddresses;
   union ncclSocketAddress* peerProxyAddresses;
-  struct unexConn* unexpectedConnections;
+  struct unexMsg* unexpectedMessages[BOOTSTRAP_UNEX_BUCKETS];
+  int nUnexpectedMessages;
+  // bootstrapSend/bootstrapRecv keep one connection per peer and direction, opened on first use
+  struct ncclSocket** peerSendSockets;
+  struct ncclSocket** peerRecvSockets;
+  // bootstrapSend is called from the init thread and at runtime (p2p/proxy connection setup);
+  // serializes opening a send connection and writing a message on it
+  pthread_mutex_t sendLock;
   int cudaDev;
   int rank;
   int nranks;
@@ -225,6 +277,95 @@ struct bootstrapState {
   volatile uint32_t *abortFlag;
 };
 
+// AllGather algorithm. Recursive doubling is used when the number of ranks is a
+// power of two, Bruck otherwise, each taking ceil(log2(nranks)) steps instead of
+// nranks-1 for the ring. Each step uses its own persistent connections.
+NCCL_PARAM(BootstrapLogAllGather, "BOOTSTRAP_LOG_ALLGATHER", -2);
+#define BOOTSTRAP_LOG_ALLGATHER_NRANKS_THRESHOLD 8
+
+static int bootstrapAllGatherSteps(int nranks) {
+  int enable = ncclParamBootstrapLogAllGather();
+  if (enable == -2) enable = nranks >= BOOTSTRAP_LOG_ALLGATHER_NRANKS_THRESHOLD ? 1 : 0;
+  int nSteps = 0;
+  if (enable) while ((1 << nSteps) < nranks) nSteps++;
+  return nSteps;
+}
+
+static bool bootstrapPow2(int nranks) {
+  return (nranks & (nranks-1)) == 0;
+}
+
+// Peers we send to and receive from at a given AllGather step
+static int bootstrapStepSendPeer(struct bootstrapState* state, int step) {
+  int dist = 1 << step;
+  if (bootstrapPow2(state->nranks)) return state->rank ^ dist;
+  return (state->rank - dist + state->nranks) % state->nranks;
+}
+static int bootstrapStepRecvPeer(struct bootstrapState* state, int step) {
+  int dist = 1 << step;
+  if (bootstrapPow2(state->nranks)) return state->rank ^ dist;
+  return (state->rank + dist) % state->nranks;
+}
+
+// Connections start with the rank of the sender and the AllGather step they serve
+// (-1 for the ring, -2 for bootstrapSend), so that they can be told apart whatever
+// order they arrive in.
+static ncclResult_t bootstrapConnectPeer(struct bootstrapState* state, struct ncclSocket* sock, union ncclSocketAddress* addr, int step) {
+  int hdr[2] = { state->rank, step };
+  NCCLCHECK(ncclSocketInit(sock, addr, state->magic, ncclSocketTypeBootstrap, state->abortFlag));
+  NCCLCHECK(ncclSocketConnect(sock));
+  NCCLCHECK(bootstrapNetSend(sock, hdr, sizeof(hdr)));
+  return ncclSuccess;
+}
+
+static ncclResult_t bootstrapAcceptPeers(struct bootstrapState* state, int nConns) {
+  for (int c=0; c<nConns; c++) {
+    struct ncclSocket sock;
+    int hdr[2];
+    NCCLCHECK(ncclSocketInit(&sock));
+    NCCLCHECK(ncclSocketAccept(&sock, &state->listenSock));
+    NCCLCHECK(bootstrapNetRecv(&sock, hdr, sizeof(hdr)));
+    int step = hdr[1];
+    int expected = -1;
+    if (step == -1) expected = (state->rank - 1 + state->nranks) % state->nranks;
+    if (step >= 0 && step < state->nSteps) expected = bootstrapStepRecvPeer(state, step);
+    if (hdr[0] != expected) {
+      WARN("Bootstrap : rank %d received unexpected connection from rank %d for step %d", state->rank, hdr[0], step);
+      return ncclInternalError;
+    }
+    memcpy(step == -1 ? &state->ringRecvSocket : state->stepRecvSockets+step, &sock, sizeof(struct ncclSocket));
+  }
+  return ncclSuccess;
+}
+
+// Send and receive at the same time, so that two peers exchanging large messages don't deadlock
+static ncclResult_t bootstrapNetSendRecv(struct ncclSocket* sendSock, void* sendData, int sendSize, struct ncclSocket* recvSock, void* recvData, int recvSize) {
+  int recvSizeHdr = 0;
+  int sendHdrOffset = 0, sendOffset = 0, recvHdrOffset = 0, recvOffset = 0;
+  while (sendHdrOffset < sizeof(int) || sendOffset < sendSize || recvHdrOffset < sizeof(int) || recvOffset < recvSizeHdr) {
+    if (sendHdrOffset < sizeof(int)) {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_SEND, sendSock, &sendSize, sizeof(int), &sendHdrOffset));
+    } else if (sendOffset < sendSize) {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_SEND, sendSock, sendData, sendSize, &sendOffset));
+    }
+    if (recvHdrOffset < sizeof(int)) {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_RECV, recvSock, &recvSizeHdr, sizeof(int), &recvHdrOffset));
+      if (recvHdrOffset == sizeof(int) && recvSizeHdr > recvSize) {
+        WARN("Message truncated : received %d bytes instead of %d", recvSizeHdr, recvSize);
+        return ncclInternalError;
+      }
+    } else if (recvOffset < recvSizeHdr) {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_RECV, recvSock, recvData, recvSizeHdr, &recvOffset));
+    }
+  }
+  return ncclSuccess;
+}
+
+ncclResult_t bootstrapGetNetIfAddr(union ncclSocketAddress* addr) {
+  memcpy(addr, &bootstrapNetIfAddr, sizeof(union ncclSocketAddress));
+  return ncclSuccess;
+}
+
 ncclResult_t bootstrapInit(struct ncclBootstrapHandle* handle, struct ncclComm* comm) {
   int rank = comm->rank;
   int nranks = comm->nRanks;
@@ -233,13 +374,17 @@ ncclResult_t bootstrapInit(struct ncclBootstrapHandle* handle, struct ncclComm*
   ncclSocketAddress nextAddr;
   struct ncclSocket sock, listenSockRoot;
   struct extInfo info = { 0 };
+  int arity;
 
   NCCLCHECK(ncclCalloc(&state, 1));
+  pthread_mutex_init(&state->sendLock, NULL);
   state->rank = rank;
   state->nranks = nranks;
   state->abortFlag = comm->abortFlag;
   comm->bootstrap = state;
   comm->magic = state->magic = handle->magic;
+  NCCLCHECK(ncclCalloc(&state->peerSendSockets, nranks));
+  NCCLCHECK(ncclCalloc(&state->peerRecvSockets, nranks));
 
   TRACE(NCCL_INIT, "rank %d nranks %d", rank, nranks);
 
@@ -271,23 +416,49 @@ ncclResult_t bootstrapInit(struct ncclBootstrapHandle* handle, struct ncclComm*
   NCCLCHECK(bootstrapNetSend(&sock, &info, sizeof(info)));
   NCCLCHECK(ncclSocketClose(&sock));
 
-  // get info on my "next" rank in the bootstrap ring from root
+  // get info on my "next" rank in the bootstrap ring from root, or the whole address table from my parent in the tree
   NCCLCHECK(ncclSocketInit(&sock));
   NCCLCHECK(ncclSocketAccept(&sock, &listenSockRoot));
-  NCCLCHECK(bootstrapNetRecv(&sock, &nextAddr, sizeof(union ncclSocketAddress)));
-  NCCLCHECK(ncclSocketClose(&sock));
+  NCCLCHECK(bootstrapNetRecv(&sock, &arity, sizeof(int)));
+  if (arity > 0) {
+    union ncclSocketAddress* rankAddressesRoot;
+    NCCLCHECK(ncclCalloc(&rankAddressesRoot, nranks));
+    NCCLCHECK(ncclCalloc(&state->peerCommAddresses, nranks));
+    NCCLCHECK(bootstrapNetRecv(&sock, rankAddressesRoot, nranks*sizeof(union ncclSocketAddress)));
+    NCCLCHECK(bootstrapNetRecv(&sock, state->peerCommAddresses, nranks*sizeof(union ncclSocketAddress)));
+    NCCLCHECK(ncclSocketClose(&sock));
+    NCCLCHECK(bootstrapTreeForward((rank+1)*arity, arity, nranks, comm->magic, comm->abortFlag, rankAddressesRoot, state->peerCommAddresses));
+    free(rankAddressesRoot);
+    memcpy(&nextAddr, state->peerCommAddresses+(rank+1)%nranks, sizeof(union ncclSocketAddress));
+  } else {
+    NCCLCHECK(bootstrapNetRecv(&sock, &nextAddr, sizeof(union ncclSocketAddress)));
+    NCCLCHECK(ncclSocketClose(&sock));
+  }
   NCCLCHECK(ncclSocketClose(&listenSockRoot));
 
-  NCCLCHECK(ncclSocketInit(&state->ringSendSocket, &nextAddr, comm->magic, ncclSocketTypeBootstrap, comm->abortFlag));
-  NCCLCHECK(ncclSocketConnect(&state->ringSendSocket));
-  // Accept the connect request from the previous rank in the AllGather ring
-  NCCLCHECK(ncclSocketInit(&state->ringRecvSocket));
-  NCCLCHECK(ncclSocketAccept(&state->ringRecvSocket, &state->listenSock));
+  NCCLCHECK(bootstrapConnectPeer(state, &state->ringSendSocket, &nextAddr, -1));
+
+  // AllGather all listen handlers, unless they came with the tree
+  if (arity == 0) {
+    // Accept the connect request from the previous rank in the AllGather ring
+    NCCLCHECK(bootstrapAcceptPeers(state, 1));
+    NCCLCHECK(ncclCalloc(&state->peerCommAddresses, nranks));
+    NCCLCHECK(ncclSocketGetAddr(&state->listenSock, state->peerCommAddresses+rank));
+    NCCLCHECK(bootstrapAllGather(state, state->peerCommAddresses, sizeof(union ncclSocketAddress)));
+  }
 
-  // AllGather all listen handlers
-  NCCLCHECK(ncclCalloc(&state->peerCommAddresses, nranks));
-  NCCLCHECK(ncclSocketGetAddr(&state->listenSock, state->peerCommAddresses+rank));
-  NCCLCHECK(bootstrapAllGather(state, state->peerCommAddresses, sizeof(union ncclSocketAddress)));
+  // Connect to the peers of each AllGather step. No other connection can reach us until
+  // every rank is done here, since bootstrapAllGather is always the next operation.
+  int nSteps = bootstrapAllGatherSteps(nranks);
+  if (nSteps) {
+    NCCLCHECK(ncclCalloc(&state->stepSendSockets, nSteps));
+    NCCLCHECK(ncclCalloc(&state->stepRecvSockets, nSteps));
+  }
+  state->nSteps = nSteps;
+  for (int s=0; s<nSteps; s++) {
+    NCCLCHECK(bootstrapConnectPeer(state, state->stepSendSockets+s, state->peerCommAddresses+bootstrapStepSendPeer(state, s), s));
+  }
+  NCCLCHECK(bootstrapAcceptPeers(state, nSteps + (arity > 0 ? 1 : 0)));
 
   // Create the service proxy
   NCCLCHECK(ncclCalloc(&state->peerProxyAddresses, nranks));
@@ -305,6 +476,8 @@ ncclResult_t bootstrapInit(struct ncclBootstrapHandle* handle, struct ncclComm*
   return ncclSuccess;
 }
 
+static ncclResult_t bootstrapRingAllGather(struct bootstrapState* state, char* data, int size);
+
 ncclResult_t bootstrapAllGather(void* commState, void* allData, int size) {
   struct bootstrapState* state = (struct bootstrapState*)commState;
   char* data = (char*)allData;
@@ -313,6 +486,51 @@ ncclResult_t bootstrapAllGather(void* commState, void* allData, int size) {
 
   TRACE(NCCL_INIT, "rank %d nranks %d size %d", rank, nranks, size);
 
+  if (state->nSteps > 0 && bootstrapPow2(nranks)) {
+    /* Recursive doubling
+     * At step s we own the 2^s blocks of our group, and exchange them with
+     * the group of (rank ^ 2^s)
+     */
+    for (int s=0; s<state->nSteps; s++) {
+      int dist = 1 << s;
+      int peer = rank ^ dist;
+      size_t sslice = rank & ~(dist-1);
+      size_t rslice = peer & ~(dist-1);
+      NCCLCHECK(bootstrapNetSendRecv(state->stepSendSockets+s, data+sslice*size, dist*size,
+            state->stepRecvSockets+s, data+rslice*size, dist*size));
+    }
+  } else if (state->nSteps > 0) {
+    /* Bruck
+     * Block i of tmp holds the data of rank (rank+i). At step s we send the first
+     * 2^s blocks to (rank-2^s) and receive the next ones from (rank+2^s).
+     */
+    char* tmp;
+    NCCLCHECK(ncclCalloc(&tmp, (size_t)nranks*size));
+    memcpy(tmp, data+rank*size, size);
+    for (int s=0; s<state->nSteps; s++) {
+      int dist = 1 << s;
+      int count = std::min(dist, nranks-dist);
+      ncclResult_t ret = bootstrapNetSendRecv(state->stepSendSockets+s, tmp, count*size,
+            state->stepRecvSockets+s, tmp+(size_t)dist*size, count*size);
+      if (ret != ncclSuccess) {
+        free(tmp);
+        return ret;
+      }
+    }
+    for (int i=0; i<nranks; i++) memcpy(data+((rank+i)%nranks)*size, tmp+(size_t)i*size, size);
+    free(tmp);
+  } else {
+    NCCLCHECK(bootstrapRingAllGather(state, data, size));
+  }
+
+  TRACE(NCCL_INIT, "rank %d nranks %d size %d - DONE", rank, nranks, size);
+  return ncclSuccess;
+}
+
+static ncclResult_t bootstrapRingAllGather(struct bootstrapState* state, char* data, int size) {
+  int rank = state->rank;
+  int nranks = state->nranks;
+
   /* Simple ring based AllGather
    * At each step i receive data from (rank-i-1) from left
    * and send previous step's data from (rank-i) to right
@@ -326,27 +544,30 @@ ncclResult_t bootstrapAllGather(void* commState, void* allData, int size) {
     // Recv slice from the left
     NCCLCHECK(bootstrapNetRecv(&state->ringRecvSocket, data+rslice*size, size));
   }
-
-  TRACE(NCCL_INIT, "rank %d nranks %d size %d - DONE", rank, nranks, size);
   return ncclSuccess;
 }
 
 ncclResult_t bootstrapSend(void* commState, int peer, int tag, void* data, int size) {
-  ncclResult_t ret = ncclSuccess;
   struct bootstrapState* state = (struct bootstrapState*)commState;
-  struct ncclSocket sock;
-
-  NCCLCHECKGOTO(ncclSocketInit(&sock, state->peerCommAddresses+peer, state->magic, ncclSocketTypeBootstrap, state->abortFlag), ret, fail);
-  NCCLCHECKGOTO(ncclSocketConnect(&sock), ret, fail);
-  NCCLCHECKGOTO(bootstrapNetSend(&sock, &state->rank, sizeof(int)), ret, fail);
-  NCCLCHECKGOTO(bootstrapNetSend(&sock, &tag, sizeof(int)), ret, fail);
-  NCCLCHECKGOTO(bootstrapNetSend(&sock, data, size), ret, fail);
-
+  ncclResult_t ret = ncclSuccess;
+  pthread_mutex_lock(&state->sendLock);
+  struct ncclSocket* sock = state->peerSendSockets[peer];
+
+  if (sock == NULL) {
+    NCCLCHECKGOTO(ncclCalloc(&sock, 1), ret, exit);
+    ret = bootstrapConnectPeer(state, sock, state->peerCommAddresses+peer, -2);
+    if (ret != ncclSuccess) {
+      ncclSocketClose(sock);
+      free(sock);
+      goto exit;
+    }
+    state->peerSendSockets[peer] = sock;
+  }
+  NCCLCHECKGOTO(bootstrapNetSend(sock, &tag, sizeof(int)), ret, exit);
+  NCCLCHECKGOTO(bootstrapNetSend(sock, data, size), ret, exit);
 exit:
-  NCCLCHECK(ncclSocketClose(&sock));
+  pthread_mutex_unlock(&state->sendLock);
   return ret;
-fail:
-  goto exit;
 }
 
 ncclResult_t bootstrapBarrier(void* commState, int *ranks, int rank, int nranks, int tag) {
@@ -386,100 +607,145 @@ ncclResult_t bootstrapIntraNodeAllGather(void* commState, int *ranks, int rank,
   return ncclSuccess;
 }
 
-ncclResult_t unexpectedEnqueue(struct bootstrapState* state, int peer, int tag, struct ncclSocket* sock) {
+static int unexpectedBucket(int peer, int tag) {
+  uint32_t h = (uint32_t)peer * 0x9e3779b1 ^ (uint32_t)tag * 0x85ebca6b;
+  return (h ^ (h >> 16)) % BOOTSTRAP_UNEX_BUCKETS;
+}
+
+ncclResult_t unexpectedEnqueue(struct bootstrapState* state, int peer, int tag, char* data, int size) {
   // New unex
-  struct unexConn* unex;
+  struct unexMsg* unex;
   NCCLCHECK(ncclCalloc(&unex, 1));
   unex->peer = peer;
   unex->tag = tag;
-  memcpy(&unex->sock, sock, sizeof(struct ncclSocket));
-
-  // Enqueue
-  struct unexConn* list = state->unexpectedConnections;
-  if (list == NULL) {
-    state->unexpectedConnections = unex;
-    return ncclSuccess;
-  }
-  while (list->next) list = list->next;
-  list->next = unex;
+  unex->size = size;
+  unex->data = data;
+
+  // Enqueue, messages with the same peer and tag must be dequeued in order
+  struct unexMsg** list = state->unexpectedMessages+unexpectedBucket(peer, tag);
+  while (*list) list = &(*list)->next;
+  *list = unex;
+  state->nUnexpectedMessages++;
   return ncclSuccess;
 }
 
-ncclResult_t unexpectedDequeue(struct bootstrapState* state, int peer, int tag, struct ncclSocket* sock, int* found) {
-  struct unexConn* elem = state->unexpectedConnections;
-  struct unexConn* prev = NULL;
+ncclResult_t unexpectedDequeue(struct bootstrapState* state, int peer, int tag, void* data, int size, int* found) {
+  struct unexMsg** list = state->unexpectedMessages+unexpectedBucket(peer, tag);
   *found = 0;
-  while (elem) {
+  for (; *list; list = &(*list)->next) {
+    struct unexMsg* elem = *list;
     if (elem->peer == peer && elem->tag == tag) {
-      if (prev == NULL) {
-        state->unexpectedConnections = elem->next;
-      } else {
-        prev->next = elem->next;
+      *list = elem->next;
+      state->nUnexpectedMessages--;
+      if (elem->size > size) {
+        WARN("Message truncated : received %d bytes instead of %d", elem->size, size);
+        free(elem->data);
+        free(elem);
+        return ncclInternalError;
       }
-      memcpy(sock, &elem->sock, sizeof(struct ncclSocket));
+      memcpy(data, elem->data, elem->size);
+      free(elem->data);
       free(elem);
       *found = 1;
       return ncclSuccess;
     }
-    prev = elem;
-    elem = elem->next;
   }
   return ncclSuccess;
 }
 
 static void unexpectedFree(struct bootstrapState* state) {
-  struct unexConn* elem = state->unexpectedConnections;
-  struct unexConn* prev = NULL;
+  for (int b=0; b<BOOTSTRAP_UNEX_BUCKETS; b++) {
+    struct unexMsg* elem = state->unexpectedMessages[b];
+    while (elem) {
+      struct unexMsg* next = elem->next;
+      free(elem->data);
+      free(elem);
+      elem = next;
+    }
+    state->unexpectedMessages[b] = NULL;
+  }
+  state->nUnexpectedMessages = 0;
+}
 
-  while (elem) {
-    prev = elem;
-    elem = elem->next;
-    free(prev);
+// Accept connections until we have one from peer
+static ncclResult_t bootstrapAcceptSender(struct bootstrapState* state, int peer) {
+  while (state->peerRecvSockets[peer] == NULL) {
+    struct ncclSocket* sock;
+    int hdr[2];
+    NCCLCHECK(ncclCalloc(&sock, 1));
+    ncclResult_t ret = ncclSuccess;
+    NCCLCHECKGOTO(ncclSocketInit(sock), ret, fail);
+    NCCLCHECKGOTO(ncclSocketAccept(sock, &state->listenSock), ret, fail);
+    NCCLCHECKGOTO(bootstrapNetRecv(sock, hdr, sizeof(hdr)), ret, fail);
+    if (hdr[1] != -2 || hdr[0] < 0 || hdr[0] >= state->nranks || state->peerRecvSockets[hdr[0]] != NULL) {
+      WARN("Bootstrap : rank %d received unexpected connection from rank %d for step %d", state->rank, hdr[0], hdr[1]);
+      ret = ncclInternalError;
+      goto fail;
+    }
+    state->peerRecvSockets[hdr[0]] = sock;
+    continue;
+fail:
+    ncclSocketClose(sock);
+    free(sock);
+    return ret;
   }
-  return;
+  return ncclSuccess;
 }
 
-// We can't know who we'll receive from, so we need to receive everything at once
+// Messages from a peer arrive in order on its connection; keep those we're not waiting for yet
 ncclResult_t bootstrapRecv(void* commState, int peer, int tag, void* data, int size) {
-  ncclResult_t ret = ncclSuccess;
   struct bootstrapState* state = (struct bootstrapState*)commState;
-  struct ncclSocket sock;
-  int newPeer, newTag;
 
-  // Search unexpected connections first
+  // Search unexpected messages first
   int found;
-  NCCLCHECK(unexpectedDequeue(state, peer, tag, &sock, &found));
-  if (found) {
-    NCCLCHECKGOTO(bootstrapNetRecv(&sock, ((char*)data), size), ret, fail);
-    goto exit;
-  }
+  NCCLCHECK(unexpectedDequeue(state, peer, tag, data, size, &found));
+  if (found) return ncclSuccess;
 
-  // Then look for new connections
+  // Then read from the peer connection
+  NCCLCHECK(bootstrapAcceptSender(state, peer));
+  struct ncclSocket* sock = state->peerRecvSockets[peer];
   while (1) {
-    NCCLCHECKGOTO(ncclSocketInit(&sock), ret, fail);
-    NCCLCHECKGOTO(ncclSocketAccept(&sock, &state->listenSock), ret, fail);
-    NCCLCHECKGOTO(bootstrapNetRecv(&sock, &newPeer, sizeof(int)), ret, fail);
-    NCCLCHECKGOTO(bootstrapNetRecv(&sock, &newTag, sizeof(int)), ret, fail);
-    if (newPeer == peer && newTag == tag) {
-      NCCLCHECKGOTO(bootstrapNetRecv(&sock, ((char*)data), size), ret, fail);
-      goto exit;
+    int newTag, newSize;
+    NCCLCHECK(bootstrapNetRecv(sock, &newTag, sizeof(int)));
+    if (newTag == tag) {
+      NCCLCHECK(bootstrapNetRecv(sock, ((char*)data), size));
+      return ncclSuccess;
+    }
+    // Unexpected message. Save for later.
+    char* newData = NULL;
+    NCCLCHECK(ncclSocketRecv(sock, &newSize, sizeof(int)));
+    if (newSize > 0) NCCLCHECK(ncclCalloc(&newData, newSize));
+    ncclResult_t ret = ncclSocketRecv(sock, newData, newSize);
+    if (ret == ncclSuccess) ret = unexpectedEnqueue(state, peer, newTag, newData, newSize);
+    if (ret != ncclSuccess) {
+      free(newData);
+      return ret;
     }
-    // Unexpected connection. Save for later.
-    NCCLCHECKGOTO(unexpectedEnqueue(state, newPeer, newTag, &sock), ret, fail);
   }
-exit:
-  NCCLCHECK(ncclSocketClose(&sock));
-  return ret;
-fail:
-  goto exit;
+}
+
+static ncclResult_t bootstrapClosePeerSockets(struct bootstrapState* state) {
+  for (int p=0; p<state->nranks; p++) {
+    if (state->peerSendSockets && state->peerSendSockets[p]) {
+      NCCLCHECK(ncclSocketClose(state->peerSendSockets[p]));
+      free(state->peerSendSockets[p]);
+    }
+    if (state->peerRecvSockets && state->peerRecvSockets[p]) {
+      NCCLCHECK(ncclSocketClose(state->peerRecvSockets[p]));
+      free(state->peerRecvSockets[p]);
+    }
+  }
+  free(state->peerSendSockets);
+  free(state->peerRecvSockets);
+  return ncclSuccess;
 }
 
 ncclResult_t bootstrapClose(void* commState) {
   struct bootstrapState* state = (struct bootstrapState*)commState;
-  if (state->unexpectedConnections != NULL) {
+  if (state->nUnexpectedMessages != 0) {
     unexpectedFree(state);
     if (*state->abortFlag == 0) {
-      WARN("Unexpected connections are not empty");
+      WARN("Unexpected messages are not empty");
       return ncclInternalError;
     }
   }
@@ -487,8 +753,16 @@ ncclResult_t bootstrapClose(void* commState) {
   NCCLCHECK(ncclSocketClose(&state->listenSock));
   NCCLCHECK(ncclSocketClose(&state->ringSendSocket));
   NCCLCHECK(ncclSocketClose(&state->ringRecvSocket));
+  for (int s=0; s<state->nSteps; s++) {
+    NCCLCHECK(ncclSocketClose(state->stepSendSockets+s));
+    NCCLCHECK(ncclSocketClose(state->stepRecvSockets+s));
+  }
+  free(state->stepSendSockets);
+  free(state->stepRecvSockets);
+  NCCLCHECK(bootstrapClosePeerSockets(state));
 
   free(state->peerCommAddresses);
+  pthread_mutex_destroy(&state->sendLock);
   free(state);
 
   return ncclSuccess;
@@ -500,8 +774,16 @@ ncclResult_t bootstrapAbort(void* commState) {
   NCCLCHECK(ncclSocketClose(&state->listenSock));
   NCCLCHECK(ncclSocketClose(&state->ringSendSocket));
   NCCLCHECK(ncclSocketClose(&state->ringRecvSocket));
+  for (int s=0; s<state->nSteps; s++) {
+    NCCLCHECK(ncclSocketClose(state->stepSendSockets+s));
+    NCCLCHECK(ncclSocketClose(state->stepRecvSockets+s));
+  }
+  free(state->stepSendSockets);
+  free(state->stepRecvSockets);
+  NCCLCHECK(bootstrapClosePeerSockets(state));
   free(state->peerCommAddresses);
   free(state->peerProxyAddresses);
+  pthread_mutex_destroy(&state->sendLock);
   free(state);
   return ncclSuccess;
 }
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
 
 int ncclDebugLevel = -1;
 static int pid = -1;
@@ -22,6 +23,190 @@ std::chrono::steady_clock::time_point ncclEpoch;
 
 static __thread int tid = -1;
 
+#define NCCL_DEBUG_LINE_SIZE 1024
+
+/* Asynchronous logging, enabled with NCCL_DEBUG_ASYNC=1
+ * Each logging thread formats its messages into a ring of its own, with a single
+ * producer and a single consumer, so logging takes no lock. A background thread
+ * drains all rings into the debug file with writev. Messages logged while the ring
+ * of a thread is full are dropped and counted, except warnings which drain the rings
+ * synchronously. Rings of exited threads are reused. The CUDA device printed is the
+ * one current at the first message of each thread, to keep cudaGetDevice off the
+ * logging path.
+ */
+#define NCCL_DEBUG_ASYNC_SLOTS 512
+#define NCCL_DEBUG_ASYNC_BATCH 64
+#define NCCL_DEBUG_ASYNC_PERIOD_MS 10
+
+struct ncclDebugRing {
+  struct ncclDebugRing* next; // Rings are never freed nor removed from the list
+  int owned;
+  int tid;
+  alignas(64) uint64_t head; // Written by the owner
+  alignas(64) uint64_t tail; // Written by the drain
+  uint64_t dropped;
+  int len[NCCL_DEBUG_ASYNC_SLOTS];
+  char slots[NCCL_DEBUG_ASYNC_SLOTS][NCCL_DEBUG_LINE_SIZE];
+};
+
+static int debugAsync = 0;
+static struct ncclDebugRing* debugRings = nullptr;
+static __thread struct ncclDebugRing* debugRing = nullptr;
+static __thread int debugCudaDev = -1;
+static pthread_key_t debugRingKey;
+static pthread_t debugWriter;
+// Serializes draining, between the writer thread and ncclDebugFlush
+static pthread_mutex_t debugDrainLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t debugDrainCond = PTHREAD_COND_INITIALIZER;
+
+static void debugRingRelease(void* ring) {
+  __atomic_store_n(&((struct ncclDebugRing*)ring)->owned, 0, __ATOMIC_RELEASE);
+}
+
+static struct ncclDebugRing* debugRingGet() {
+  if (debugRing) return debugRing;
+  struct ncclDebugRing* ring;
+  for (ring = __atomic_load_n(&debugRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+    int unowned = 0;
+    if (__atomic_compare_exchange_n(&ring->owned, &unowned, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+  }
+  if (ring == nullptr) {
+    void* mem;
+    if (posix_memalign(&mem, 64, sizeof(struct ncclDebugRing)) != 0) return nullptr;
+    ring = (struct ncclDebugRing*)mem;
+    memset(ring, 0, sizeof(struct ncclDebugRing));
+    ring->owned = 1;
+    ring->next = __atomic_load_n(&debugRings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&debugRings, &ring->next, ring, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+  __atomic_store_n(&ring->tid, tid, __ATOMIC_RELAXED);
+  pthread_setspecific(debugRingKey, ring);
+  debugRing = ring;
+  return ring;
+}
+
+// Returns nullptr if the ring is full
+static char* debugRingReserve(struct ncclDebugRing* ring) {
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  if (ring->head - tail == NCCL_DEBUG_ASYNC_SLOTS) return nullptr;
+  return ring->slots[ring->head % NCCL_DEBUG_ASYNC_SLOTS];
+}
+
+static void debugRingCommit(struct ncclDebugRing* ring, int len, bool urgent) {
+  ring->len[ring->head % NCCL_DEBUG_ASYNC_SLOTS] = len;
+  __atomic_store_n(&ring->head, ring->head+1, __ATOMIC_RELEASE);
+  // Don't wait for the next period if the ring is filling up or on warnings
+  if (urgent || ring->head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) >= NCCL_DEBUG_ASYNC_SLOTS/2) {
+    pthread_cond_signal(&debugDrainCond);
+  }
+}
+
+static void debugWriteAll(int fd, struct iovec* iov, int n) {
+  while (n > 0) {
+    ssize_t written = writev(fd, iov, n);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return; // Nowhere to report it
+    }
+    while (n > 0 && (size_t)written >= iov->iov_len) { written -= iov->iov_len; iov++; n--; }
+    if (n > 0) {
+      iov->iov_base = (char*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+struct ncclDebugBatch {
+  struct iovec iov[NCCL_DEBUG_ASYNC_BATCH];
+  int nIov;
+  // Tails to publish once written
+  struct ncclDebugRing* rings[NCCL_DEBUG_ASYNC_BATCH];
+  uint64_t tails[NCCL_DEBUG_ASYNC_BATCH];
+  int nRings;
+};
+
+static void debugBatchWrite(int fd, struct ncclDebugBatch* batch) {
+  debugWriteAll(fd, batch->iov, batch->nIov);
+  for (int r=0; r<batch->nRings; r++) __atomic_store_n(&batch->rings[r]->tail, batch->tails[r], __ATOMIC_RELEASE);
+  batch->nIov = batch->nRings = 0;
+}
+
+// Caller holds debugDrainLock
+static void debugDrainLocked() {
+  int fd = fileno(ncclDebugFile);
+  struct ncclDebugBatch batch;
+  batch.nIov = batch.nRings = 0;
+  for (struct ncclDebugRing* ring = __atomic_load_n(&debugRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+    uint64_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    if (dropped) {
+      char note[NCCL_DEBUG_LINE_SIZE];
+      int len = snprintf(note, sizeof(note), "%s:%d:%d NCCL WARN Dropped %lu log messages, logging is too slow\n",
+          hostname, pid, __atomic_load_n(&ring->tid, __ATOMIC_RELAXED), dropped);
+      struct iovec iov = { note, (size_t)std::min(len, (int)sizeof(note)-1) };
+      debugWriteAll(fd, &iov, 1);
+    }
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = ring->tail;
+    while (tail < head) {
+      int slot = tail % NCCL_DEBUG_ASYNC_SLOTS;
+      batch.iov[batch.nIov].iov_base = ring->slots[slot];
+      batch.iov[batch.nIov].iov_len = ring->len[slot];
+      batch.nIov++;
+      tail++;
+      if (batch.nIov == NCCL_DEBUG_ASYNC_BATCH) {
+        batch.rings[batch.nRings] = ring;
+        batch.tails[batch.nRings++] = tail;
+        debugBatchWrite(fd, &batch);
+      }
+    }
+    if (batch.nIov && (batch.nRings == 0 || batch.rings[batch.nRings-1] != ring)) {
+      batch.rings[batch.nRings] = ring;
+      batch.tails[batch.nRings++] = tail;
+    }
+  }
+  if (batch.nIov) debugBatchWrite(fd, &batch);
+}
+
+static void* debugWriterMain(void* arg) {
+  ncclSetThreadName(pthread_self(), "NCCL Logger");
+  pthread_mutex_lock(&debugDrainLock);
+  while (1) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += NCCL_DEBUG_ASYNC_PERIOD_MS*1000000L;
+    if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+    pthread_cond_timedwait(&debugDrainCond, &debugDrainLock, &ts);
+    debugDrainLocked();
+  }
+  return nullptr;
+}
+
+void ncclDebugFlush() {
+  if (__atomic_load_n(&debugAsync, __ATOMIC_ACQUIRE) == 0) return;
+  pthread_mutex_lock(&debugDrainLock);
+  debugDrainLocked();
+  pthread_mutex_unlock(&debugDrainLock);
+}
+
+// Used when the thread could not get a ring. Goes through the same file descriptor as
+// the drain, after it, so that lines are not reordered by stdio buffering.
+static void debugWriteDirect(char* buffer, int len) {
+  pthread_mutex_lock(&debugDrainLock);
+  debugDrainLocked();
+  struct iovec iov = { buffer, (size_t)len };
+  debugWriteAll(fileno(ncclDebugFile), &iov, 1);
+  pthread_mutex_unlock(&debugDrainLock);
+}
+
+// Called with ncclDebugLock held
+static void debugAsyncInit() {
+  if (pthread_key_create(&debugRingKey, debugRingRelease) != 0) return;
+  if (pthread_create(&debugWriter, nullptr, debugWriterMain, nullptr) != 0) return;
+  pthread_detach(debugWriter);
+  atexit(ncclDebugFlush);
+  __atomic_store_n(&debugAsync, 1, __ATOMIC_RELEASE);
+}
+
 void ncclDebugInit() {
   pthread_mutex_lock(&ncclDebugLock);
   if (ncclDebugLevel != -1) { pthread_mutex_unlock(&ncclDebugLock); return; }
@@ -129,6 +314,11 @@ void ncclDebugInit() {
     }
   }
 
+  const char* ncclDebugAsyncEnv = getenv("NCCL_DEBUG_ASYNC");
+  if (tempNcclDebugLevel > NCCL_LOG_VERSION && ncclDebugAsyncEnv != NULL && atoi(ncclDebugAsyncEnv) == 1) {
+    debugAsyncInit();
+  }
+
   ncclEpoch = std::chrono::steady_clock::now();
   __atomic_store_n(&ncclDebugLevel, tempNcclDebugLevel, __ATOMIC_RELEASE);
   pthread_mutex_unlock(&ncclDebugLock);
@@ -159,32 +349,56 @@ void ncclDebugLog(ncclDebugLogLevel level, unsigned long flags, const char *file
 
   int cudaDev;
   if (!(level == NCCL_LOG_TRACE && flags == NCCL_CALL)) {
-    cudaGetDevice(&cudaDev);
+    if (debugAsync) {
+      if (debugCudaDev == -1) cudaGetDevice(&debugCudaDev);
+      cudaDev = debugCudaDev;
+    } else {
+      cudaGetDevice(&cudaDev);
+    }
+  }
+
+  char stackBuffer[NCCL_DEBUG_LINE_SIZE];
+  char* buffer = stackBuffer;
+  struct ncclDebugRing* ring = nullptr;
+  if (debugAsync && (ring = debugRingGet()) != nullptr) {
+    buffer = debugRingReserve(ring);
+    // Warnings are never dropped, make room for them
+    if (buffer == nullptr && level == NCCL_LOG_WARN) {
+      ncclDebugFlush();
+      buffer = debugRingReserve(ring);
+    }
+    if (buffer == nullptr) {
+      __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
   }
 
-  char buffer[1024];
   size_t len = 0;
   if (level == NCCL_LOG_WARN) {
-    len = snprintf(buffer, sizeof(buffer), "\n%s:%d:%d [%d] %s:%d NCCL WARN ",
+    len = snprintf(buffer, NCCL_DEBUG_LINE_SIZE, "\n%s:%d:%d [%d] %s:%d NCCL WARN ",
                    hostname, pid, tid, cudaDev, filefunc, line);
   } else if (level == NCCL_LOG_INFO) {
-    len = snprintf(buffer, sizeof(buffer), "%s:%d:%d [%d] NCCL INFO ", hostname, pid, tid, cudaDev);
+    len = snprintf(buffer, NCCL_DEBUG_LINE_SIZE, "%s:%d:%d [%d] NCCL INFO ", hostname, pid, tid, cudaDev);
   } else if (level == NCCL_LOG_TRACE && flags == NCCL_CALL) {
-    len = snprintf(buffer, sizeof(buffer), "%s:%d:%d NCCL CALL ", hostname, pid, tid);
+    len = snprintf(buffer, NCCL_DEBUG_LINE_SIZE, "%s:%d:%d NCCL CALL ", hostname, pid, tid);
   } else if (level == NCCL_LOG_TRACE) {
     auto delta = std::chrono::steady_clock::now() - ncclEpoch;
     double timestamp = std::chrono::duration_cast<std::chrono::duration<double>>(delta).count()*1000;
-    len = snprintf(buffer, sizeof(buffer), "%s:%d:%d [%d] %f %s:%d NCCL TRACE ",
+    len = snprintf(buffer, NCCL_DEBUG_LINE_SIZE, "%s:%d:%d [%d] %f %s:%d NCCL TRACE ",
                    hostname, pid, tid, cudaDev, timestamp, filefunc, line);
   }
 
   if (len) {
     va_list vargs;
     va_start(vargs, fmt);
-    len += vsnprintf(buffer+len, sizeof(buffer)-len, fmt, vargs);
+    len += vsnprintf(buffer+len, NCCL_DEBUG_LINE_SIZE-len, fmt, vargs);
     va_end(vargs);
+    // Truncated message
+    if (len > NCCL_DEBUG_LINE_SIZE-1) len = NCCL_DEBUG_LINE_SIZE-1;
     buffer[len++] = '\n';
-    fwrite(buffer, 1, len, ncclDebugFile);
+    if (ring) debugRingCommit(ring, len, level == NCCL_LOG_WARN);
+    else if (debugAsync) debugWriteDirect(buffer, len);
+    else fwrite(buffer, 1, len, ncclDebugFile);
   }
 }
 
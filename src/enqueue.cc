@@ -11,6 +11,7 @@
 #include "bootstrap.h"
 #include "channel.h"
 #include "cudawrap.h"
+#include "autotune.h"
 
 #include <cstring> // std::memcpy
 #include <cinttypes> // PRIx64
@@ -232,6 +233,283 @@ static void appendWorkElemP2p(
   ncclIntruQueueEnqueue(&chan->workQueue, q);
 }
 
+/*****************************************************************************/
+/*  Plan cache : replay the plan of a group of collectives seen before       */
+/*****************************************************************************/
+
+// Number of groups whose plan is kept. Groups made only of collectives, which
+// fit in one non-persistent plan, are looked up by their tasks; on a hit the
+// work and proxy ops are copied from the cache and only the buffers are patched.
+NCCL_PARAM(PlanCacheSize, "PLAN_CACHE_SIZE", 0);
+
+// Everything the plan of a task depends on, except for its buffers.
+struct ncclPlanCacheTask {
+  ncclFunc_t func;
+  ncclDataType_t datatype;
+  ncclDevRedOpFull op;
+  size_t count;
+  int root;
+  int chunkSteps, sliceSteps;
+};
+
+struct ncclPlanCacheEntry {
+  uint64_t hash;
+  uint64_t lastUse; // 0 if the entry is free
+  uint64_t tuningVersion;
+  int nTasks;
+  struct ncclPlanCacheTask* tasks;
+
+  // Plan, as built by scheduleCollTasksToPlan() and finishPlan()
+  bool kernelSpecialized;
+  void* kernelFn;
+  int channelUbound;
+  int channelCount;
+  uint64_t channelMask;
+  bool hasProxyOps;
+  int threadPerBlock;
+  int collOpCount;
+  bool tuneValid;
+  int tuneCoef, tuneBucket;
+  float tuneLatTime, tuneBwTime;
+  struct {
+    int nWork, nWorkElem, nProxyOps;
+    size_t collBytes;
+  } channels[MAXCHANNELS];
+  int nWorks, nProxyOps;
+  struct ncclWork* works; // Work of channel 0, then channel 1, ...
+  int* workTasks; // [nWorks*NCCL_MAX_WORK_ELEMENTS] task of each element, -1 if unused
+  struct ncclProxyOp* proxyOps;
+};
+
+struct ncclPlanCache {
+  int size;
+  uint64_t uses;
+  struct ncclPlanCacheEntry* entries;
+  // Group being scheduled. Tasks are in comm->memScoped.
+  bool recording;
+  uint64_t hash;
+  int nTasks;
+  struct ncclPlanCacheTask* tasks;
+  struct ncclTaskColl** taskPtrs;
+  // Task of each work element added while recording, in order
+  int* recChannels;
+  int* recTasks;
+  int nRec, maxRec;
+};
+
+static void planCacheFreeEntry(struct ncclPlanCacheEntry* entry) {
+  free(entry->tasks);
+  free(entry->works);
+  free(entry->workTasks);
+  free(entry->proxyOps);
+  memset(entry, 0, sizeof(*entry));
+}
+
+ncclResult_t ncclPlanCacheFree(struct ncclComm* comm) {
+  struct ncclPlanCache* cache = comm->planCache;
+  if (cache == nullptr) return ncclSuccess;
+  for (int i=0; i < cache->size; i++) planCacheFreeEntry(cache->entries+i);
+  free(cache->entries);
+  free(cache->recChannels);
+  free(cache->recTasks);
+  free(cache);
+  comm->planCache = nullptr;
+  return ncclSuccess;
+}
+
+static ncclResult_t planCacheRecord(struct ncclPlanCache* cache, int channelId, int task) {
+  if (cache->nRec == cache->maxRec) {
+    int maxRec = std::max(2*cache->maxRec, 64);
+    NCCLCHECK(ncclRealloc(&cache->recChannels, cache->maxRec, maxRec));
+    NCCLCHECK(ncclRealloc(&cache->recTasks, cache->maxRec, maxRec));
+    cache->maxRec = maxRec;
+  }
+  cache->recChannels[cache->nRec] = channelId;
+  cache->recTasks[cache->nRec] = task;
+  cache->nRec++;
+  return ncclSuccess;
+}
+
+// Computes the signature of the pending collectives and looks it up. Returns the
+// entry to replay, or nullptr after setting up the recording of the new plan.
+static ncclResult_t planCacheLookup(struct ncclComm* comm, struct ncclPlanCacheEntry** hit) {
+  struct ncclTasks* tasks = &comm->tasks;
+  struct ncclPlanCache* cache = comm->planCache;
+  *hit = nullptr;
+  if (cache == nullptr) {
+    NCCLCHECK(ncclCalloc(&cache, 1));
+    cache->size = ncclParamPlanCacheSize();
+    ncclResult_t ret = ncclCalloc(&cache->entries, cache->size);
+    if (ret != ncclSuccess) {
+      free(cache);
+      return ret;
+    }
+    comm->planCache = cache;
+  }
+  cache->recording = false;
+  int nTasks = tasks->nTasksColl;
+  cache->nTasks = nTasks;
+  cache->tasks = ncclMemoryStackAlloc<struct ncclPlanCacheTask>(&comm->memScoped, nTasks);
+  cache->taskPtrs = ncclMemoryStackAlloc<struct ncclTaskColl*>(&comm->memScoped, nTasks);
+  int t = 0;
+  for (struct ncclTaskColl* task = ncclIntruQueueHead(&tasks->collQueue); task != nullptr; task = task->next, t++) {
+    // Signatures are zeroed by the allocation and filled field by field, so that
+    // padding does not get in the way of hashing and memcmp.
+    struct ncclPlanCacheTask* sig = cache->tasks+t;
+    sig->func = task->func;
+    sig->datatype = task->datatype;
+    sig->op.op = task->op.op;
+    sig->op.scalarArgIsPtr = task->op.scalarArgIsPtr;
+    sig->op.scalarArg = task->op.scalarArg;
+    sig->count = task->count;
+    sig->root = task->root;
+    sig->chunkSteps = task->chunkSteps;
+    sig->sliceSteps = task->sliceSteps;
+    cache->taskPtrs[t] = task;
+  }
+  cache->hash = getHash((const char*)cache->tasks, nTasks*sizeof(struct ncclPlanCacheTask));
+
+  for (int i=0; i < cache->size; i++) {
+    struct ncclPlanCacheEntry* entry = cache->entries+i;
+    if (entry->lastUse == 0 || entry->hash != cache->hash || entry->nTasks != nTasks) continue;
+    if (memcmp(entry->tasks, cache->tasks, nTasks*sizeof(struct ncclPlanCacheTask)) != 0) continue;
+    if (entry->tuningVersion != comm->tuningVersion) {
+      // Algorithms were chosen from stale tuning tables
+      planCacheFreeEntry(entry);
+      break;
+    }
+    entry->lastUse = ++cache->uses;
+    *hit = entry;
+    return ncclSuccess;
+  }
+  cache->recording = true;
+  cache->nRec = 0;
+  return ncclSuccess;
+}
+
+static ncclResult_t planCacheReplay(struct ncclComm* comm, struct ncclPlanCacheEntry* entry, struct ncclKernelPlan* plan) {
+  struct ncclTasks* tasks = &comm->tasks;
+  struct ncclTaskColl** taskPtrs = comm->planCache->taskPtrs;
+  plan->kernelSpecialized = entry->kernelSpecialized;
+  plan->kernelFn = entry->kernelFn;
+  plan->channelUbound = entry->channelUbound;
+  plan->channelCount = entry->channelCount;
+  plan->channelMask = entry->channelMask;
+  plan->hasProxyOps = entry->hasProxyOps;
+  plan->threadPerBlock = entry->threadPerBlock;
+  plan->collOpCount = entry->collOpCount;
+  plan->tuneValid = entry->tuneValid;
+  plan->tuneCoef = entry->tuneCoef;
+  plan->tuneBucket = entry->tuneBucket;
+  plan->tuneLatTime = entry->tuneLatTime;
+  plan->tuneBwTime = entry->tuneBwTime;
+  int w = 0, o = 0;
+  for (int c=0; c < entry->channelUbound; c++) {
+    struct ncclKernelPlan::Channel* chan = &plan->channels[c];
+    chan->nWork = entry->channels[c].nWork;
+    chan->nWorkElem = entry->channels[c].nWorkElem;
+    chan->collBytes = entry->channels[c].collBytes;
+    for (int i=0; i < entry->channels[c].nWork; i++, w++) {
+      struct ncclWorkList* q = ncclMemoryStackAlloc<struct ncclWorkList>(&comm->memScoped);
+      q->work = entry->works[w]; // C++ struct assignment
+      for (int e=0; e < NCCL_MAX_WORK_ELEMENTS; e++) {
+        int t = entry->workTasks[w*NCCL_MAX_WORK_ELEMENTS+e];
+        if (t == -1) continue;
+        q->work.elems[e].sendbuff = taskPtrs[t]->sendbuff;
+        q->work.elems[e].recvbuff = taskPtrs[t]->recvbuff;
+      }
+      ncclIntruQueueEnqueue(&chan->workQueue, q);
+    }
+    for (int i=0; i < entry->channels[c].nProxyOps; i++, o++) {
+      struct ncclProxyOp* q = ncclMemoryPoolAlloc<struct ncclProxyOp>(&comm->memPool_ncclProxyOp, &comm->memPermanent);
+      *q = entry->proxyOps[o]; // C++ struct assignment
+      ncclIntruQueueEnqueue(&chan->proxyOpQueue, q);
+    }
+  }
+  // All tasks are scheduled
+  ncclIntruQueueConstruct(&tasks->collQueue);
+  tasks->nTasksColl = 0;
+  tasks->collBytesTotal = 0;
+  return ncclSuccess;
+}
+
+// Keeps the plan just built for the group being recorded, evicting the least recently used entry.
+static ncclResult_t planCacheStore(struct ncclComm* comm, struct ncclKernelPlan* plan) {
+  struct ncclPlanCache* cache = comm->planCache;
+  struct ncclPlanCacheEntry* entry = cache->entries;
+  for (int i=1; i < cache->size; i++) {
+    if (cache->entries[i].lastUse < entry->lastUse) entry = cache->entries+i;
+  }
+  planCacheFreeEntry(entry);
+
+  int nWorks = 0, nProxyOps = 0;
+  for (int c=0; c < plan->channelUbound; c++) {
+    nWorks += plan->channels[c].nWork;
+    for (struct ncclProxyOp* q = ncclIntruQueueHead(&plan->channels[c].proxyOpQueue); q != nullptr; q = q->enqNext) nProxyOps++;
+  }
+  ncclResult_t ret = ncclSuccess;
+  NCCLCHECKGOTO(ncclCalloc(&entry->tasks, cache->nTasks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&entry->works, nWorks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&entry->workTasks, nWorks*NCCL_MAX_WORK_ELEMENTS), ret, fail);
+  if (nProxyOps) NCCLCHECKGOTO(ncclCalloc(&entry->proxyOps, nProxyOps), ret, fail);
+  memcpy(entry->tasks, cache->tasks, cache->nTasks*sizeof(struct ncclPlanCacheTask));
+  entry->nTasks = cache->nTasks;
+  entry->hash = cache->hash;
+  entry->tuningVersion = comm->tuningVersion;
+  entry->kernelSpecialized = plan->kernelSpecialized;
+  entry->kernelFn = plan->kernelFn;
+  entry->channelUbound = plan->channelUbound;
+  entry->channelCount = plan->channelCount;
+  entry->channelMask = plan->channelMask;
+  entry->hasProxyOps = plan->hasProxyOps;
+  entry->threadPerBlock = plan->threadPerBlock;
+  entry->collOpCount = plan->collOpCount;
+  entry->tuneValid = plan->tuneValid;
+  entry->tuneCoef = plan->tuneCoef;
+  entry->tuneBucket = plan->tuneBucket;
+  entry->tuneLatTime = plan->tuneLatTime;
+  entry->tuneBwTime = plan->tuneBwTime;
+  entry->nWorks = nWorks;
+  entry->nProxyOps = nProxyOps;
+  {
+    int w = 0, o = 0;
+    for (int c=0; c < plan->channelUbound; c++) {
+      struct ncclKernelPlan::Channel* chan = &plan->channels[c];
+      entry->channels[c].nWork = chan->nWork;
+      entry->channels[c].nWorkElem = chan->nWorkElem;
+      entry->channels[c].collBytes = chan->collBytes;
+      // Elements were recorded in the order they were appended to their channel
+      int r = 0;
+      for (struct ncclWorkList* q = ncclIntruQueueHead(&chan->workQueue); q != nullptr; q = q->next, w++) {
+        entry->works[w] = q->work; // C++ struct assignment
+        for (int e=0; e < NCCL_MAX_WORK_ELEMENTS; e++) {
+          int t = -1;
+          if (q->work.elems[e].isUsed) {
+            while (r < cache->nRec && cache->recChannels[r] != c) r++;
+            if (r == cache->nRec) {
+              INFO(NCCL_COLL, "Plan cache : work element without a task on channel %d", c);
+              ret = ncclInternalError;
+              goto fail;
+            }
+            t = cache->recTasks[r++];
+          }
+          entry->workTasks[w*NCCL_MAX_WORK_ELEMENTS+e] = t;
+        }
+      }
+      for (struct ncclProxyOp* q = ncclIntruQueueHead(&chan->proxyOpQueue); q != nullptr; q = q->enqNext, o++) {
+        entry->proxyOps[o] = *q; // C++ struct assignment
+        entry->proxyOps[o].enqNext = nullptr;
+        entry->channels[c].nProxyOps++;
+      }
+    }
+  }
+  entry->lastUse = ++cache->uses;
+  return ncclSuccess;
+fail:
+  planCacheFreeEntry(entry);
+  return ret;
+}
+
 static ncclResult_t addProxyOpIfNeeded(struct ncclComm* comm, struct ncclKernelPlan* plan, struct ncclProxyOp* op) {
   bool needed = true;
   NCCLCHECK(ncclProxySaveOp(comm, op, &needed));
@@ -295,6 +573,7 @@ static ncclResult_t addCollToPlan(
     *nWorkBudget += chans[c].nWork;
     if (!regBufUsed) {
       appendWorkElemColl(comm, plan, c, funcIndex, workElem, bid);
+      if (comm->planCache && comm->planCache->recording) NCCLCHECK(planCacheRecord(comm->planCache, c, opCount>>1));
     } else {
       // Buffer registration in play which could only for CollNet at the moment.
       struct ncclChannel* channel = &comm->channels[c];
@@ -464,7 +743,6 @@ fallback:
 NCCL_PARAM(GraphRegister, "GRAPH_REGISTER", 0);
 
 static ncclResult_t getCollNetSupport(struct ncclInfo* info, int* collNetTypeSupport);
-static ncclResult_t getAlgoInfo(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps);
 
 static ncclResult_t scheduleCollTasksToPlan(
     struct ncclComm* comm, struct ncclKernelPlan* plan, int* nWorkBudget
@@ -523,7 +801,7 @@ static ncclResult_t scheduleCollTasksToPlan(
       NCCLCHECK(ncclInfoSetDerived(&aggInfo, comm->nRanks));
       aggInfo.nChannels = std::min(comm->nChannels, nAggChannels);
       int opPerChannel = DIVUP(nAggChannels, aggInfo.nChannels);
-      NCCLCHECK(getAlgoInfo(&aggInfo, collNetSupport, opPerChannel));
+      NCCLCHECK(ncclTopoGetAlgoInfo(&aggInfo, collNetSupport, opPerChannel));
     }
 
     while (head != aggEnd) {
@@ -567,6 +845,7 @@ static ncclResult_t scheduleCollTasksToPlan(
 
       NCCLCHECK(addCollToPlan(comm, plan, nWorkBudget, workFuncIndex, &workElem, &proxyOp,
         info.nChannels, info.nBytes, regBufUsed, regBufSend, regBufRecv));
+      if (comm->autotune) NCCLCHECK(ncclAutotuneSchedule(comm, plan, &info, nAggOps));
       tasks->nTasksColl -= 1;
       tasks->collBytesTotal -= info.nBytes;
       ncclIntruQueueDequeue(&tasks->collQueue);
@@ -600,7 +879,12 @@ static ncclResult_t scheduleP2pTasksToPlan(
   struct ncclTasks::Peer* peers = tasks->peers;
   int const *sendOrder = tasks->p2pSendOrder;
   int const *recvOrder = tasks->p2pRecvOrder;
+  int* steps = tasks->p2pSteps;
+
+  // Visit the steps with work in schedule order, as if we went through all of them.
+  std::sort(steps, steps+tasks->nP2pSteps);
 
+  plan->tuneValid = false; // Only time kernels made of a single collective
   plan->threadPerBlock = std::max(plan->threadPerBlock, NCCL_MAX_NTHREADS);
   if (!plan->kernelSpecialized) {
     plan->kernelFn = ncclKerns[FUNC_INDEX_P2P].kernelFn;
@@ -619,7 +903,8 @@ static ncclResult_t scheduleP2pTasksToPlan(
   while (nChannelsMax*nRanks > comm->p2pnChannels*4 && nChannelsMax > 1) nChannelsMax /= 2;
 
   while (tasks->nTasksP2p != 0) {
-    for (int i=0; i < nRanks; i++) {
+    for (int s=0; s < tasks->nP2pSteps; s++) {
+      int i = steps[s];
       int sendPeer = sendOrder[i];
       int recvPeer = recvOrder[i];
       struct ncclTaskP2p* send = ncclIntruQueueHead(&peers[sendPeer].sendQueue);
@@ -688,6 +973,18 @@ static ncclResult_t scheduleP2pTasksToPlan(
         } while (sendBytes != 0 || recvBytes != 0);
       }
     }
+    // Drop the steps we are done with. If we run out of budget before getting here,
+    // the next plan goes over them again and finds them empty.
+    int nSteps = 0;
+    for (int s=0; s < tasks->nP2pSteps; s++) {
+      int i = steps[s];
+      if (ncclIntruQueueEmpty(&peers[sendOrder[i]].sendQueue) && ncclIntruQueueEmpty(&peers[recvOrder[i]].recvQueue)) {
+        tasks->p2pStepMask[i/64] &= ~(1UL<<(i%64));
+      } else {
+        steps[nSteps++] = i;
+      }
+    }
+    tasks->nP2pSteps = nSteps;
   }
   return ncclSuccess;
 }
@@ -896,12 +1193,20 @@ ncclResult_t ncclLaunchPrepare(struct ncclComm* comm) {
   // resources from to our memory pools.
   NCCLCHECK(ncclCommPollCallbacks(comm, /*waitSome=*/false));
 
+  // Collect kernel timings, and move to the next tuning model when all ranks have it.
+  if (comm->autotune) NCCLCHECK(ncclAutotunePrepare(comm));
+
   // We already have one frame present which holds all of our tasks (which we
   // are about to schedule). Now push an additional frame for allocating
   // work structs (see appendWorkElem() variants all use scoped allocation).
   ncclMemoryStackPush(&comm->memScoped);
 
   if (tasks->nTasksColl + tasks->nTasksP2p != 0) {
+    // A group made only of collectives may replay the plan of an identical earlier group.
+    struct ncclPlanCacheEntry* cached = nullptr;
+    if (ncclParamPlanCacheSize() > 0 && !persistent && tasks->nTasksP2p == 0) {
+      NCCLCHECKGOTO(planCacheLookup(comm, &cached), result, failure);
+    }
     do {
       struct ncclKernelPlan* plan = ncclMemoryPoolAlloc<struct ncclKernelPlan>(&comm->memPool_ncclKernelPlan, &comm->memPermanent);
       ncclIntruQueueEnqueue(&comm->planQueue, plan);
@@ -910,6 +1215,11 @@ ncclResult_t ncclLaunchPrepare(struct ncclComm* comm) {
       plan->reclaimer.fn = reclaimPlan;
       plan->persistent = persistent;
 
+      if (cached != nullptr) {
+        NCCLCHECKGOTO(planCacheReplay(comm, cached, plan), result, failure);
+        break;
+      }
+
       // Non-persistent kernels fill up at most half of our fifo per kernel.
       int nWorkBudget = plan->persistent ? INT_MAX : comm->workFifoDepth/2;
       int nWorkBudgetOld = nWorkBudget;
@@ -937,6 +1247,15 @@ ncclResult_t ncclLaunchPrepare(struct ncclComm* comm) {
       finishPlan(plan);
     } while (tasks->nTasksColl + tasks->nTasksP2p != 0);
 
+    if (comm->planCache && comm->planCache->recording) {
+      comm->planCache->recording = false;
+      // Groups which did not fit in a single plan are not cached
+      // Caching is only an optimization, the plan we just built is launched either way
+      if (nPlans == 1 && planCacheStore(comm, ncclIntruQueueHead(&comm->planQueue)) != ncclSuccess) {
+        INFO(NCCL_COLL, "Plan cache : could not store the plan of this group, it will be planned again");
+      }
+    }
+
     struct ncclKernelPlan* planHead = ncclIntruQueueHead(&comm->planQueue);
     comm->unlaunchedPlansHead = planHead;
 
@@ -992,6 +1311,7 @@ ncclResult_t ncclLaunchPrepare(struct ncclComm* comm) {
 
   if (false) {
   failure:
+    if (comm->planCache) comm->planCache->recording = false;
     ncclMemoryStackPop(&comm->memScoped); // deallocate ncclWork's
   }
   return result;
@@ -1024,6 +1344,8 @@ ncclResult_t ncclLaunchKernel(struct ncclComm* comm, struct ncclKernelPlan* plan
   dim3 block = {(unsigned)plan->threadPerBlock, 1, 1};
   void *args[3] = {&comm->devComm, &plan->channelMask, &plan->workHead};
 
+  if (comm->autotune) NCCLCHECK(ncclAutotuneLaunchBegin(comm, plan, launchStream));
+
   #if CUDART_VERSION >= 11080
   int driverVersion;
   NCCLCHECK(ncclCudaDriverVersion(&driverVersion));
@@ -1078,11 +1400,13 @@ ncclResult_t ncclLaunchKernel(struct ncclComm* comm, struct ncclKernelPlan* plan
     launchConfig.stream = launchStream;
 
     CUDACHECK(cudaLaunchKernelExC(&launchConfig, fn, args));
+    if (comm->autotune) NCCLCHECK(ncclAutotuneLaunchEnd(comm, launchStream));
     return ncclSuccess;
   }
   #endif
   // Standard kernel launch
   CUDACHECK(cudaLaunchKernel(fn, grid, block, args, 0, launchStream));
+  if (comm->autotune) NCCLCHECK(ncclAutotuneLaunchEnd(comm, launchStream));
   return ncclSuccess;
 }
 
@@ -1146,74 +1470,6 @@ static inline ncclResult_t getCollNetSupport(struct ncclInfo* info, int* collNet
   return ncclSuccess;
 }
 
-// numPipeOps: number of pipelined ops. Can be greater than 1 in aggregation mode. Used to adjust latency.
-static ncclResult_t getAlgoInfo(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps) {
-  struct ncclComm* comm = info->comm;
-  if (comm->nRanks == 1) {
-    info->algorithm = NCCL_ALGO_RING;
-    info->protocol = NCCL_PROTO_SIMPLE;
-  }
-  else {
-    float minTime = 3600000000.0; // Hopefully no operation will take an hour to complete.
-    // Find algorithm / protocol.
-    info->algorithm = -1;
-    info->protocol = -1;
-    int nAlgos = NCCL_NUM_ALGORITHMS;
-    for (int a=0; a<nAlgos; a++) {
-      if ((a == NCCL_ALGO_COLLNET_DIRECT || a == NCCL_ALGO_COLLNET_CHAIN) && collNetTypeSupport != 1) continue;
-      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
-        float time;
-        NCCLCHECK(ncclTopoGetAlgoTime(info, a, p, numPipeOps, &time));
-        if (time >= 0 && time < minTime) {
-          info->algorithm = a;
-          info->protocol = p;
-          minTime = time;
-        }
-      }
-    }
-    if (info->algorithm == -1 || info->protocol == -1) {
-      WARN("Error : no algorithm/protocol available");
-      return ncclInternalError;
-    }
-    //if (comm->rank == 0) INFO(NCCL_TUNING, "%ld Bytes -> Algo %d proto %d time %f", info->nBytes, info->algorithm, info->protocol, minTime);
-    TRACE(NCCL_COLL, "%ld Bytes -> Algo %d proto %d time %f", info->nBytes, info->algorithm, info->protocol, minTime);
-  }
-
-  int nc = (info->nChannels > 0) ? info->nChannels : comm->nChannels;
-  int nt = comm->maxThreads[info->algorithm][info->protocol];
-  int threadThreshold = comm->threadThresholds[info->algorithm][info->protocol];
-  if (info->algorithm == NCCL_ALGO_COLLNET_DIRECT) {
-    // CollNet channel tuning
-    int ncSwitch = 16;
-    bool flag = true;
-    while (ncSwitch >= 1 && flag) {
-      while ((flag = info->nBytes < nc*nt*info->comm->channels[0].collnetDirect.nHeads*threadThreshold) && nc > ncSwitch) {
-        if (nc == ncSwitch+ncSwitch/2) threadThreshold /= 2;
-        nc--;
-      }
-      ncSwitch /= 2;
-    }
-  } else {
-    // Ring/Tree channel tuning
-    while (info->nBytes < nc*nt*threadThreshold) {
-      if (nc >= 2) nc--;
-      else if ((nt % 128) == 0) nt/=2;
-      else break;
-    }
-  }
-  if (info->protocol == NCCL_PROTO_SIMPLE) {
-    nt += WARP_SIZE; // Extra warp for sync
-    // More threads or sync warps needed due to split thread model
-    if (info->algorithm == NCCL_ALGO_TREE) nt += 3*WARP_SIZE;
-    if (info->algorithm == NCCL_ALGO_COLLNET_DIRECT) nt += 3*WARP_SIZE;
-    if (info->algorithm == NCCL_ALGO_COLLNET_CHAIN) nt += 3*WARP_SIZE;
-  }
-  nt = nt/WARP_SIZE < 3 ? 3*WARP_SIZE : nt;
-  info->nChannels = nc;
-  info->nThreads = nt;
-  return ncclSuccess;
-}
-
 static ncclResult_t getPatternInfo(struct ncclInfo* info) {
   switch (info->coll) {
     case ncclFuncBroadcast:
@@ -1264,7 +1520,7 @@ static ncclResult_t computeColl(struct ncclInfo* info /* input */, int* workFunc
   // If so, skip the calculation
   if (info->nChannels > 0 && info->nThreads > 0) goto comp_next;
   NCCLCHECK(getCollNetSupport(info, &collNetTypeSupport));
-  NCCLCHECK(getAlgoInfo(info, collNetTypeSupport, 1));
+  NCCLCHECK(ncclTopoGetAlgoInfo(info, collNetTypeSupport, 1));
 
 comp_next:
   // Set nstepsPerLoop and nchunksPerLoop
@@ -1451,6 +1707,11 @@ static ncclResult_t taskAppend(struct ncclComm* comm, struct ncclInfo const* inf
       isSendNotRecv ? &tasks->peers[peer].sendQueue : &tasks->peers[peer].recvQueue,
       p2p);
     tasks->nTasksP2p += 1;
+    int step = isSendNotRecv ? tasks->peers[peer].sendStep : tasks->peers[peer].recvStep;
+    if (!(tasks->p2pStepMask[step/64] & (1UL<<(step%64)))) {
+      tasks->p2pStepMask[step/64] |= 1UL<<(step%64);
+      tasks->p2pSteps[tasks->nP2pSteps++] = step;
+    }
 
     // Mark channels that need pre-connect
     if (comm->rank != peer) {
@@ -0,0 +1,469 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include "autotune.h"
+#include "bootstrap.h"
+#include "graph.h"
+#include "topo.h"
+#include "socket.h"
+#include <pthread.h>
+#include <unistd.h>
+
+NCCL_PARAM(Autotune, "AUTOTUNE", 0);
+// Time one eligible kernel out of NCCL_AUTOTUNE_SAMPLE_INTERVAL
+NCCL_PARAM(AutotuneSampleInterval, "AUTOTUNE_SAMPLE_INTERVAL", 16);
+// Number of collectives between two model exchanges. The exchange runs in the background
+// and its result is applied one interval later, so keep it well above the number of
+// collectives a rank can enqueue ahead of the others.
+NCCL_PARAM(AutotuneSyncInterval, "AUTOTUNE_SYNC_INTERVAL", 1024);
+
+#define AUTOTUNE_COEFS (NCCL_NUM_FUNCTIONS*NCCL_NUM_ALGORITHMS*NCCL_NUM_PROTOCOLS)
+#define AUTOTUNE_BUCKETS 48 // log2 of the size in bytes
+#define AUTOTUNE_SAMPLES 8  // most recent samples kept per bucket
+#define AUTOTUNE_EVENTS 16  // kernels being timed at once
+#define AUTOTUNE_MIN_SCALE (1.0/16)
+#define AUTOTUNE_MAX_SCALE 16.0
+#define AUTOTUNE_FILE_VERSION 1
+
+// Measured time in us, and the latency and bandwidth terms of the untuned model
+struct ncclAutotuneSample {
+  float time;
+  float latTime;
+  float bwTime;
+};
+
+struct ncclAutotuneBucket {
+  int count;
+  struct ncclAutotuneSample samples[AUTOTUNE_SAMPLES];
+};
+
+struct ncclAutotuneEvent {
+  cudaEvent_t start, stop;
+  int pending;
+  int coef, bucket;
+  float latTime, bwTime;
+};
+
+// Scales applied to the latency and to the bandwidth time of one (coll, algo, proto).
+// weight is the number of sizes they were fitted on, 0 when they are unknown.
+struct ncclAutotuneCoef {
+  float lat;
+  float bw;
+  int weight;
+};
+
+struct ncclAutotune {
+  struct ncclComm* comm;
+  float baseLatencies[NCCL_NUM_FUNCTIONS][NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
+  float baseBandwidths[NCCL_NUM_FUNCTIONS][NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
+  struct ncclAutotuneCoef coefs[AUTOTUNE_COEFS];
+  struct ncclAutotuneBucket* buckets; // AUTOTUNE_COEFS*AUTOTUNE_BUCKETS
+
+  struct ncclAutotuneEvent events[AUTOTUNE_EVENTS];
+  int nextEvent;
+  struct ncclAutotuneEvent* recording;
+  uint64_t nEligible;
+  uint64_t sampleInterval;
+
+  // Collectives enqueued so far. Identical on all ranks at each ncclLaunchPrepare, it
+  // decides when to start an exchange and when to apply its result.
+  uint64_t nColls;
+  uint64_t syncInterval;
+  uint64_t nextSync;
+  uint64_t applyAt; // 0 when no exchange is in flight
+
+  // Ring exchange, run by the autotune thread
+  struct ncclSocket listenSock;
+  struct ncclSocket sendSock;
+  struct ncclSocket recvSock;
+  struct ncclAutotuneCoef* exchange; // nRanks*AUTOTUNE_COEFS
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int request;
+  int stop;
+  ncclResult_t result;
+};
+
+static struct ncclAutotuneCoef* autotuneCoef(struct ncclAutotune* at, int c, int a, int p) {
+  return at->coefs+(c*NCCL_NUM_ALGORITHMS+a)*NCCL_NUM_PROTOCOLS+p;
+}
+
+static ncclResult_t autotuneApply(struct ncclAutotune* at) {
+  struct ncclComm* comm = at->comm;
+  comm->tuningVersion++;
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        struct ncclAutotuneCoef* coef = autotuneCoef(at, c, a, p);
+        comm->latencies[c][a][p] = at->baseLatencies[c][a][p] * coef->lat;
+        comm->bandwidths[c][a][p] = at->baseBandwidths[c][a][p] / coef->bw;
+        if (comm->rank == 0 && coef->weight > 0) {
+          INFO(NCCL_TUNING, "Autotune %10s %14s %6s : latency x%.3f, bandwidth x%.3f (%d sizes)", ncclFuncStr[c], ncclAlgoStr[a], ncclProtoStr[p],
+              coef->lat, 1.0/coef->bw, coef->weight);
+        }
+      }
+    }
+  }
+  NCCLCHECK(ncclTopoBuildAlgoTables(comm));
+  return ncclSuccess;
+}
+
+// Least squares fit of time ~= lat*latTime + bw*bwTime on the median sample of each size.
+// Errors are relative so that small sizes weigh as much as large ones.
+static void autotuneFit(struct ncclAutotune* at, int k, struct ncclAutotuneCoef* coef) {
+  double sxx = 0, sxy = 0, syy = 0, sx = 0, sy = 0;
+  int n = 0;
+  for (int b=0; b<AUTOTUNE_BUCKETS; b++) {
+    struct ncclAutotuneBucket* bucket = at->buckets+k*AUTOTUNE_BUCKETS+b;
+    int count = std::min(bucket->count, AUTOTUNE_SAMPLES);
+    if (count == 0) continue;
+    // The median drops samples delayed by other work on the stream or by a late peer
+    struct ncclAutotuneSample sorted[AUTOTUNE_SAMPLES];
+    for (int i=0; i<count; i++) {
+      int j = i;
+      while (j > 0 && sorted[j-1].time > bucket->samples[i].time) { sorted[j] = sorted[j-1]; j--; }
+      sorted[j] = bucket->samples[i];
+    }
+    struct ncclAutotuneSample* s = sorted+count/2;
+    if (s->time <= 0) continue;
+    double x = s->latTime/s->time, y = s->bwTime/s->time;
+    sxx += x*x; sxy += x*y; syy += y*y; sx += x; sy += y;
+    n++;
+  }
+  coef->weight = n;
+  if (n == 0) {
+    coef->lat = coef->bw = 1.0;
+    return;
+  }
+  double lat = -1, bw = -1;
+  double det = sxx*syy - sxy*sxy;
+  if (n > 1 && det > 1e-6*sxx*syy) {
+    lat = (sx*syy - sy*sxy)/det;
+    bw = (sy*sxx - sx*sxy)/det;
+  }
+  if (lat <= 0 || bw <= 0) {
+    // Sizes do not separate the two terms, scale the whole model
+    lat = bw = (sx+sy)/(sxx+2*sxy+syy);
+  }
+  coef->lat = std::min(std::max(lat, AUTOTUNE_MIN_SCALE), AUTOTUNE_MAX_SCALE);
+  coef->bw = std::min(std::max(bw, AUTOTUNE_MIN_SCALE), AUTOTUNE_MAX_SCALE);
+}
+
+// Average of the fits of all ranks, weighted by the number of sizes each one measured.
+// Every rank sums in the same order and ends up with the same tables.
+static void autotuneMerge(struct ncclAutotune* at) {
+  int nRanks = at->comm->nRanks;
+  for (int k=0; k<AUTOTUNE_COEFS; k++) {
+    double lat = 0, bw = 0;
+    int weight = 0;
+    for (int r=0; r<nRanks; r++) {
+      struct ncclAutotuneCoef* coef = at->exchange+r*AUTOTUNE_COEFS+k;
+      if (coef->weight == 0) continue;
+      lat += coef->lat*coef->weight;
+      bw += coef->bw*coef->weight;
+      weight += coef->weight;
+    }
+    if (weight == 0) continue; // Keep what we had
+    at->coefs[k].lat = lat/weight;
+    at->coefs[k].bw = bw/weight;
+    at->coefs[k].weight = weight;
+  }
+}
+
+static ncclResult_t autotuneRingAllGather(struct ncclAutotune* at) {
+  int rank = at->comm->rank, nRanks = at->comm->nRanks;
+  const int size = AUTOTUNE_COEFS*sizeof(struct ncclAutotuneCoef);
+  char* data = (char*)at->exchange;
+  for (int i=0; i<nRanks-1; i++) {
+    int sslice = (rank - i + nRanks) % nRanks;
+    int rslice = (rank - i - 1 + nRanks) % nRanks;
+    NCCLCHECK(ncclSocketSend(&at->sendSock, data+sslice*size, size));
+    NCCLCHECK(ncclSocketRecv(&at->recvSock, data+rslice*size, size));
+  }
+  return ncclSuccess;
+}
+
+static void* autotuneThreadMain(void* arg) {
+  struct ncclAutotune* at = (struct ncclAutotune*)arg;
+  pthread_mutex_lock(&at->lock);
+  while (1) {
+    while (at->request == 0 && at->stop == 0) pthread_cond_wait(&at->cond, &at->lock);
+    // Finish a pending exchange before stopping, peers are waiting for it
+    if (at->request == 0) break;
+    pthread_mutex_unlock(&at->lock);
+    ncclResult_t res = autotuneRingAllGather(at);
+    pthread_mutex_lock(&at->lock);
+    at->result = res;
+    at->request = 0;
+    pthread_cond_broadcast(&at->cond);
+  }
+  pthread_mutex_unlock(&at->lock);
+  return NULL;
+}
+
+/* Model file : a header line identifying the system, then one line per known coefficient. */
+static ncclResult_t autotuneLoad(struct ncclComm* comm, const char* path, struct ncclAutotuneCoef* coefs, int* loaded) {
+  *loaded = 0;
+  FILE* file = fopen(path, "r");
+  if (file == NULL) {
+    INFO(NCCL_TUNING, "Autotune : no model in %s", path);
+    return ncclSuccess;
+  }
+  int version, nRanks, nNodes;
+  unsigned long fingerprint;
+  if (fscanf(file, "version %d fingerprint %lx nranks %d nnodes %d", &version, &fingerprint, &nRanks, &nNodes) != 4 ||
+      version != AUTOTUNE_FILE_VERSION || fingerprint != comm->topo->fingerprint || nRanks != comm->nRanks || nNodes != comm->nNodes) {
+    INFO(NCCL_TUNING, "Autotune : model in %s was saved for another system, ignoring it", path);
+    fclose(file);
+    return ncclSuccess;
+  }
+  int c, a, p, weight;
+  float lat, bw;
+  while (fscanf(file, "%d %d %d %f %f %d", &c, &a, &p, &lat, &bw, &weight) == 6) {
+    if (c < 0 || c >= NCCL_NUM_FUNCTIONS || a < 0 || a >= NCCL_NUM_ALGORITHMS || p < 0 || p >= NCCL_NUM_PROTOCOLS ||
+        !(lat >= AUTOTUNE_MIN_SCALE && lat <= AUTOTUNE_MAX_SCALE) || !(bw >= AUTOTUNE_MIN_SCALE && bw <= AUTOTUNE_MAX_SCALE) || weight <= 0) continue;
+    struct ncclAutotuneCoef* coef = coefs+(c*NCCL_NUM_ALGORITHMS+a)*NCCL_NUM_PROTOCOLS+p;
+    coef->lat = lat;
+    coef->bw = bw;
+    coef->weight = weight;
+    (*loaded)++;
+  }
+  fclose(file);
+  INFO(NCCL_TUNING, "Autotune : loaded %d coefficients from %s", *loaded, path);
+  return ncclSuccess;
+}
+
+static ncclResult_t autotuneSave(struct ncclAutotune* at, const char* path) {
+  struct ncclComm* comm = at->comm;
+  int n = 0;
+  for (int k=0; k<AUTOTUNE_COEFS; k++) n += at->coefs[k].weight > 0 ? 1 : 0;
+  if (n == 0) return ncclSuccess;
+  // Write to a private file then rename it in place, readers never see a partial model
+  char tmpPath[PATH_MAX];
+  snprintf(tmpPath, PATH_MAX, "%s.%lx.%d.tmp", path, getHostHash(), getpid());
+  FILE* file = fopen(tmpPath, "w");
+  if (file == NULL) {
+    WARN("Autotune : could not open %s : %s", tmpPath, strerror(errno));
+    return ncclSystemError;
+  }
+  fprintf(file, "version %d fingerprint %lx nranks %d nnodes %d\n", AUTOTUNE_FILE_VERSION, (unsigned long)comm->topo->fingerprint, comm->nRanks, comm->nNodes);
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        struct ncclAutotuneCoef* coef = autotuneCoef(at, c, a, p);
+        if (coef->weight > 0) fprintf(file, "%d %d %d %g %g %d\n", c, a, p, coef->lat, coef->bw, coef->weight);
+      }
+    }
+  }
+  if (fclose(file) != 0 || rename(tmpPath, path) != 0) {
+    WARN("Autotune : could not write %s : %s", path, strerror(errno));
+    unlink(tmpPath);
+    return ncclSystemError;
+  }
+  INFO(NCCL_TUNING, "Autotune : saved %d coefficients to %s", n, path);
+  return ncclSuccess;
+}
+
+struct ncclAutotuneInitInfo {
+  union ncclSocketAddress addr;
+  int loaded;
+  struct ncclAutotuneCoef coefs[AUTOTUNE_COEFS];
+};
+
+ncclResult_t ncclAutotuneInit(struct ncclComm* comm) {
+  ncclResult_t ret = ncclSuccess;
+  struct ncclAutotune* at = NULL;
+  struct ncclAutotuneInitInfo* allInfo = NULL;
+  union ncclSocketAddress ifAddr;
+  int rank = comm->rank, nRanks = comm->nRanks;
+  const char* path = getenv("NCCL_AUTOTUNE_FILE");
+
+  comm->autotune = NULL;
+  // Single rank communicators always use Ring/Simple
+  if (ncclParamAutotune() == 0 || nRanks == 1) return ncclSuccess;
+
+  NCCLCHECK(ncclCalloc(&at, 1));
+  comm->autotune = at;
+  at->comm = comm;
+  at->listenSock.fd = at->sendSock.fd = at->recvSock.fd = -1; // Nothing to close yet
+  memcpy(at->baseLatencies, comm->latencies, sizeof(comm->latencies));
+  memcpy(at->baseBandwidths, comm->bandwidths, sizeof(comm->bandwidths));
+  for (int k=0; k<AUTOTUNE_COEFS; k++) at->coefs[k].lat = at->coefs[k].bw = 1.0;
+  at->sampleInterval = std::max(1L, (long)ncclParamAutotuneSampleInterval());
+  at->syncInterval = std::max(1L, (long)ncclParamAutotuneSyncInterval());
+  at->nextSync = at->syncInterval;
+  pthread_mutex_init(&at->lock, NULL);
+  pthread_cond_init(&at->cond, NULL);
+  NCCLCHECKGOTO(ncclCalloc(&at->buckets, AUTOTUNE_COEFS*AUTOTUNE_BUCKETS), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&at->exchange, nRanks*AUTOTUNE_COEFS), ret, fail);
+  for (int e=0; e<AUTOTUNE_EVENTS; e++) {
+    CUDACHECKGOTO(cudaEventCreate(&at->events[e].start), ret, fail);
+    CUDACHECKGOTO(cudaEventCreate(&at->events[e].stop), ret, fail);
+  }
+
+  // All ranks start from the model rank 0 loaded, so that they make the same choices
+  NCCLCHECKGOTO(ncclCalloc(&allInfo, nRanks), ret, fail);
+  if (rank == 0 && path) NCCLCHECKGOTO(autotuneLoad(comm, path, allInfo[0].coefs, &allInfo[0].loaded), ret, fail);
+  NCCLCHECKGOTO(bootstrapGetNetIfAddr(&ifAddr), ret, fail);
+  NCCLCHECKGOTO(ncclSocketInit(&at->listenSock, &ifAddr, comm->magic, ncclSocketTypeBootstrap, comm->abortFlag), ret, fail);
+  NCCLCHECKGOTO(ncclSocketListen(&at->listenSock), ret, fail);
+  NCCLCHECKGOTO(ncclSocketGetAddr(&at->listenSock, &allInfo[rank].addr), ret, fail);
+  NCCLCHECKGOTO(bootstrapAllGather(comm->bootstrap, allInfo, sizeof(*allInfo)), ret, fail);
+  if (allInfo[0].loaded) {
+    for (int k=0; k<AUTOTUNE_COEFS; k++) {
+      if (allInfo[0].coefs[k].weight > 0) at->coefs[k] = allInfo[0].coefs[k];
+    }
+    NCCLCHECKGOTO(autotuneApply(at), ret, fail);
+  }
+
+  // Exchanges go around a ring of dedicated sockets; the bootstrap ones are not thread safe
+  NCCLCHECKGOTO(ncclSocketInit(&at->sendSock, &allInfo[(rank+1)%nRanks].addr, comm->magic, ncclSocketTypeBootstrap, comm->abortFlag), ret, fail);
+  NCCLCHECKGOTO(ncclSocketConnect(&at->sendSock), ret, fail);
+  NCCLCHECKGOTO(ncclSocketInit(&at->recvSock), ret, fail);
+  NCCLCHECKGOTO(ncclSocketAccept(&at->recvSock, &at->listenSock), ret, fail);
+
+  if (pthread_create(&at->thread, NULL, autotuneThreadMain, at) != 0) {
+    WARN("Autotune : could not create thread : %s", strerror(errno));
+    at->thread = 0;
+    ret = ncclSystemError;
+    goto fail;
+  }
+  ncclSetThreadName(at->thread, "NCCL Autotune%2d", comm->cudaDev);
+  INFO(NCCL_INIT|NCCL_TUNING, "Autotune enabled : timing 1/%ld kernels, exchanging every %ld collectives",
+      at->sampleInterval, at->syncInterval);
+
+exit:
+  free(allInfo);
+  return ret;
+fail:
+  ncclAutotuneFree(comm);
+  goto exit;
+}
+
+ncclResult_t ncclAutotuneFree(struct ncclComm* comm) {
+  struct ncclAutotune* at = comm->autotune;
+  if (at == NULL) return ncclSuccess;
+  if (at->thread) {
+    pthread_mutex_lock(&at->lock);
+    at->stop = 1;
+    pthread_cond_signal(&at->cond);
+    pthread_mutex_unlock(&at->lock);
+    pthread_join(at->thread, NULL);
+  }
+  const char* path = getenv("NCCL_AUTOTUNE_FILE");
+  if (comm->rank == 0 && path) autotuneSave(at, path);
+  for (int e=0; e<AUTOTUNE_EVENTS; e++) {
+    if (at->events[e].start) CUDACHECKIGNORE(cudaEventDestroy(at->events[e].start));
+    if (at->events[e].stop) CUDACHECKIGNORE(cudaEventDestroy(at->events[e].stop));
+  }
+  ncclSocketClose(&at->sendSock);
+  ncclSocketClose(&at->recvSock);
+  ncclSocketClose(&at->listenSock);
+  pthread_mutex_destroy(&at->lock);
+  pthread_cond_destroy(&at->cond);
+  free(at->exchange);
+  free(at->buckets);
+  free(at);
+  comm->autotune = NULL;
+  return ncclSuccess;
+}
+
+static ncclResult_t autotunePoll(struct ncclAutotune* at) {
+  for (int e=0; e<AUTOTUNE_EVENTS; e++) {
+    struct ncclAutotuneEvent* event = at->events+e;
+    if (event->pending == 0 || event == at->recording) continue;
+    cudaError_t res = cudaEventQuery(event->stop);
+    if (res == cudaErrorNotReady) continue;
+    if (res != cudaSuccess) {
+      WARN("Cuda failure '%s'", cudaGetErrorString(res));
+      return ncclUnhandledCudaError;
+    }
+    float ms;
+    CUDACHECK(cudaEventElapsedTime(&ms, event->start, event->stop));
+    event->pending = 0;
+    struct ncclAutotuneBucket* bucket = at->buckets+event->coef*AUTOTUNE_BUCKETS+event->bucket;
+    struct ncclAutotuneSample* sample = bucket->samples+(bucket->count%AUTOTUNE_SAMPLES);
+    sample->time = ms*1e3;
+    sample->latTime = event->latTime;
+    sample->bwTime = event->bwTime;
+    bucket->count++;
+  }
+  return ncclSuccess;
+}
+
+ncclResult_t ncclAutotunePrepare(struct ncclComm* comm) {
+  struct ncclAutotune* at = comm->autotune;
+  NCCLCHECK(autotunePoll(at));
+
+  if (at->applyAt && at->nColls >= at->applyAt) {
+    pthread_mutex_lock(&at->lock);
+    while (at->request) pthread_cond_wait(&at->cond, &at->lock);
+    ncclResult_t res = at->result;
+    pthread_mutex_unlock(&at->lock);
+    if (res != ncclSuccess) {
+      WARN("Autotune : model exchange failed");
+      return res;
+    }
+    autotuneMerge(at);
+    NCCLCHECK(autotuneApply(at));
+    at->applyAt = 0;
+  }
+  if (at->applyAt == 0 && at->nColls >= at->nextSync) {
+    struct ncclAutotuneCoef* mine = at->exchange+comm->rank*AUTOTUNE_COEFS;
+    for (int k=0; k<AUTOTUNE_COEFS; k++) autotuneFit(at, k, mine+k);
+    pthread_mutex_lock(&at->lock);
+    at->request = 1;
+    pthread_cond_signal(&at->cond);
+    pthread_mutex_unlock(&at->lock);
+    at->applyAt = at->nextSync = at->nextSync + at->syncInterval;
+  }
+  at->nColls += comm->tasks.nTasksColl;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclAutotuneSchedule(struct ncclComm* comm, struct ncclKernelPlan* plan, struct ncclInfo* info, int nAggOps) {
+  struct ncclAutotune* at = comm->autotune;
+  plan->tuneValid = false;
+  if (plan->collOpCount != 1 || nAggOps != 1 || plan->persistent) return ncclSuccess;
+  // Same terms as ncclTopoGetAlgoInfo used to pick the algorithm, before channel tuning
+  struct ncclInfo modelInfo = *info;
+  modelInfo.nChannels = 0;
+  float latTime, bwTime;
+  NCCLCHECK(ncclTopoGetAlgoTimeTerms(&modelInfo, info->algorithm, info->protocol, 1, &latTime, &bwTime));
+  if (bwTime < 0) return ncclSuccess;
+  struct ncclAutotuneCoef* coef = autotuneCoef(at, info->coll, info->algorithm, info->protocol);
+  plan->tuneValid = true;
+  plan->tuneCoef = coef-at->coefs;
+  plan->tuneBucket = std::min((int)log2i(info->nBytes), AUTOTUNE_BUCKETS-1);
+  plan->tuneLatTime = latTime/coef->lat;
+  plan->tuneBwTime = bwTime/coef->bw;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclAutotuneLaunchBegin(struct ncclComm* comm, struct ncclKernelPlan* plan, cudaStream_t stream) {
+  struct ncclAutotune* at = comm->autotune;
+  if (!plan->tuneValid || at->nEligible++ % at->sampleInterval != 0) return ncclSuccess;
+  struct ncclAutotuneEvent* event = at->events+at->nextEvent;
+  if (event->pending) return ncclSuccess; // All events in flight, skip this one
+  at->nextEvent = (at->nextEvent+1) % AUTOTUNE_EVENTS;
+  CUDACHECK(cudaEventRecord(event->start, stream));
+  event->pending = 1;
+  event->coef = plan->tuneCoef;
+  event->bucket = plan->tuneBucket;
+  event->latTime = plan->tuneLatTime;
+  event->bwTime = plan->tuneBwTime;
+  at->recording = event;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclAutotuneLaunchEnd(struct ncclComm* comm, cudaStream_t stream) {
+  struct ncclAutotune* at = comm->autotune;
+  if (at->recording == NULL) return ncclSuccess;
+  CUDACHECK(cudaEventRecord(at->recording->stop, stream));
+  at->recording = NULL;
+  return ncclSuccess;
+}
@@ -262,6 +262,196 @@ ncclResult_t ncclTopoSearchRec(struct ncclTopoSystem* system, struct ncclTopoGra
 #define FORCED_ORDER_PCI 1
 #define FORCED_ORDER_REPLAY 2
 
+// Parallel search. Each worker searches a private copy of the system and owns every count-th
+// branch at the top of the search tree (starting NIC/GPU of the first channel). Like the
+// sequential search, which stops at the first perfect graph, the search ends at the lowest
+// branch where a perfect graph was found: workers publish that branch and drop the branches
+// after it, and the merge takes the graph of that branch. Branches before it are always
+// searched to the end, so the result does not depend on thread timing. Every worker gets the
+// full time budget of the pass. Workers share the best graph found so far with the branch it
+// comes from, and only keep a graph which beats the best one of earlier branches, as the
+// sequential search would. Results are then merged in branch order, which gives the sequential
+// result whatever the order in which workers found their graphs.
+// Most searches end after a few steps, so workers are first run one after the other by the
+// calling thread, and threads are only started for the others once a search took
+// NCCL_TOPO_SEARCH_THREAD_STEPS steps. Workers which own no branch are not run at all.
+#define NCCL_TOPO_MAX_SEARCH_THREADS 16
+#define NCCL_TOPO_SEARCH_THREAD_STEPS 512
+NCCL_PARAM(TopoSearchThreads, "TOPO_SEARCH_THREADS", 1);
+
+struct ncclTopoSearchPool;
+
+struct ncclTopoSearchWorker {
+  int id;
+  int count;
+  int branch; // Top-level branches seen so far
+  int current; // Top-level branch being searched
+  struct ncclTopoSearchPool* pool;
+  struct ncclTopoSystem* system;
+  struct ncclTopoGraph* graph;
+  struct ncclTopoGraph* saveGraph;
+  int saveBranch; // Top-level branch of saveGraph, -1 if it is the search input
+  int time;
+  int steps;
+  ncclResult_t ret;
+  int threaded; // 1 : own thread, -1 : calling thread, 0 : not run yet
+  pthread_t thread;
+};
+
+struct ncclTopoSearchPool {
+  int nWorkers;
+  struct ncclTopoGraph* graph; // Search input, copied by each worker when it starts
+  struct ncclTopoGraph* saveGraph;
+  int perfectBranch; // Lowest branch where a worker found a perfect graph
+  pthread_mutex_t bestLock;
+  struct ncclTopoGraph* best; // Properties of the best graph found so far, not its channels
+  int bestBranch;
+  int threadsStarted;
+  struct ncclTopoSearchWorker workers[NCCL_TOPO_MAX_SEARCH_THREADS];
+};
+
+static void ncclTopoSearchStartThreads(struct ncclTopoSearchPool* pool);
+
+static __thread struct ncclTopoSearchWorker* ncclTopoSearchSelf = NULL;
+
+// Whether the calling thread should explore the next top-level branch
+static int ncclTopoSearchOwnBranch(struct ncclTopoGraph* graph) {
+  struct ncclTopoSearchWorker* w = ncclTopoSearchSelf;
+  if (w == NULL || graph->nChannels > 0) return 1;
+  int branch = w->branch++;
+  if (branch % w->count != w->id || branch > __atomic_load_n(&w->pool->perfectBranch, __ATOMIC_RELAXED)) return 0;
+  w->current = branch;
+  return 1;
+}
+
+// Called at every step of the search. Returns whether a perfect graph was found in an earlier
+// branch than the one being searched, which makes the rest of this branch useless.
+static int ncclTopoSearchStep() {
+  struct ncclTopoSearchWorker* w = ncclTopoSearchSelf;
+  if (w == NULL) return 0;
+  if (w->threaded == -1 && ++w->steps == NCCL_TOPO_SEARCH_THREAD_STEPS) ncclTopoSearchStartThreads(w->pool);
+  return w->current > __atomic_load_n(&w->pool->perfectBranch, __ATOMIC_RELAXED);
+}
+
+ncclResult_t ncclTopoCompareGraphs(struct ncclTopoGraph* graph, struct ncclTopoGraph* refGraph, int* copy);
+
+// Called when a graph beats the worker's own best one. Returns whether it also beats the best
+// graph of earlier branches, and publishes it if it is the best one of all branches so far.
+static int ncclTopoSearchSaveShared(struct ncclTopoGraph* graph) {
+  struct ncclTopoSearchWorker* w = ncclTopoSearchSelf;
+  if (w == NULL) return 1;
+  struct ncclTopoSearchPool* pool = w->pool;
+  int better = 0, worse = 0;
+  pthread_mutex_lock(&pool->bestLock);
+  ncclTopoCompareGraphs(graph, pool->best, &better);
+  if (better == 0) ncclTopoCompareGraphs(pool->best, graph, &worse);
+  int save = better || w->current < pool->bestBranch;
+  if (better || (worse == 0 && w->current < pool->bestBranch)) {
+    memcpy(pool->best, graph, offsetof(struct ncclTopoGraph, intra));
+    pool->bestBranch = w->current;
+  }
+  pthread_mutex_unlock(&pool->bestLock);
+  if (save) w->saveBranch = w->current;
+  return save;
+}
+
+static void ncclTopoSearchSetPerfect() {
+  struct ncclTopoSearchWorker* w = ncclTopoSearchSelf;
+  if (w == NULL) return;
+  int best = __atomic_load_n(&w->pool->perfectBranch, __ATOMIC_RELAXED);
+  while (w->current < best &&
+      !__atomic_compare_exchange_n(&w->pool->perfectBranch, &best, w->current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Deep copy of the system for a search worker. All links live inside the system structure, so
+// pointers into the original are moved by the offset between the two copies.
+static ncclResult_t ncclTopoSearchCloneSystem(struct ncclTopoSystem* src, struct ncclTopoSystem** dstPtr) {
+  struct ncclTopoSystem* dst;
+  NCCLCHECK(ncclCalloc(&dst, 1));
+  // Node sets and path lists are sized for the largest systems, only copy what is in use
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    dst->nodes[t].count = src->nodes[t].count;
+    memcpy(dst->nodes[t].nodes, src->nodes[t].nodes, src->nodes[t].count*sizeof(struct ncclTopoNode));
+    for (int n=0; n<dst->nodes[t].count; n++) memset(dst->nodes[t].nodes[n].paths, 0, sizeof(dst->nodes[t].nodes[n].paths));
+  }
+  dst->maxBw = src->maxBw;
+  dst->totalBw = src->totalBw;
+  dst->fingerprint = src->fingerprint;
+  ptrdiff_t offset = (char*)dst - (char*)src;
+#define TOPO_REBASE(ptr) ((__typeof__(ptr))((char*)(ptr) + offset))
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    for (int n=0; n<dst->nodes[t].count; n++) {
+      struct ncclTopoNode* node = dst->nodes[t].nodes+n;
+      for (int l=0; l<node->nlinks; l++) node->links[l].remNode = TOPO_REBASE(node->links[l].remNode);
+      for (int t2=0; t2<NCCL_TOPO_NODE_TYPES; t2++) {
+        struct ncclTopoLinkList* paths = src->nodes[t].nodes[n].paths[t2];
+        if (paths == NULL) continue;
+        int count = dst->nodes[t2].count;
+        // Hops past path->count are never read, don't pay for zeroing them
+        node->paths[t2] = (struct ncclTopoLinkList*)malloc(count*sizeof(struct ncclTopoLinkList));
+        if (node->paths[t2] == NULL) {
+          WARN("Failed to malloc %ld bytes", count*sizeof(struct ncclTopoLinkList));
+          ncclTopoFree(dst);
+          return ncclSystemError;
+        }
+        for (int i=0; i<count; i++) {
+          struct ncclTopoLinkList* path = node->paths[t2]+i;
+          path->count = paths[i].count;
+          path->bw = paths[i].bw;
+          path->type = paths[i].type;
+          for (int h=0; h<path->count; h++) path->list[h] = TOPO_REBASE(paths[i].list[h]);
+        }
+      }
+    }
+  }
+#undef TOPO_REBASE
+  *dstPtr = dst;
+  return ncclSuccess;
+}
+
+static void ncclTopoSearchPoolDestroy(struct ncclTopoSearchPool* pool);
+
+static ncclResult_t ncclTopoSearchPoolCreate(struct ncclTopoSystem* system, struct ncclTopoSearchPool** poolPtr) {
+  *poolPtr = NULL;
+  int nWorkers = std::min((int)ncclParamTopoSearchThreads(), NCCL_TOPO_MAX_SEARCH_THREADS);
+  if (nWorkers <= 1 || system->nodes[GPU].count == 1) return ncclSuccess;
+  ncclResult_t ret = ncclSuccess;
+  struct ncclTopoSearchPool* pool;
+  NCCLCHECK(ncclCalloc(&pool, 1));
+  pool->nWorkers = nWorkers;
+  pthread_mutex_init(&pool->bestLock, NULL);
+  NCCLCHECKGOTO(ncclCalloc(&pool->best, 1), ret, fail);
+  for (int w=0; w<nWorkers; w++) {
+    struct ncclTopoSearchWorker* worker = pool->workers+w;
+    worker->id = w;
+    worker->count = nWorkers;
+    worker->pool = pool;
+    // Worker 0 always runs on the calling thread and can use the system itself
+    if (w == 0) worker->system = system;
+    else NCCLCHECKGOTO(ncclTopoSearchCloneSystem(system, &worker->system), ret, fail);
+    NCCLCHECKGOTO(ncclCalloc(&worker->graph, 1), ret, fail);
+    NCCLCHECKGOTO(ncclCalloc(&worker->saveGraph, 1), ret, fail);
+  }
+  INFO(NCCL_GRAPH, "Topology search using %d threads", nWorkers);
+  *poolPtr = pool;
+  return ncclSuccess;
+fail:
+  ncclTopoSearchPoolDestroy(pool);
+  return ret;
+}
+
+static void ncclTopoSearchPoolDestroy(struct ncclTopoSearchPool* pool) {
+  if (pool == NULL) return;
+  for (int w=0; w<pool->nWorkers; w++) {
+    if (w > 0 && pool->workers[w].system) ncclTopoFree(pool->workers[w].system);
+    free(pool->workers[w].graph);
+    free(pool->workers[w].saveGraph);
+  }
+  free(pool->best);
+  pthread_mutex_destroy(&pool->bestLock);
+  free(pool);
+}
+
 ncclResult_t ncclTopoReplayGetGpu(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, int step, int* g) {
   *g = -1;
   if (graph->nChannels == 0) return ncclInternalError;
@@ -358,6 +548,11 @@ ncclResult_t ncclTopoSelectNets(struct ncclTopoSystem* system, int typeInter, in
 
 ncclResult_t ncclTopoSearchRecGpu(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, struct ncclTopoGraph* saveGraph, struct ncclTopoNode* gpu, int step, int backToNet, int backToFirstRank, int forcedOrder, int *time) {
   if ((*time) <= 0) return ncclSuccess;
+  if (ncclTopoSearchStep()) {
+    // The merge ignores this worker's result, just unwind
+    *time = 0;
+    return ncclSuccess;
+  }
   (*time)--;
 
   int ngpus = system->nodes[GPU].count;
@@ -366,9 +561,12 @@ ncclResult_t ncclTopoSearchRecGpu(struct ncclTopoSystem* system, struct ncclTopo
     int copy = 0;
     graph->nChannels++;
     NCCLCHECK(ncclTopoCompareGraphs(graph, saveGraph, &copy));
-    if (copy) {
+    if (copy && ncclTopoSearchSaveShared(graph)) {
       memcpy(saveGraph, graph, sizeof(struct ncclTopoGraph));
-      if (graph->nChannels == graph->maxChannels) *time = -1;
+      if (graph->nChannels == graph->maxChannels) {
+        *time = -1;
+        ncclTopoSearchSetPerfect();
+      }
     }
     if (graph->nChannels < graph->maxChannels) {
       NCCLCHECK(ncclTopoSearchRec(system, graph, saveGraph, time));
@@ -482,7 +680,7 @@ ncclResult_t ncclTopoSearchRecNet(struct ncclTopoSystem* system, struct ncclTopo
       NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, FORCED_ORDER_REPLAY, time, NET, n, g));
     }
     if (graph->nChannels == 0 || graph->sameChannels == 0) {
-      if (graph->nChannels == 0) {
+      if (graph->nChannels == 0 && ncclTopoSearchOwnBranch(graph)) {
         // Always try the PCI order first to set a reference, but don't count in the timeout nor let it run for long
         int t = 1 << 10;
         NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, FORCED_ORDER_PCI, &t, NET, n, 0));
@@ -510,7 +708,7 @@ ncclResult_t ncclTopoSearchRecNet(struct ncclTopoSystem* system, struct ncclTopo
             if (paths[g].bw == maxBw && paths[g].count == minHops) {
               gpu = system->nodes[GPU].nodes+g;
               int gpuUsed = gpuPciBw(gpu) > 0 ? 0 : 1;
-              if (tryGpuBidir == gpuUsed) {
+              if (tryGpuBidir == gpuUsed && ncclTopoSearchOwnBranch(graph)) {
                 NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, 0, time, NET, n, g));
               }
             }
@@ -572,7 +770,7 @@ ncclResult_t ncclTopoSearchRec(struct ncclTopoSystem* system, struct ncclTopoGra
     // Intra-node only.
     if (graph->nChannels == 0) {
       // Try PCI order first
-      NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, FORCED_ORDER_PCI, time, -1, -1, 0));
+      if (ncclTopoSearchOwnBranch(graph)) NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, FORCED_ORDER_PCI, time, -1, -1, 0));
     } else {
       // Also try to replay previous channel
       int g;
@@ -582,6 +780,7 @@ ncclResult_t ncclTopoSearchRec(struct ncclTopoSystem* system, struct ncclTopoGra
     if (graph->sameChannels == 0 || graph->nChannels == 0) {
       // Finally, try all other possibilities unless we are forced to use the same channels
       for (int g=0; g<system->nodes[GPU].count; g++) {
+        if (ncclTopoSearchOwnBranch(graph) == 0) continue;
         NCCLCHECK(ncclTopoSearchTryGpu(system, graph, saveGraph, 0, backToNet, backToFirstRank, 0, time, -1, -1, g));
       }
     }
@@ -589,6 +788,107 @@ ncclResult_t ncclTopoSearchRec(struct ncclTopoSystem* system, struct ncclTopoGra
   return ncclSuccess;
 }
 
+static void* ncclTopoSearchWorkerMain(void* arg) {
+  struct ncclTopoSearchWorker* w = (struct ncclTopoSearchWorker*)arg;
+  // Channels are only read once the search built them, and graphs are compared on their
+  // properties, so the channel arrays don't need to be copied.
+  memcpy(w->graph, w->pool->graph, offsetof(struct ncclTopoGraph, intra));
+  memcpy(w->saveGraph, w->pool->saveGraph, offsetof(struct ncclTopoGraph, intra));
+  ncclTopoSearchSelf = w;
+  w->ret = ncclTopoSearchRec(w->system, w->graph, w->saveGraph, &w->time);
+  ncclTopoSearchSelf = NULL;
+  return NULL;
+}
+
+// Give a thread to every worker which did not run yet
+static void ncclTopoSearchStartThreads(struct ncclTopoSearchPool* pool) {
+  if (pool->threadsStarted) return;
+  pool->threadsStarted = 1;
+  for (int w=0; w<pool->nWorkers; w++) {
+    struct ncclTopoSearchWorker* worker = pool->workers+w;
+    if (worker->threaded) continue;
+    worker->threaded = 1;
+    if (pthread_create(&worker->thread, NULL, ncclTopoSearchWorkerMain, worker) != 0) {
+      worker->threaded = 0;
+      continue;
+    }
+    ncclSetThreadName(worker->thread, "NCCL Search %2d", w);
+  }
+}
+
+// Run one search, split across the pool workers if there is a pool. If a perfect graph was found,
+// the result is the one of the lowest such branch. Otherwise every worker exhausted its branches
+// or budget, and results are merged in branch order with the same comparison the sequential
+// search uses. Either way every rank of the node gets the same graph.
+static ncclResult_t ncclTopoSearchRun(struct ncclTopoSystem* system, struct ncclTopoSearchPool* pool, struct ncclTopoGraph* graph, struct ncclTopoGraph* saveGraph, int* time) {
+  if (pool == NULL || graph->nChannels > 0) return ncclTopoSearchRec(system, graph, saveGraph, time);
+
+  pool->graph = graph;
+  pool->saveGraph = saveGraph;
+  pool->perfectBranch = INT_MAX;
+  memcpy(pool->best, saveGraph, offsetof(struct ncclTopoGraph, intra));
+  pool->bestBranch = -1;
+  pool->threadsStarted = 0;
+  for (int w=0; w<pool->nWorkers; w++) {
+    struct ncclTopoSearchWorker* worker = pool->workers+w;
+    worker->branch = 0;
+    worker->current = -1;
+    worker->saveBranch = -1;
+    worker->time = *time;
+    worker->steps = 0;
+    worker->ret = ncclSuccess;
+    worker->threaded = 0;
+  }
+  // Run here the workers which don't have their own thread, including those we could not start.
+  // All workers see the same top-level branches, so worker 0 tells which ones own none.
+  for (int w=0; w<pool->nWorkers; w++) {
+    struct ncclTopoSearchWorker* worker = pool->workers+w;
+    if (worker->threaded) continue;
+    if (w > 0 && w >= pool->workers[0].branch) break;
+    worker->threaded = -1;
+    ncclTopoSearchWorkerMain(worker);
+  }
+  for (int w=0; w<pool->nWorkers; w++) {
+    if (pool->workers[w].threaded == 1) pthread_join(pool->workers[w].thread, NULL);
+  }
+
+  ncclResult_t ret = ncclSuccess;
+  for (int w=0; w<pool->nWorkers; w++) {
+    if (pool->workers[w].ret != ncclSuccess && ret == ncclSuccess) ret = pool->workers[w].ret;
+  }
+  if (pool->perfectBranch != INT_MAX) {
+    // The owner of that branch stopped right after finding it
+    memcpy(saveGraph, pool->workers[pool->perfectBranch % pool->nWorkers].saveGraph, sizeof(struct ncclTopoGraph));
+    *time = -1;
+    return ret;
+  }
+  // Merge in the order of the branches the graphs come from, so that ties go to the earliest
+  // branch like in the sequential search
+  int order[NCCL_TOPO_MAX_SEARCH_THREADS];
+  int nSaved = 0;
+  for (int w=0; w<pool->nWorkers; w++) {
+    if (pool->workers[w].threaded == 0 || pool->workers[w].saveBranch == -1) continue;
+    int i = nSaved++;
+    for (; i > 0 && pool->workers[order[i-1]].saveBranch > pool->workers[w].saveBranch; i--) order[i] = order[i-1];
+    order[i] = w;
+  }
+  for (int i=0; i<nSaved; i++) {
+    int copy = 0;
+    NCCLCHECK(ncclTopoCompareGraphs(pool->workers[order[i]].saveGraph, saveGraph, &copy));
+    if (copy) memcpy(saveGraph, pool->workers[order[i]].saveGraph, sizeof(struct ncclTopoGraph));
+  }
+  // Report a timeout if any worker ran out of budget, the lowest budget left otherwise
+  int timeout = 0, remaining = *time;
+  for (int w=0; w<pool->nWorkers; w++) {
+    struct ncclTopoSearchWorker* worker = pool->workers+w;
+    if (worker->threaded == 0) continue;
+    if (worker->time == 0) timeout = 1;
+    remaining = std::min(remaining, worker->time);
+  }
+  *time = timeout ? 0 : remaining;
+  return ret;
+}
+
 /************************************/
 /* User defined graph from XML file */
 /************************************/
@@ -733,6 +1033,99 @@ float speedArrayInter[] = { 48.0, 30.0, 28.0, 24.0, 22.0, 18.0, 15.0, 12.0, 10.0
 
 NCCL_PARAM(CrossNic, "CROSS_NIC", 2);
 
+// Search results cache. When NCCL_GRAPH_CACHE_DIR is set, each search result is stored there as an XML
+// graph keyed by the system fingerprint and the search constraints, so that later communicators on the
+// same topology (and with the same NCCL_* environment) can skip the search.
+static int ncclTopoGraphCachePath(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, char* path, int size) {
+  const char* dir = getenv("NCCL_GRAPH_CACHE_DIR");
+  if (dir == NULL || dir[0] == '\0' || system->fingerprint == 0) return 0;
+  // The fingerprint is taken before ncclTopoTrimSystem, which removes the NICs of single node
+  // communicators, so the GPU and NET counts of the trimmed system go in the key as well.
+  char key[160];
+  snprintf(key, sizeof(key), "%lx %d %d %d %d %d %d %d %d", system->fingerprint, system->nodes[GPU].count, system->nodes[NET].count,
+      graph->id, graph->pattern, graph->collNet, graph->crossNic, graph->minChannels, graph->maxChannels);
+  snprintf(path, size, "%s/nccl-graph-%016lx.xml", dir, getHash(key, strlen(key)));
+  return 1;
+}
+
+// Whether all channels of a cached graph match the GPUs and NICs of the system
+static int ncclTopoGraphCacheLayoutOk(struct ncclXmlNode* xmlGraphs, struct ncclTopoSystem* system) {
+  int ngpus = system->nodes[GPU].count;
+  int nnets = system->nodes[NET].count;
+  for (int g=0; g<xmlGraphs->nSubs; g++) {
+    struct ncclXmlNode* xmlGraph = xmlGraphs->subs[g];
+    for (int c=0; c<xmlGraph->nSubs; c++) {
+      struct ncclXmlNode* xmlChannel = xmlGraph->subs[c];
+      int nGpuSubs = 0, nNetSubs = 0;
+      for (int s=0; s<xmlChannel->nSubs; s++) {
+        struct ncclXmlNode* sub = xmlChannel->subs[s];
+        if (strcmp(sub->name, "gpu") == 0) {
+          nGpuSubs++;
+        } else if (strcmp(sub->name, "net") == 0) {
+          int dev, n;
+          if (xmlGetAttrInt(sub, "dev", &dev) != ncclSuccess) return 0;
+          for (n=0; n<nnets && system->nodes[NET].nodes[n].id != dev; n++);
+          if (n == nnets) return 0;
+          nNetSubs++;
+        }
+      }
+      if (nGpuSubs != ngpus || nNetSubs != (nnets ? 2 : 0)) return 0;
+    }
+  }
+  return 1;
+}
+
+static ncclResult_t ncclTopoGraphCacheLoad(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, const char* path, int* hit) {
+  *hit = 0;
+  if (access(path, R_OK) != 0) return ncclSuccess;
+
+  // Parse into a copy so that a stale or truncated entry leaves the graph untouched.
+  struct ncclXml* xml;
+  struct ncclTopoGraph* cached;
+  NCCLCHECK(ncclCalloc(&xml, 1));
+  NCCLCHECK(ncclCalloc(&cached, 1));
+  memcpy(cached, graph, sizeof(struct ncclTopoGraph));
+  int nChannels = -1;
+  if (ncclTopoGetXmlGraphFromFile(path, xml) == ncclSuccess && xml->maxIndex > 0 &&
+      ncclTopoGraphCacheLayoutOk(xml->nodes, system) &&
+      ncclTopoGetGraphFromXml(xml->nodes, system, cached, &nChannels) == ncclSuccess &&
+      nChannels >= 0 && nChannels <= graph->maxChannels) {
+    memcpy(graph, cached, sizeof(struct ncclTopoGraph));
+    *hit = 1;
+    INFO(NCCL_GRAPH, "Search %d : %d channels loaded from cache %s", graph->id, nChannels, path);
+  } else {
+    INFO(NCCL_GRAPH, "Search %d : ignoring unusable cache entry %s", graph->id, path);
+  }
+  free(cached);
+  free(xml);
+  return ncclSuccess;
+}
+
+static ncclResult_t ncclTopoGraphCacheStore(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, const char* path) {
+  if (access(path, F_OK) == 0) return ncclSuccess;
+
+  // Write to a private file then rename it in place, so that concurrent writers (possibly on other
+  // nodes sharing the directory) never expose a partial entry to readers.
+  static int seq = 0;
+  char tmpPath[PATH_MAX];
+  int len = snprintf(tmpPath, PATH_MAX, "%s.%lx.%d.%d.tmp", path, getHostHash(), getpid(), __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED));
+  if (len < 0 || len >= PATH_MAX) {
+    INFO(NCCL_GRAPH, "Search %d : cache path %s too long, not storing", graph->id, path);
+    return ncclSuccess;
+  }
+  struct ncclXml* xml;
+  NCCLCHECK(ncclCalloc(&xml, 1));
+  ncclResult_t ret = ncclTopoGetXmlFromGraphs(1, &graph, system, xml);
+  if (ret == ncclSuccess) ret = ncclTopoDumpXmlToFile(tmpPath, xml);
+  free(xml);
+  NCCLCHECK(ret);
+  if (rename(tmpPath, path) != 0) {
+    INFO(NCCL_GRAPH, "Search %d : could not store cache entry %s : %s", graph->id, path, strerror(errno));
+    unlink(tmpPath);
+  }
+  return ncclSuccess;
+}
+
 ncclResult_t ncclTopoCompute(ncclTopoSystem* system, struct ncclTopoGraph* graph) {
   int ngpus = system->nodes[GPU].count;
   graph->crossNic = ncclParamCrossNic();
@@ -758,6 +1151,15 @@ ncclResult_t ncclTopoCompute(ncclTopoSystem* system, struct ncclTopoGraph* graph
     if (graph->nChannels > 0) return ncclSuccess;
   }
 
+  // The cache key is taken from the constraints before the search alters them
+  char cachePath[PATH_MAX];
+  int useCache = ncclTopoGraphCachePath(system, graph, cachePath, PATH_MAX);
+  if (useCache) {
+    int cacheHit;
+    NCCLCHECK(ncclTopoGraphCacheLoad(system, graph, cachePath, &cacheHit));
+    if (cacheHit) return ncclSuccess;
+  }
+
   if (ngpus == 1) if (graph->pattern != NCCL_TOPO_PATTERN_RING) graph->pattern = NCCL_TOPO_PATTERN_TREE;
 
   // SPLIT_TREE works better on older archs.
@@ -782,6 +1184,9 @@ ncclResult_t ncclTopoCompute(ncclTopoSystem* system, struct ncclTopoGraph* graph
   while (speedArray[speedIndex] > system->maxBw && speedIndex < nspeeds-1) speedIndex++;
   tmpGraph.bwIntra = tmpGraph.bwInter = speedArray[speedIndex];
   int64_t globalTimeout = NCCL_SEARCH_GLOBAL_TIMEOUT;
+  ncclResult_t ret = ncclSuccess;
+  struct ncclTopoSearchPool* pool;
+  NCCLCHECK(ncclTopoSearchPoolCreate(system, &pool));
 
 search:
   int time = tmpGraph.sameChannels ? NCCL_SEARCH_TIMEOUT_SAMECHANNELS :
@@ -789,7 +1194,7 @@ search:
   tmpGraph.nChannels = 0;
   globalTimeout -= time;
 
-  NCCLCHECK(ncclTopoSearchRec(system, &tmpGraph, graph, &time));
+  NCCLCHECKGOTO(ncclTopoSearchRun(system, pool, &tmpGraph, graph, &time), ret, fail);
 #if 0
   printf("Pattern %d, crossNic %d, Bw %g/%g, type %d/%d, channels %d-%d sameChannels %d -> nChannels %dx%g/%g %s\n", tmpGraph.pattern, tmpGraph.crossNic, tmpGraph.bwInter, tmpGraph.bwIntra, tmpGraph.typeInter, tmpGraph.typeIntra, tmpGraph.minChannels, tmpGraph.maxChannels, tmpGraph.sameChannels, graph->nChannels, graph->bwInter, graph->bwIntra, time == 0 ? "TIMEOUT" : time == -1 ? "PERFECT" : "");
   for (int c=0; c<graph->nChannels; c++) {
@@ -880,6 +1285,7 @@ done:
     time = -1;
     memcpy(&tmpGraph, graph, sizeof(tmpGraph));
   }
+  ncclTopoSearchPoolDestroy(pool);
 
   if (graph->nChannels == 0 && graph->collNet == 0) {
     WARN("Could not find a path for pattern %d, falling back to simple order", graph->pattern);
@@ -898,7 +1304,11 @@ done:
     graph->bwInter /= DIVUP(dupChannels, graph->nChannels);
     graph->nChannels = dupChannels;
   }
+  if (useCache) NCCLCHECK(ncclTopoGraphCacheStore(system, graph, cachePath));
   return ncclSuccess;
+fail:
+  ncclTopoSearchPoolDestroy(pool);
+  return ret;
 }
 
 ncclResult_t ncclTopoPrintGraph(struct ncclTopoSystem* system, struct ncclTopoGraph* graph) {
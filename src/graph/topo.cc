@@ -595,6 +595,74 @@ static ncclResult_t xmlInitAttrFloat(struct ncclXmlNode* node, const char* attrN
 }
 
 
+// Fingerprint of the trimmed topology and of the NCCL_* environment, used to key the graph search cache.
+// Ranks are left out so that nodes with identical hardware share cache entries, and NIC GUIDs are
+// replaced by their order of appearance since only which ports share a NIC matters to the search.
+#define TOPO_HASH_MAX_GUIDS 64
+struct ncclTopoHashGuids {
+  const char* values[TOPO_HASH_MAX_GUIDS];
+  int count;
+};
+
+static uint64_t topoHashStr(uint64_t hash, const char* str) {
+  // Same DJB2a as getHash, chained
+  for (const char* c = str; *c; c++) hash = ((hash << 5) + hash) ^ *c;
+  return ((hash << 5) + hash) ^ '\n';
+}
+
+static uint64_t topoHashXmlNode(uint64_t hash, struct ncclXmlNode* node, struct ncclTopoHashGuids* guids) {
+  hash = topoHashStr(hash, node->name);
+  for (int a=0; a<node->nAttrs; a++) {
+    const char* key = node->attrs[a].key;
+    const char* value = node->attrs[a].value;
+    if (strcmp(key, "rank") == 0 || strcmp(key, "keep") == 0) continue;
+    char guidIndex[16];
+    if (strcmp(key, "guid") == 0) {
+      int g = 0;
+      while (g < guids->count && strcmp(guids->values[g], value) != 0) g++;
+      if (g < TOPO_HASH_MAX_GUIDS) {
+        if (g == guids->count) guids->values[guids->count++] = value;
+        snprintf(guidIndex, sizeof(guidIndex), "#%d", g);
+        value = guidIndex;
+      }
+    }
+    hash = topoHashStr(topoHashStr(hash, key), value);
+  }
+  for (int s=0; s<node->nSubs; s++) hash = topoHashXmlNode(hash, node->subs[s], guids);
+  return topoHashStr(hash, "/");
+}
+
+static int topoCompareStr(const void* a, const void* b) {
+  return strcmp(*(const char**)a, *(const char**)b);
+}
+
+extern char** environ;
+static ncclResult_t ncclTopoFingerprint(struct ncclXml* xml, uint64_t* fingerprint) {
+  char version[32];
+  snprintf(version, sizeof(version), "%d/%d", NCCL_VERSION_CODE, NCCL_GRAPH_XML_VERSION);
+  uint64_t hash = topoHashStr(5381, version);
+
+  // Any NCCL_* variable may change paths or search constraints, so they all go in the key, sorted
+  // since the environment order is not stable across launchers.
+  int nEnv = 0;
+  for (char** e = environ; *e; e++) if (strncmp(*e, "NCCL_", 5) == 0) nEnv++;
+  if (nEnv) {
+    const char** env;
+    NCCLCHECK(ncclCalloc(&env, nEnv));
+    nEnv = 0;
+    for (char** e = environ; *e; e++) if (strncmp(*e, "NCCL_", 5) == 0) env[nEnv++] = *e;
+    qsort(env, nEnv, sizeof(const char*), topoCompareStr);
+    for (int i=0; i<nEnv; i++) hash = topoHashStr(hash, env[i]);
+    free(env);
+  }
+
+  struct ncclTopoHashGuids guids;
+  guids.count = 0;
+  if (xml->maxIndex > 0) hash = topoHashXmlNode(hash, xml->nodes, &guids);
+  *fingerprint = hash;
+  return ncclSuccess;
+}
+
 ncclResult_t ncclTopoGetSystem(struct ncclComm* comm, struct ncclTopoSystem** system) {
   struct ncclXml* xml;
   NCCLCHECK(ncclCalloc(&xml, 1));
@@ -677,7 +745,10 @@ ncclResult_t ncclTopoGetSystem(struct ncclComm* comm, struct ncclTopoSystem** sy
     NCCLCHECK(ncclTopoDumpXmlToFile(xmlTopoFile, xml));
   }
 
+  uint64_t fingerprint;
+  NCCLCHECK(ncclTopoFingerprint(xml, &fingerprint));
   NCCLCHECK(ncclTopoGetSystemFromXml(xml, system));
+  (*system)->fingerprint = fingerprint;
   free(xml);
   return ncclSuccess;
 }
@@ -302,6 +302,8 @@ ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCom
       comm->threadThresholds[NCCL_ALGO_RING][NCCL_PROTO_SIMPLE],
       comm->threadThresholds[NCCL_ALGO_COLLNET_DIRECT][NCCL_PROTO_SIMPLE],
       comm->threadThresholds[NCCL_ALGO_COLLNET_CHAIN][NCCL_PROTO_SIMPLE]);
+
+  NCCLCHECK(ncclTopoBuildAlgoTables(comm));
   return ncclSuccess;
 }
 
@@ -313,11 +315,11 @@ static float treeCorrectionFactor[NCCL_NUM_PROTOCOLS][23] = {
   {  .9,  .9,  .9,  .9,  .9,  .9,  .9,  .8,  .7,  .6,  .6,  .5,  .5,  .5,  .5,  .6,  .7,  .8,  .7,  .7,  .8,  .9,  .9 }
 };
 
-ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* time) {
+ncclResult_t ncclTopoGetAlgoTimeTerms(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* latTime, float* bwTime) {
   float bw = info->comm->bandwidths[info->coll][algorithm][protocol];
   float lat = info->comm->latencies[info->coll][algorithm][protocol];
   if (bw == 0) {
-    *time = -1.0; return ncclSuccess;
+    *latTime = *bwTime = -1.0; return ncclSuccess;
   }
   int logSize = log2i(info->nBytes>>6);
   if (algorithm == NCCL_ALGO_TREE && logSize < 23) bw *= treeCorrectionFactor[protocol][logSize];
@@ -326,6 +328,223 @@ ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int proto
       && info->coll == ncclFuncAllReduce && info->nBytes >= info->comm->nRanks/16.0*65536) lat *= 1.9; // Plateau effect of ring
   // Tree pipelining saves latency in aggregation cases
   int latCount = algorithm == NCCL_ALGO_RING ? numPipeOps : DIVUP(numPipeOps, NCCL_MAX_WORK_ELEMENTS);
-  *time = lat * latCount + (info->nBytes) / (1000 * bw);
+  *latTime = lat * latCount;
+  *bwTime = (info->nBytes) / (1000 * bw);
+  return ncclSuccess;
+}
+
+ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* time) {
+  float latTime, bwTime;
+  NCCLCHECK(ncclTopoGetAlgoTimeTerms(info, algorithm, protocol, numPipeOps, &latTime, &bwTime));
+  *time = bwTime < 0 ? -1.0 : latTime + bwTime;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclTopoGetAlgoBest(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps, int* algorithm, int* protocol, float* time) {
+  float minTime = 3600000000.0; // Hopefully no operation will take an hour to complete.
+  *algorithm = -1;
+  *protocol = -1;
+  for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+    if ((a == NCCL_ALGO_COLLNET_DIRECT || a == NCCL_ALGO_COLLNET_CHAIN) && collNetTypeSupport != 1) continue;
+    for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+      float t;
+      NCCLCHECK(ncclTopoGetAlgoTime(info, a, p, numPipeOps, &t));
+      if (t >= 0 && t < minTime) {
+        *algorithm = a;
+        *protocol = p;
+        minTime = t;
+      }
+    }
+  }
+  *time = minTime;
+  return ncclSuccess;
+}
+
+// Sizes above this use the last entry of the table
+#define NCCL_ALGO_TABLE_MAX_BYTES (1ULL<<48)
+#define NCCL_ALGO_TABLE_MAX_BREAKS 26
+
+// Sizes where the model is not affine : the tree correction factor changes at each
+// power of two from 128B to 512MB and the ring plateau starts at nRanks*4KB. Between
+// two of them every time is affine in the size, so each algorithm/protocol wins on a
+// single interval at most and the crossovers can be found by bisection.
+static int algoTableBreaks(struct ncclComm* comm, size_t* breaks) {
+  int nBreaks = 0;
+  breaks[nBreaks++] = 0;
+  for (int l=1; l<=23; l++) breaks[nBreaks++] = 64ULL<<l;
+  size_t plateau = (size_t)comm->nRanks*4096;
+  int i = nBreaks;
+  while (breaks[i-1] > plateau) i--;
+  if (breaks[i-1] != plateau) {
+    for (int j=nBreaks; j>i; j--) breaks[j] = breaks[j-1];
+    breaks[i] = plateau;
+    nBreaks++;
+  }
+  return nBreaks;
+}
+
+static ncclResult_t algoTableBest(struct ncclInfo* info, int collNetTypeSupport, size_t nBytes, int* algorithm, int* protocol) {
+  float time;
+  info->nBytes = nBytes;
+  NCCLCHECK(ncclTopoGetAlgoBest(info, collNetTypeSupport, 1, algorithm, protocol, &time));
+  return ncclSuccess;
+}
+
+static ncclResult_t algoTableBuild(struct ncclComm* comm, ncclFunc_t coll, int collNetTypeSupport,
+    struct ncclAlgoTableEntry** table, int* nEntries) {
+  struct ncclInfo info;
+  memset(&info, 0, sizeof(info));
+  info.comm = comm;
+  info.coll = coll;
+  size_t breaks[NCCL_ALGO_TABLE_MAX_BREAKS];
+  int nBreaks = algoTableBreaks(comm, breaks);
+  int maxEntries = 0;
+  *table = NULL;
+  *nEntries = 0;
+  for (int b=0; b<nBreaks; b++) {
+    size_t start = breaks[b];
+    size_t end = b+1 < nBreaks ? breaks[b+1] : NCCL_ALGO_TABLE_MAX_BYTES;
+    while (start < end) {
+      int algo, proto;
+      NCCLCHECK(algoTableBest(&info, collNetTypeSupport, start, &algo, &proto));
+      if (*nEntries == 0 || (*table)[*nEntries-1].algorithm != algo || (*table)[*nEntries-1].protocol != proto) {
+        if (*nEntries == maxEntries) {
+          NCCLCHECK(ncclRealloc(table, maxEntries, maxEntries+16));
+          maxEntries += 16;
+        }
+        struct ncclAlgoTableEntry* entry = *table + (*nEntries)++;
+        entry->minBytes = start;
+        entry->algorithm = algo;
+        entry->protocol = proto;
+      }
+      // Find the first size of [start, end) with a different choice
+      int a, p;
+      NCCLCHECK(algoTableBest(&info, collNetTypeSupport, end-1, &a, &p));
+      if (a == algo && p == proto) break;
+      size_t same = start, diff = end-1;
+      while (diff - same > 1) {
+        size_t mid = same + (diff-same)/2;
+        NCCLCHECK(algoTableBest(&info, collNetTypeSupport, mid, &a, &p));
+        if (a == algo && p == proto) same = mid; else diff = mid;
+      }
+      start = diff;
+    }
+  }
+  return ncclSuccess;
+}
+
+void ncclTopoFreeAlgoTables(struct ncclComm* comm) {
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    for (int n=0; n<2; n++) {
+      free(comm->algoTables[c][n]);
+      comm->algoTables[c][n] = NULL;
+      comm->algoTableSizes[c][n] = 0;
+    }
+  }
+}
+
+ncclResult_t ncclTopoBuildAlgoTables(struct ncclComm* comm) {
+  ncclTopoFreeAlgoTables(comm);
+  // ncclTopoGetAlgoInfo does not use the model for a single rank
+  if (comm->nRanks == 1) return ncclSuccess;
+  int nCollNet = comm->collNetSupport > 0 ? 2 : 1;
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    for (int n=0; n<nCollNet; n++) {
+      NCCLCHECK(algoTableBuild(comm, (ncclFunc_t)c, n, comm->algoTables[c]+n, comm->algoTableSizes[c]+n));
+    }
+  }
+
+  if (comm->rank == 0) {
+    char line[2048];
+    INFO(NCCL_TUNING, "Algorithm table (starting size in bytes -> algorithm/protocol)");
+    for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+      for (int n=0; n<nCollNet; n++) {
+        int len = snprintf(line, sizeof(line), "%13s%s |", ncclFuncStr[c], n ? "/CollNet" : "");
+        for (int e=0; e<comm->algoTableSizes[c][n] && len < (int)sizeof(line); e++) {
+          struct ncclAlgoTableEntry* entry = comm->algoTables[c][n]+e;
+          if (entry->algorithm == -1) {
+            len += snprintf(line+len, sizeof(line)-len, " %zu -> none", entry->minBytes);
+          } else {
+            len += snprintf(line+len, sizeof(line)-len, " %zu -> %s/%s", entry->minBytes,
+                ncclAlgoStr[entry->algorithm], ncclProtoStr[entry->protocol]);
+          }
+        }
+        INFO(NCCL_TUNING, "%s", line);
+      }
+    }
+  }
+  return ncclSuccess;
+}
+
+bool ncclTopoLookupAlgoTable(struct ncclComm* comm, ncclFunc_t coll, int collNetTypeSupport, size_t nBytes, int* algorithm, int* protocol) {
+  int n = collNetTypeSupport == 1 ? 1 : 0;
+  struct ncclAlgoTableEntry* table = comm->algoTables[coll][n];
+  if (table == NULL) return false;
+  // Last entry starting at or below nBytes; the first one starts at 0
+  int lo = 0, hi = comm->algoTableSizes[coll][n];
+  while (hi - lo > 1) {
+    int mid = (lo+hi)/2;
+    if (table[mid].minBytes <= nBytes) lo = mid; else hi = mid;
+  }
+  *algorithm = table[lo].algorithm;
+  *protocol = table[lo].protocol;
+  return true;
+}
+
+// numPipeOps: number of pipelined ops. Can be greater than 1 in aggregation mode. Used to adjust latency.
+ncclResult_t ncclTopoGetAlgoInfo(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps) {
+  struct ncclComm* comm = info->comm;
+  if (comm->nRanks == 1) {
+    info->algorithm = NCCL_ALGO_RING;
+    info->protocol = NCCL_PROTO_SIMPLE;
+  }
+  else {
+    // Single operations on all channels are precomputed at init
+    if (numPipeOps == 1 && info->nChannels == 0 &&
+        ncclTopoLookupAlgoTable(comm, info->coll, collNetTypeSupport, info->nBytes, &info->algorithm, &info->protocol)) {
+      TRACE(NCCL_COLL, "%ld Bytes -> Algo %d proto %d (table)", info->nBytes, info->algorithm, info->protocol);
+    } else {
+      float minTime;
+      NCCLCHECK(ncclTopoGetAlgoBest(info, collNetTypeSupport, numPipeOps, &info->algorithm, &info->protocol, &minTime));
+      TRACE(NCCL_COLL, "%ld Bytes -> Algo %d proto %d time %f", info->nBytes, info->algorithm, info->protocol, minTime);
+    }
+    if (info->algorithm == -1 || info->protocol == -1) {
+      WARN("Error : no algorithm/protocol available");
+      return ncclInternalError;
+    }
+  }
+
+  int nc = (info->nChannels > 0) ? info->nChannels : comm->nChannels;
+  int nt = comm->maxThreads[info->algorithm][info->protocol];
+  int threadThreshold = comm->threadThresholds[info->algorithm][info->protocol];
+  if (info->algorithm == NCCL_ALGO_COLLNET_DIRECT) {
+    // CollNet channel tuning
+    int ncSwitch = 16;
+    bool flag = true;
+    while (ncSwitch >= 1 && flag) {
+      while ((flag = info->nBytes < nc*nt*info->comm->channels[0].collnetDirect.nHeads*threadThreshold) && nc > ncSwitch) {
+        if (nc == ncSwitch+ncSwitch/2) threadThreshold /= 2;
+        nc--;
+      }
+      ncSwitch /= 2;
+    }
+  } else {
+    // Ring/Tree channel tuning
+    while (info->nBytes < nc*nt*threadThreshold) {
+      if (nc >= 2) nc--;
+      else if ((nt % 128) == 0) nt/=2;
+      else break;
+    }
+  }
+  if (info->protocol == NCCL_PROTO_SIMPLE) {
+    nt += WARP_SIZE; // Extra warp for sync
+    // More threads or sync warps needed due to split thread model
+    if (info->algorithm == NCCL_ALGO_TREE) nt += 3*WARP_SIZE;
+    if (info->algorithm == NCCL_ALGO_COLLNET_DIRECT) nt += 3*WARP_SIZE;
+    if (info->algorithm == NCCL_ALGO_COLLNET_CHAIN) nt += 3*WARP_SIZE;
+  }
+  nt = nt/WARP_SIZE < 3 ? 3*WARP_SIZE : nt;
+  info->nChannels = nc;
+  info->nThreads = nt;
   return ncclSuccess;
 }
@@ -241,6 +241,11 @@ static void groupCleanup(struct ncclComm** groupCommHeadPtr, struct ncclComm** g
       ncclIntruQueueConstruct(&comm->tasks.peers[i].sendQueue);
       ncclIntruQueueConstruct(&comm->tasks.peers[i].recvQueue);
     }
+    for (int s = 0; s < comm->tasks.nP2pSteps; s++) {
+      int i = comm->tasks.p2pSteps[s];
+      comm->tasks.p2pStepMask[i/64] &= ~(1UL<<(i%64));
+    }
+    comm->tasks.nP2pSteps = 0;
 
     if (!comm->blocking)
       (void) ncclCommSetAsyncError(comm, error);
@@ -0,0 +1,35 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_AUTOTUNE_H_
+#define NCCL_AUTOTUNE_H_
+
+#include "nccl.h"
+#include "comm.h"
+#include "info.h"
+
+// Runtime refinement of the tuning model, enabled with NCCL_AUTOTUNE=1.
+//
+// Kernels holding a single collective are timed with CUDA events. Every
+// NCCL_AUTOTUNE_SYNC_INTERVAL collectives, each rank fits a latency and a bandwidth
+// scale per (coll, algo, proto) on the median time of each size, the ranks average
+// them through a background ring exchange, and all ranks apply the result to
+// comm->latencies/bandwidths at the same point of their collective sequence so that
+// ncclTopoGetAlgoInfo keeps making the same choice everywhere.
+
+// Called by all ranks once the tuning model is computed
+ncclResult_t ncclAutotuneInit(struct ncclComm* comm);
+ncclResult_t ncclAutotuneFree(struct ncclComm* comm);
+
+// Start of ncclLaunchPrepare : collects timings and exchanges/applies the model
+ncclResult_t ncclAutotunePrepare(struct ncclComm* comm);
+// A collective was added to the plan
+ncclResult_t ncclAutotuneSchedule(struct ncclComm* comm, struct ncclKernelPlan* plan, struct ncclInfo* info, int nAggOps);
+// Around the kernel launch
+ncclResult_t ncclAutotuneLaunchBegin(struct ncclComm* comm, struct ncclKernelPlan* plan, cudaStream_t stream);
+ncclResult_t ncclAutotuneLaunchEnd(struct ncclComm* comm, cudaStream_t stream);
+
+#endif
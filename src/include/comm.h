@@ -141,6 +141,12 @@ struct ncclKernelPlan {
 
   int collOpCount; // zero based for this plan
 
+  // Set when the plan holds a single collective the autotuner can time; the model
+  // terms are those of the untuned tables.
+  bool tuneValid;
+  int tuneCoef, tuneBucket;
+  float tuneLatTime, tuneBwTime;
+
   struct ncclIntruQueue<struct ncclPointerList, &ncclPointerList::next> ipcMemQueue;
 
   struct Channel {
@@ -218,6 +224,15 @@ struct ncclComm {
   float latencies[NCCL_NUM_FUNCTIONS][NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
   float bandwidths[NCCL_NUM_FUNCTIONS][NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
   int maxThreads[NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
+  // Algorithm/protocol chosen for a single operation, by size (ncclTopoBuildAlgoTables)
+  struct ncclAlgoTableEntry* algoTables[NCCL_NUM_FUNCTIONS][/*collNetTypeSupport*/2];
+  int algoTableSizes[NCCL_NUM_FUNCTIONS][2];
+  // Runtime refinement of latencies/bandwidths, NULL unless NCCL_AUTOTUNE is set (autotune.h)
+  struct ncclAutotune* autotune;
+  // Incremented each time the tables above change, invalidates choices made from them
+  uint64_t tuningVersion;
+  // Kernel plans of recent groups, NULL unless NCCL_PLAN_CACHE_SIZE is set (enqueue.cc)
+  struct ncclPlanCache* planCache;
 
   /* This attribute can indicate the states of communicators and return code of
    * asynchronous NCCL operations. */
@@ -44,4 +44,7 @@ extern std::chrono::steady_clock::time_point ncclEpoch;
 
 void ncclSetThreadName(pthread_t thread, const char *fmt, ...);
 
+// Write out messages still queued by NCCL_DEBUG_ASYNC
+void ncclDebugFlush();
+
 #endif
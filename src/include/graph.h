@@ -111,5 +111,24 @@ ncclResult_t ncclTopoPostset(struct ncclComm* comm, int* firstRanks, int* treePa
 ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCompCap, struct ncclTopoGraph* treeGraph, struct ncclTopoGraph* ringGraph, struct ncclTopoGraph* collNetGraph);
 #include "info.h"
 ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* time);
+// Latency and bandwidth parts of ncclTopoGetAlgoTime, both -1 if the algorithm/protocol is disabled
+ncclResult_t ncclTopoGetAlgoTimeTerms(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* latTime, float* bwTime);
+// Fastest algorithm/protocol according to the model, -1 if none is available
+ncclResult_t ncclTopoGetAlgoBest(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps, int* algorithm, int* protocol, float* time);
+
+// Decision tables of ncclTopoGetAlgoBest for single operations (numPipeOps 1, all
+// channels). Each entry holds the choice from minBytes up to the next entry.
+struct ncclAlgoTableEntry {
+  size_t minBytes;
+  int algorithm;
+  int protocol;
+};
+// Rebuild after latencies/bandwidths change
+ncclResult_t ncclTopoBuildAlgoTables(struct ncclComm* comm);
+void ncclTopoFreeAlgoTables(struct ncclComm* comm);
+// Returns false if there is no table for this case
+bool ncclTopoLookupAlgoTable(struct ncclComm* comm, ncclFunc_t coll, int collNetTypeSupport, size_t nBytes, int* algorithm, int* protocol);
+// Algorithm, protocol, nChannels and nThreads of an operation, shared by enqueue and tools/topo_sim
+ncclResult_t ncclTopoGetAlgoInfo(struct ncclInfo* info, int collNetTypeSupport, int numPipeOps);
 
 #endif
@@ -96,6 +96,7 @@ struct ncclCudaStreamList {
 struct ncclTasks {
   struct Peer {
     bool sendSeen, recvSeen;
+    int sendStep, recvStep; // Position of the peer in p2pSendOrder/p2pRecvOrder
     struct ncclIntruQueue<struct ncclTaskP2p, &ncclTaskP2p::next> sendQueue;
     struct ncclIntruQueue<struct ncclTaskP2p, &ncclTaskP2p::next> recvQueue;
   };
@@ -103,6 +104,11 @@ struct ncclTasks {
   size_t collBytesTotal;
   struct Peer* peers/*[nRanks]*/;
   int *p2pSendOrder/*[nRanks]*/, *p2pRecvOrder/*[nRanks]*/;
+  // Schedule steps which may have work, so that p2p scheduling only visits peers
+  // the group uses. A step is in p2pSteps iff its bit is set in p2pStepMask.
+  uint64_t* p2pStepMask/*[DIVUP(nRanks,64)]*/;
+  int* p2pSteps/*[nRanks]*/;
+  int nP2pSteps;
   int nTasksColl, nTasksP2p;
 
   // The list of user streams aggregated over all tasks present.
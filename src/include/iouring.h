@@ -0,0 +1,60 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_IOURING_H_
+#define NCCL_IOURING_H_
+
+#include "nccl.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/* Minimal io_uring wrapper built directly on the io_uring_setup/io_uring_enter
+ * system calls, so that we do not depend on liburing. A ring is meant to be
+ * driven by a single thread: submissions are queued with ncclIoUringPrep*(),
+ * pushed to the kernel in one batch by ncclIoUringSubmit() and completions are
+ * collected in bulk with ncclIoUringReap().
+ */
+struct ncclIoUring {
+  int fd;
+  unsigned entries;
+  // Submission queue
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  void* sqes;
+  unsigned sqLocalTail; // Prepared but not yet published entries
+  unsigned sqSubmitted; // Entries consumed by the kernel
+  // Completion queue
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void* cqes;
+  // Mappings
+  void* sqPtr;
+  size_t sqSize;
+  void* cqPtr;
+  size_t cqSize;
+  size_t sqesSize;
+};
+
+struct ncclIoUringCqe {
+  uint64_t userData;
+  int32_t res; // Bytes transferred or -errno
+};
+
+// Returns ncclSystemError (without printing a warning) when io_uring is not available.
+ncclResult_t ncclIoUringInit(struct ncclIoUring* ring, unsigned entries);
+ncclResult_t ncclIoUringDestroy(struct ncclIoUring* ring);
+ncclResult_t ncclIoUringPrepSend(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData);
+ncclResult_t ncclIoUringPrepRecv(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData);
+ncclResult_t ncclIoUringPrepRead(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData);
+// Submit all prepared entries and, if wait is set, block until at least one completion is available.
+ncclResult_t ncclIoUringSubmit(struct ncclIoUring* ring, int wait);
+// Copy up to maxCqes completions to cqes and return how many were found in nCqes.
+ncclResult_t ncclIoUringReap(struct ncclIoUring* ring, struct ncclIoUringCqe* cqes, int maxCqes, int* nCqes);
+
+#endif
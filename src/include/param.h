@@ -13,17 +13,41 @@ const char* userHomeDir();
 void setEnvFile(const char* fileName);
 void initEnv();
 
-void ncclLoadParam(char const* env, int64_t deftVal, int64_t uninitialized, int64_t* cache);
+// Parameter registry. Every NCCL_PARAM registers its descriptor at load time, so that
+// all parameters can be listed. As before, a value is read from the environment the
+// first time the parameter is used, and published in its descriptor without taking a
+// lock; accessors then only do an acquire load of the cache.
+#define NCCL_PARAM_UNINITIALIZED INT64_MIN
+
+struct ncclParamDesc {
+  const char* env;
+  int64_t deftVal;
+  int64_t cache; // NCCL_PARAM_UNINITIALIZED until first read
+  int id; // In the registry, -1 until registered
+};
+
+void ncclParamRegister(struct ncclParamDesc* desc);
+// Slow path : first read of the parameter
+int64_t ncclLoadParam(struct ncclParamDesc* desc);
+// Effective values in registration order, returns the number of parameters (see ncclParamList)
+int ncclParamGetAll(const char** envs, long long* values, int maxCount);
+// Print all effective values (NCCL_DEBUG_SUBSYS=ENV)
+void ncclParamDump();
+
+struct ncclParamRegistrar {
+  ncclParamRegistrar(struct ncclParamDesc* desc) { ncclParamRegister(desc); }
+};
 
 #define NCCL_PARAM(name, env, deftVal) \
+  static_assert(deftVal != NCCL_PARAM_UNINITIALIZED, "default value cannot be the uninitialized value."); \
+  static struct ncclParamDesc ncclParamDesc##name = { "NCCL_" env, deftVal, NCCL_PARAM_UNINITIALIZED, -1 }; \
+  static struct ncclParamRegistrar ncclParamRegistrar##name(&ncclParamDesc##name); \
   int64_t ncclParam##name() { \
-    constexpr int64_t uninitialized = INT64_MIN; \
-    static_assert(deftVal != uninitialized, "default value cannot be the uninitialized value."); \
-    static int64_t cache = uninitialized; \
-    if (__builtin_expect(__atomic_load_n(&cache, __ATOMIC_RELAXED) == uninitialized, false)) { \
-      ncclLoadParam("NCCL_" env, deftVal, uninitialized, &cache); \
+    int64_t value = __atomic_load_n(&ncclParamDesc##name.cache, __ATOMIC_ACQUIRE); \
+    if (__builtin_expect(value == NCCL_PARAM_UNINITIALIZED, false)) { \
+      value = ncclLoadParam(&ncclParamDesc##name); \
     } \
-    return cache; \
+    return value; \
   }
 
 #endif
@@ -31,7 +31,19 @@ enum ncclProxyProfileState {
   ncclProxyProfileAppendEnd = 25
 };
 
-ncclResult_t ncclProfilingRecord(struct ncclProxyArgs* args, int sub, int step, int state);
+// Set through NCCL_PROXY_PROFILE and flipped by NCCL_PROXY_PROFILE_TOGGLE_SIGNAL; records are dropped while it is 0.
+extern int ncclProfilingEnabled;
+
+ncclResult_t ncclProfilingRecordEvent(struct ncclProxyArgs* args, int sub, int step, int state);
+static inline ncclResult_t ncclProfilingRecord(struct ncclProxyArgs* args, int sub, int step, int state) {
+  if (__builtin_expect(__atomic_load_n(&ncclProfilingEnabled, __ATOMIC_RELAXED) == 0, 1)) return ncclSuccess;
+  return ncclProfilingRecordEvent(args, sub, step, state);
+}
+
+// Read NCCL_PROXY_PROFILE* settings, called when progress threads are created
+void ncclProfilingInit();
+// Take a snapshot if one was requested through NCCL_PROXY_PROFILE_SIGNAL
+void ncclProfilingCheckSnapshot();
 void ncclProfilingDump();
 
 #endif
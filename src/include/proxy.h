@@ -65,10 +65,17 @@ struct ncclProxySubArgs {
   void* profilingEvents[NCCL_STEPS];
 };
 
+// Fields read by the progressOps walk come first. Sub args are allocated separately,
+// sized to the number of subs (see proxySubsAlloc).
 struct ncclProxyArgs {
-  struct ncclProxySubArgs subs[NCCL_PROXY_MAX_SUBS];
+  int state;
+  int idle;
   proxyProgressFunc_t progress;
+  struct ncclProxyArgs* next;
+  struct ncclProxySubArgs* subs;
   int nsubs;
+  int maxSubs;
+
   int done;
   uint64_t opCount;
   int sliceSteps;
@@ -78,17 +85,32 @@ struct ncclProxyArgs {
   uint8_t /*ncclDevRedOp_t*/ redOp;
   uint8_t /*ncclPattern_t*/ pattern;
   uint8_t protocol;
-  int state;
   char* sharedBuff[NCCL_STEPS];
   int sharedSize[NCCL_STEPS];
 
-  int idle;
-
   // Element linking
-  struct ncclProxyArgs* next;
   struct ncclProxyArgs* nextPeer;
   struct ncclProxyArgs** proxyAppendPtr;
+
+  // Stuck op detection, see ncclProxyTimerWheel
+  int netInflight;       // Network requests in flight, over all subs
+  uint64_t netEvents;    // Network requests posted or completed so far
+  uint64_t timerEvents;  // netEvents when the timer was last armed
+  uint64_t lastProgress; // Wheel tick
+  uint64_t timerExpire;
+  struct ncclProxyArgs* timerNext;
+  struct ncclProxyArgs** timerPrevPtr; // NULL when the op is not in the wheel
 };
+
+// Called by the transports' progress functions when they post or complete network requests
+static inline void ncclProxyNetPosted(struct ncclProxyArgs* args) {
+  args->netInflight++;
+  args->netEvents++;
+}
+static inline void ncclProxyNetCompleted(struct ncclProxyArgs* args) {
+  args->netInflight--;
+  args->netEvents++;
+}
 #define NCCL_MAX_NETDEVS 128
 
 // ProxyOps are used to communicate between main thread and service thread
@@ -96,13 +118,16 @@ struct ncclProxyArgs {
 // Otherwise we'd be unable to post half of them to free new elements.
 #define MAX_OPS_PER_PEER (2*MAXCHANNELS*NCCL_MAX_WORK_ELEMENTS_P2P)
 #define NCCL_MAX_LOCAL_RANKS 64
+// Posted ops form a lock-free multi-producer/single-consumer queue: main threads swap
+// nextOpsEnd to the end of their chain then link the previous end to it, and the
+// progress thread detaches the whole chain at once.
 struct ncclProxyOpsPool {
   struct ncclProxyOp ops[MAX_OPS_PER_PEER*NCCL_MAX_LOCAL_RANKS];
   volatile int nextOps;
   volatile int nextOpsEnd;
   volatile int freeOps[NCCL_MAX_LOCAL_RANKS];
-  pthread_mutex_t mutex;
-  pthread_cond_t cond;
+  // Futex word, set while the progress thread is (about to be) asleep waiting for ops
+  volatile int sleeping;
 };
 
 struct ncclProxyOps {
@@ -143,22 +168,101 @@ struct ncclSharedNetComms {
   int recvRefCount[MAXCHANNELS];
 };
 
+#define NCCL_PROXY_MAX_THREADS 16
+// Size classes of sub args blocks: 1, 2, 4, ... NCCL_PROXY_MAX_SUBS subs
+#define NCCL_PROXY_SUBS_CLASSES 6
+static_assert((1<<(NCCL_PROXY_SUBS_CLASSES-1)) >= NCCL_PROXY_MAX_SUBS, "Not enough sub args size classes");
+
+// Hierarchical timer wheel tracking active ops, used to detect ops which made no progress
+// for NCCL_PROXY_STUCK_TIMEOUT seconds. Ops are only armed while they have network
+// requests in flight; when their timer expires the wheel compares their network event
+// count to the one seen at arming time and re-arms them if they progressed since.
+#define NCCL_PROXY_WHEEL_LEVELS 3
+#define NCCL_PROXY_WHEEL_BITS 6
+#define NCCL_PROXY_WHEEL_SLOTS (1<<NCCL_PROXY_WHEEL_BITS)
+struct ncclProxyTimerWheel {
+  uint64_t timeout; // ns, 0 when disabled
+  uint64_t start;
+  uint64_t tick;    // Last tick processed
+  uint64_t timeoutTicks;
+  int nArmed;       // The clock is only read while some ops are armed
+  uint64_t walks;
+  struct ncclProxyArgs* slots[NCCL_PROXY_WHEEL_LEVELS][NCCL_PROXY_WHEEL_SLOTS];
+};
+
 struct ncclProxyPool;
+struct ncclProxySubsSlab;
+struct ncclProxySubsBlock;
+// A progress thread and the proxy args it progresses. Shard 0 receives the posted ops
+// and routes them to the other shards by channel or by net device.
+struct ncclProxyShard {
+  int id;
+  pthread_t thread;
+  struct ncclComm* comm;
+  cpu_set_t cpuAffinity;
+  struct ncclProxyArgs* active;
+  struct ncclProxyArgs* pool;
+  struct ncclProxyPool* pools;
+  struct ncclProxySubsBlock* freeSubs[NCCL_PROXY_SUBS_CLASSES];
+  struct ncclProxySubsSlab* subsSlabs;
+  struct ncclProxyTimerWheel timers;
+  // Copies of the ops routed by shard 0. Single producer, single consumer.
+  struct ncclProxyOp* inbox;
+  int inboxSize;
+  uint64_t inboxHead;
+  uint64_t inboxTail;
+  int sleeping; // Futex word, set while the thread waits for its inbox
+};
+
+// Sub args slabs of a shard (proxy_subs.cc). Only the shard's progress thread uses them.
+// Make room for sub args up to subIndex, moving the existing ones if needed
+ncclResult_t ncclProxySubsReserve(struct ncclProxyShard* shard, struct ncclProxyArgs* args, int subIndex);
+void ncclProxySubsFree(struct ncclProxyShard* shard, struct ncclProxyArgs* args);
+void ncclProxySubsDestroy(struct ncclProxyShard* shard);
+
 struct ncclProxyProgressState {
   // Used by main threads to send work to progress thread
   struct ncclProxyOpsPool* opsPool;
   ncclShmHandle_t handle;
   char opsPoolShmSuffix[6];
 
-  pthread_t thread;
   bool stop;
   struct ncclProxyPeer** localPeers;
   struct ncclSharedNetComms* netComms[NCCL_MAX_NETDEVS];
   struct ncclProxySharedCollNet collNet;
-  struct ncclProxyArgs* active;
-  struct ncclProxyArgs* pool;
-  struct ncclProxyPool* pools;
+  int nShards;
+  int shardByNetDev;
+  struct ncclProxyShard* shards;
   int nextOps;
+  int nextOpsEnd;
+};
+
+// Responses expected from a proxy, in the order the requests were sent
+struct ncclProxyPendingCall {
+  int type;
+  struct ncclProxyConnector* proxyConn;
+  void* respBuff;
+  int respSize;
+  int opsPool; // Init response is followed by the name of the ops pool
+};
+// Calls waiting for the Init response of their connection before they can be sent
+struct ncclProxyDeferredCall {
+  struct ncclProxyConnector* proxyConn;
+  int type;
+  char* reqBuff;
+  int reqSize;
+  void* respBuff;
+  int respSize;
+};
+struct ncclProxyPendingCalls {
+  struct ncclProxyPendingCall* calls;
+  int size;
+  int head;
+  int count;
+  struct ncclProxyDeferredCall* deferred;
+  int deferredSize;
+  int deferredHead;
+  int deferredCount;
 };
 
 struct ncclProxyState {
@@ -171,6 +275,7 @@ struct ncclProxyState {
   // Used by main thread
   union ncclSocketAddress* peerAddresses;
   struct ncclSocket* peerSocks;
+  struct ncclProxyPendingCalls* pendingCalls;
   struct ncclProxyOps* proxyOps;
   void** sharedDevMems;
 
@@ -190,6 +295,7 @@ enum proxyConnectState {
 struct ncclProxyConnection {
   int send, transport, shared;
   int localRank;
+  int netDev; // NET and CollNet only, used to route ops to progress threads
   struct ncclSocket* sock;
   struct ncclTransportComm* tcomm;
   struct ncclProxyArgs *proxyAppend;
@@ -224,6 +330,13 @@ enum ncclProxyMsgType {
 };
 
 ncclResult_t ncclProxyCall(struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize);
+// Non-blocking version of ncclProxyCall: sends the request and returns. respBuff is filled by
+// ncclProxyCallWait, which receives the responses of all pending calls to that proxy, or by
+// ncclProxyCallWaitAll for all proxies. ncclProxyConnect is asynchronous too: the connection
+// is known after a wait, calls made on it before are sent once its Init response arrived.
+ncclResult_t ncclProxyCallAsync(struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize);
+ncclResult_t ncclProxyCallWait(struct ncclProxyConnector* proxyConn);
+ncclResult_t ncclProxyCallWaitAll(struct ncclComm* comm);
 ncclResult_t ncclProxyDestroy(struct ncclComm* comm);
 ncclResult_t ncclProxyShmUnlink(struct ncclComm* comm);
 #endif
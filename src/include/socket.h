@@ -88,10 +88,20 @@ ncclResult_t ncclSocketSetFd(int fd, struct ncclSocket* sock);
 #define NCCL_SOCKET_SEND 0
 #define NCCL_SOCKET_RECV 1
 
-ncclResult_t ncclSocketProgress(int op, struct ncclSocket* sock, void* ptr, int size, int* offset);
+// When closed is not NULL, a connection closed by the peer sets *closed instead of failing
+ncclResult_t ncclSocketProgress(int op, struct ncclSocket* sock, void* ptr, int size, int* offset, int* closed = NULL);
 ncclResult_t ncclSocketWait(int op, struct ncclSocket* sock, void* ptr, int size, int* offset);
 ncclResult_t ncclSocketSend(struct ncclSocket* sock, void* ptr, int size);
 ncclResult_t ncclSocketRecv(struct ncclSocket* sock, void* ptr, int size);
 ncclResult_t ncclSocketTryRecv(struct ncclSocket* sock, void* ptr, int size, int* closed);
+
+// Zero-copy sends (MSG_ZEROCOPY). Every successful zero-copy send() consumes one completion
+// sequence number; the buffer must not be reused until the kernel reports that sequence number
+// on the socket error queue.
+ncclResult_t ncclSocketEnableZeroCopy(struct ncclSocket* sock, int* enabled);
+ncclResult_t ncclSocketProgressZeroCopy(struct ncclSocket* sock, void* ptr, int size, int* offset, uint32_t* seq);
+// Reap zero-copy completions. completed is advanced to one past the last completed sequence number,
+// copied is set if the kernel had to fall back to copying the data.
+ncclResult_t ncclSocketReapZeroCopy(struct ncclSocket* sock, uint32_t* completed, int* copied, int* reaped);
 ncclResult_t ncclSocketClose(struct ncclSocket* sock);
 #endif
@@ -51,6 +51,10 @@ struct ncclConnect {
 };
 
 struct ncclTransportComm {
+  // setup and connect may leave proxy calls in flight and return ncclInProgress. The caller
+  // then waits for the proxy responses with ncclProxyCallWaitAll and calls them again with
+  // the same arguments to finish. connectInfo is only complete after that wait, even when
+  // setup returned ncclSuccess.
   ncclResult_t (*setup)(struct ncclComm* comm, struct ncclTopoGraph* graph, struct ncclPeerInfo*, struct ncclPeerInfo*, struct ncclConnect*, struct ncclConnector*, int channelId, int connIndex);
   ncclResult_t (*connect)(struct ncclComm* comm, struct ncclConnect*, int nranks, int rank, struct ncclConnector*);
   ncclResult_t (*free)(struct ncclConnector*);
@@ -16,6 +16,7 @@
 #include "enqueue.h"
 #include "graph.h"
 #include "argcheck.h"
+#include "autotune.h"
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
@@ -184,6 +185,11 @@ static ncclResult_t commFree(ncclComm_t comm) {
   if (comm->proxyState.thread)
     pthread_join(comm->proxyState.thread, nullptr);
 
+  // Saves the tuning model, needs the topology
+  NCCLCHECK(ncclAutotuneFree(comm));
+  NCCLCHECK(ncclPlanCacheFree(comm));
+  ncclTopoFreeAlgoTables(comm);
+
   delete[] comm->userRedOps;
 
   free(comm->connectSend);
@@ -934,6 +940,7 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, ncclUniqueId* comm
     }
     NCCLCHECKGOTO(ncclTopoTuneModel(comm, minCompCap, maxCompCap, &treeGraph, &ringGraph, &collNetGraph), ret, fail);
   } while(0);
+  NCCLCHECKGOTO(ncclAutotuneInit(comm), ret, fail);
 
   // Compute nChannels per peer for p2p
   NCCLCHECKGOTO(ncclTopoComputeP2pChannels(comm), ret, fail);
@@ -948,6 +955,8 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, ncclUniqueId* comm
     tasks->peers = ncclMemoryStackAlloc<ncclTasks::Peer>(&comm->memPermanent, nRanks);
     tasks->p2pSendOrder = ncclMemoryStackAlloc<int>(&comm->memPermanent, nRanks);
     tasks->p2pRecvOrder = ncclMemoryStackAlloc<int>(&comm->memPermanent, nRanks);
+    tasks->p2pStepMask = ncclMemoryStackAlloc<uint64_t>(&comm->memPermanent, DIVUP(nRanks, 64));
+    tasks->p2pSteps = ncclMemoryStackAlloc<int>(&comm->memPermanent, nRanks);
     int s=0, r=0;
     // schedule delta 0, +1, -1, +2, -2, ...
     // also make sure we don't do 0 twice, nor +n/2 and -n/2 if n is even.
@@ -963,11 +972,13 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, ncclUniqueId* comm
         int recvIndex = (localRank-step+steps)%steps;
         if (recvIndex < nodeRanks[recvNode].localRanks) {
           tasks->p2pRecvOrder[r] = nodeRanks[recvNode].localRankToRank[recvIndex];
+          tasks->peers[tasks->p2pRecvOrder[r]].recvStep = r;
           r++;
         }
         int sendIndex = (localRank+step)%steps;
         if (sendIndex < nodeRanks[sendNode].localRanks) {
           tasks->p2pSendOrder[s] = nodeRanks[sendNode].localRankToRank[sendIndex];
+          tasks->peers[tasks->p2pSendOrder[s]].sendStep = s;
           s++;
         }
       }
@@ -1585,6 +1596,7 @@ ncclResult_t ncclCommAbort(ncclComm_t comm) {
 
   (void) commReclaim(comm);
   INFO(NCCL_INIT,"comm %p rank %d nranks %d cudaDev %d busId %lx - Abort COMPLETE", comm, rank, nranks, cudaDev, busId);
+  ncclDebugFlush();
 
   return ncclSuccess;
 }
@@ -1612,6 +1624,17 @@ const char* ncclGetLastError(ncclComm_t comm) {
   return ncclLastError;
 }
 
+NCCL_API(ncclResult_t, ncclParamList, const char** names, long long* values, int maxCount, int* count);
+ncclResult_t ncclParamList(const char** names, long long* values, int maxCount, int* count) {
+  NCCLCHECK(PtrCheck(count, "ParamList", "count"));
+  if (maxCount > 0) {
+    NCCLCHECK(PtrCheck(names, "ParamList", "names"));
+    NCCLCHECK(PtrCheck(values, "ParamList", "values"));
+  }
+  *count = ncclParamGetAll(names, values, maxCount);
+  return ncclSuccess;
+}
+
 NCCL_API(ncclResult_t, ncclCommGetAsyncError, ncclComm_t comm, ncclResult_t *asyncError);
 ncclResult_t ncclCommGetAsyncError(ncclComm_t comm, ncclResult_t *asyncError) {
   NCCLCHECK(PtrCheck(comm, "ncclGetAsyncError", "comm"));
@@ -0,0 +1,144 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include "iouring.h"
+#include "checks.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+ncclResult_t ncclIoUringInit(struct ncclIoUring* ring, unsigned entries) {
+  struct io_uring_params params;
+  memset(ring, 0, sizeof(struct ncclIoUring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = ioUringSetup(entries, &params);
+  if (ring->fd == -1) {
+    // Kernel too old, or io_uring disabled (sysctl, seccomp). The caller decides whether to fall back.
+    INFO(NCCL_NET, "io_uring_setup failed : %s", strerror(errno));
+    return ncclSystemError;
+  }
+  ring->entries = params.sq_entries;
+  ring->sqSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+  ring->cqSize = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) ring->sqSize = ring->cqSize = std::max(ring->sqSize, ring->cqSize);
+  ring->sqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+
+  ring->sqPtr = mmap(NULL, ring->sqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sqPtr == MAP_FAILED) goto fail;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cqPtr = ring->sqPtr;
+  } else {
+    ring->cqPtr = mmap(NULL, ring->cqSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cqPtr == MAP_FAILED) goto fail;
+  }
+  ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) goto fail;
+
+  ring->sqHead = (unsigned*)((char*)ring->sqPtr + params.sq_off.head);
+  ring->sqTail = (unsigned*)((char*)ring->sqPtr + params.sq_off.tail);
+  ring->sqMask = (unsigned*)((char*)ring->sqPtr + params.sq_off.ring_mask);
+  ring->sqArray = (unsigned*)((char*)ring->sqPtr + params.sq_off.array);
+  ring->cqHead = (unsigned*)((char*)ring->cqPtr + params.cq_off.head);
+  ring->cqTail = (unsigned*)((char*)ring->cqPtr + params.cq_off.tail);
+  ring->cqMask = (unsigned*)((char*)ring->cqPtr + params.cq_off.ring_mask);
+  ring->cqes = (char*)ring->cqPtr + params.cq_off.cqes;
+  ring->sqLocalTail = ring->sqSubmitted = *ring->sqTail;
+  return ncclSuccess;
+fail:
+  WARN("io_uring: mmap failed : %s", strerror(errno));
+  if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqesSize);
+  if (ring->cqPtr && ring->cqPtr != MAP_FAILED && ring->cqPtr != ring->sqPtr) munmap(ring->cqPtr, ring->cqSize);
+  if (ring->sqPtr && ring->sqPtr != MAP_FAILED) munmap(ring->sqPtr, ring->sqSize);
+  close(ring->fd);
+  ring->fd = -1;
+  return ncclSystemError;
+}
+
+ncclResult_t ncclIoUringDestroy(struct ncclIoUring* ring) {
+  if (ring->fd == -1) return ncclSuccess;
+  munmap(ring->sqes, ring->sqesSize);
+  if (ring->cqPtr != ring->sqPtr) munmap(ring->cqPtr, ring->cqSize);
+  munmap(ring->sqPtr, ring->sqSize);
+  close(ring->fd);
+  ring->fd = -1;
+  return ncclSuccess;
+}
+
+static ncclResult_t ioUringPrep(struct ncclIoUring* ring, int opcode, int fd, void* ptr, unsigned len, int msgFlags, uint64_t userData) {
+  unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+  if (ring->sqLocalTail - head >= ring->entries) {
+    WARN("io_uring: submission queue full (%u entries)", ring->entries);
+    return ncclInternalError;
+  }
+  unsigned index = ring->sqLocalTail & *ring->sqMask;
+  struct io_uring_sqe* sqe = ((struct io_uring_sqe*)ring->sqes)+index;
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t)ptr;
+  sqe->len = len;
+  sqe->msg_flags = msgFlags;
+  sqe->user_data = userData;
+  ring->sqArray[index] = index;
+  ring->sqLocalTail++;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclIoUringPrepSend(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData) {
+  return ioUringPrep(ring, IORING_OP_SEND, fd, ptr, len, MSG_NOSIGNAL, userData);
+}
+
+ncclResult_t ncclIoUringPrepRecv(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData) {
+  return ioUringPrep(ring, IORING_OP_RECV, fd, ptr, len, 0, userData);
+}
+
+ncclResult_t ncclIoUringPrepRead(struct ncclIoUring* ring, int fd, void* ptr, unsigned len, uint64_t userData) {
+  return ioUringPrep(ring, IORING_OP_READ, fd, ptr, len, 0, userData);
+}
+
+ncclResult_t ncclIoUringSubmit(struct ncclIoUring* ring, int wait) {
+  __atomic_store_n(ring->sqTail, ring->sqLocalTail, __ATOMIC_RELEASE);
+  unsigned toSubmit = ring->sqLocalTail - ring->sqSubmitted;
+  if (toSubmit == 0 && !wait) return ncclSuccess;
+  int ret = ioUringEnter(ring->fd, toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+  if (ret == -1) {
+    // Interrupted or temporarily out of resources: entries stay queued and are resubmitted next time.
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return ncclSuccess;
+    WARN("io_uring_enter failed : %s", strerror(errno));
+    return ncclSystemError;
+  }
+  ring->sqSubmitted += ret;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclIoUringReap(struct ncclIoUring* ring, struct ncclIoUringCqe* cqes, int maxCqes, int* nCqes) {
+  unsigned head = *ring->cqHead;
+  unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+  int n = 0;
+  while (head != tail && n < maxCqes) {
+    struct io_uring_cqe* cqe = ((struct io_uring_cqe*)ring->cqes)+(head & *ring->cqMask);
+    cqes[n].userData = cqe->user_data;
+    cqes[n].res = cqe->res;
+    head++;
+    n++;
+  }
+  __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+  *nCqes = n;
+  return ncclSuccess;
+}
@@ -50,6 +50,12 @@ void setEnvFile(const char* fileName) {
 
 void initEnv() {
   char confFilePath[1024];
+  // Files are applied in order of precedence, without overriding variables already set
+  const char* confFile = getenv("NCCL_CONF_FILE");
+  if (confFile && strlen(confFile) > 0) {
+    INFO(NCCL_ENV, "NCCL_CONF_FILE set by environment to %s", confFile);
+    setEnvFile(confFile);
+  }
   const char * userDir = userHomeDir();
   if (userDir) {
     sprintf(confFilePath, "%s/.nccl.conf", userDir);
@@ -57,25 +63,97 @@ void initEnv() {
   }
   sprintf(confFilePath, "/etc/nccl.conf");
   setEnvFile(confFilePath);
+  ncclParamDump();
 }
 
-void ncclLoadParam(char const* env, int64_t deftVal, int64_t uninitialized, int64_t* cache) {
-  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-  pthread_mutex_lock(&mutex);
-  if (__atomic_load_n(cache, __ATOMIC_RELAXED) == uninitialized) {
-    char* str = getenv(env);
-    int64_t value = deftVal;
-    if (str && strlen(str) > 0) {
-      errno = 0;
-      value = strtoll(str, nullptr, 0);
-      if (errno) {
-        value = deftVal;
-        INFO(NCCL_ALL,"Invalid value %s for %s, using default %lld.", str, env, (long long)deftVal);
-      } else {
-        INFO(NCCL_ALL,"%s set by environment to %lld.", env, (long long)value);
-      }
+// Registration happens from static constructors, in any order with respect to other
+// translation units, so everything below must be usable before dynamic initialization.
+static pthread_mutex_t paramLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ncclParamDesc** paramDescs = NULL;
+static int paramCount = 0;
+static int paramMaxCount = 0;
+
+// Sets *str to the variable if it is set, and *invalid if it does not parse
+static int64_t paramFromEnv(struct ncclParamDesc* desc, const char** str, bool* invalid) {
+  *str = getenv(desc->env);
+  *invalid = false;
+  int64_t value = desc->deftVal;
+  if (*str && strlen(*str) > 0) {
+    errno = 0;
+    value = strtoll(*str, nullptr, 0);
+    if (errno) {
+      value = desc->deftVal;
+      *invalid = true;
     }
-    __atomic_store_n(cache, value, __ATOMIC_RELAXED);
+  } else {
+    *str = NULL;
+  }
+  return value;
+}
+
+// Caller holds paramLock
+static void paramRegisterLocked(struct ncclParamDesc* desc) {
+  if (desc->id >= 0) return;
+  if (paramCount == paramMaxCount) {
+    int newMaxCount = std::max(64, 2*paramMaxCount);
+    struct ncclParamDesc** descs = (struct ncclParamDesc**)realloc(paramDescs, newMaxCount*sizeof(*descs));
+    // Stays unregistered if out of memory, it is then only missing from ncclParamList
+    if (descs == NULL) return;
+    paramDescs = descs;
+    paramMaxCount = newMaxCount;
+  }
+  paramDescs[paramCount] = desc;
+  __atomic_store_n(&desc->id, paramCount++, __ATOMIC_RELEASE);
+}
+
+// Parameters not read yet report what their first read would return
+static int64_t paramValueLocked(struct ncclParamDesc* desc) {
+  int64_t value = __atomic_load_n(&desc->cache, __ATOMIC_ACQUIRE);
+  if (value != NCCL_PARAM_UNINITIALIZED) return value;
+  const char* str;
+  bool invalid;
+  return paramFromEnv(desc, &str, &invalid);
+}
+
+void ncclParamRegister(struct ncclParamDesc* desc) {
+  pthread_mutex_lock(&paramLock);
+  paramRegisterLocked(desc);
+  pthread_mutex_unlock(&paramLock);
+}
+
+// No lock : threads racing on the first read parse the same value and the first one
+// to publish it logs it.
+int64_t ncclLoadParam(struct ncclParamDesc* desc) {
+  // May be read from a static constructor that runs before the parameter's own
+  if (__atomic_load_n(&desc->id, __ATOMIC_ACQUIRE) < 0) ncclParamRegister(desc);
+  const char* str;
+  bool invalid;
+  int64_t value = paramFromEnv(desc, &str, &invalid);
+  int64_t current = NCCL_PARAM_UNINITIALIZED;
+  if (!__atomic_compare_exchange_n(&desc->cache, &current, value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) return current;
+  if (invalid) {
+    INFO(NCCL_ALL,"Invalid value %s for %s, using default %lld.", str, desc->env, (long long)desc->deftVal);
+  } else if (str) {
+    INFO(NCCL_ALL,"%s set by environment to %lld.", desc->env, (long long)value);
+  }
+  return value;
+}
+
+int ncclParamGetAll(const char** envs, long long* values, int maxCount) {
+  pthread_mutex_lock(&paramLock);
+  int count = paramCount;
+  for (int i=0; i<std::min(count, maxCount); i++) {
+    envs[i] = paramDescs[i]->env;
+    values[i] = paramValueLocked(paramDescs[i]);
+  }
+  pthread_mutex_unlock(&paramLock);
+  return count;
+}
+
+void ncclParamDump() {
+  pthread_mutex_lock(&paramLock);
+  for (int i=0; i<paramCount; i++) {
+    INFO(NCCL_ENV, "%s %lld (default %lld)", paramDescs[i]->env, (long long)paramValueLocked(paramDescs[i]), (long long)paramDescs[i]->deftVal);
   }
-  pthread_mutex_unlock(&mutex);
+  pthread_mutex_unlock(&paramLock);
 }
@@ -5,16 +5,14 @@
  ************************************************************************/
 
 #include "profiler.h"
-
-//#define PROFILE_PROXY 1
-#ifdef PROFILE_PROXY
-#include "timer.h"
-#include "alloc.h"
+#include "core.h"
+#include <signal.h>
 
 static const char* profilingStateSendStr[] = { "BufferWait", "GPUWait", "SendWait", "", "End" };
 static const char* profilingStateRecvStr[] = { "BufferWait", "RecvWait", "FlushWait", "GPUWait", "End" };
 static const char* profilingEventStr[] = { "SendRecv", "Sleep", "Idle", "Append" };
 struct ncclProxyProfileEvent {
+  uint64_t seq; // Position of the event in its ring plus one, 0 while being overwritten
   double timestamp[6];
   uint64_t opCount;
   int peer;
@@ -24,20 +22,119 @@ struct ncclProxyProfileEvent {
   uint8_t opIndex;
 };
 
-struct ncclProxyProfileEvent* profilingEvents = NULL;
-int profilingIndex = 0;
-double profilingStart = 0;
-#define MAX_EVENTS 200000
+// Each thread records into its own ring, overwriting the oldest events once full.
+// Rings are never freed; when a thread exits, its ring is handed to the next thread
+// which starts recording.
+struct ncclProxyProfileRing {
+  struct ncclProxyProfileRing* next;
+  int id;
+  int inUse;
+  uint64_t head; // Number of events recorded so far
+  struct ncclProxyProfileEvent* events;
+  void* threadEvents[4]; // Sleep, Idle and Append events in progress, indexed by state/8
+};
+
+NCCL_PARAM(ProxyProfileEvents, "PROXY_PROFILE_EVENTS", 65536);
+// Signal to request a snapshot of the last NCCL_PROXY_PROFILE_WINDOW seconds
+NCCL_PARAM(ProxyProfileSignal, "PROXY_PROFILE_SIGNAL", -1);
+NCCL_PARAM(ProxyProfileWindow, "PROXY_PROFILE_WINDOW", 10);
+// Signal to turn recording on and off while the job runs
+NCCL_PARAM(ProxyProfileToggleSignal, "PROXY_PROFILE_TOGGLE_SIGNAL", -1);
+
+int ncclProfilingEnabled = 0;
+static pthread_once_t profilingOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t profilingLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t profilingKey;
+static struct ncclProxyProfileRing* profilingRings = NULL;
+static int profilingNRings = 0;
+static uint64_t profilingRingSize = 0;
+static uint64_t profilingStart = 0;
+static __thread struct ncclProxyProfileRing* profilingRing = NULL;
+static volatile sig_atomic_t profilingSnapshotRequested = 0;
+static int profilingSnapshotCount = 0;
+
+static void profilingRingRelease(void* ring) {
+  __atomic_store_n(&((struct ncclProxyProfileRing*)ring)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static void profilingSignalHandler(int sig) {
+  profilingSnapshotRequested = 1;
+}
+
+static void profilingToggleHandler(int sig) {
+  __atomic_xor_fetch(&ncclProfilingEnabled, 1, __ATOMIC_RELAXED);
+}
 
-ncclResult_t ncclProfilingRecord(struct ncclProxyArgs* args, int sub, int step, int state) {
-  if (profilingEvents == NULL) {
-    NCCLCHECK(ncclCalloc(&profilingEvents, MAX_EVENTS));
-    profilingStart = gettime();
+static void profilingInit() {
+  pthread_key_create(&profilingKey, profilingRingRelease);
+  profilingStart = clockNano();
+  profilingRingSize = 1;
+  while (profilingRingSize < (uint64_t)ncclParamProxyProfileEvents()) profilingRingSize <<= 1;
+  const int sig = ncclParamProxyProfileSignal();
+  if (sig != -1) signal(sig, profilingSignalHandler);
+  const int toggleSig = ncclParamProxyProfileToggleSignal();
+  if (toggleSig != -1) {
+    INFO(NCCL_INIT, "Proxy profiler : signal %d turns recording on and off", toggleSig);
+    signal(toggleSig, profilingToggleHandler);
+  }
+  if (getenv("NCCL_PROXY_PROFILE") || sig != -1) {
+    INFO(NCCL_INIT, "Proxy profiler enabled, %ld events per thread", profilingRingSize);
+    __atomic_store_n(&ncclProfilingEnabled, 1, __ATOMIC_RELAXED);
   }
-  struct ncclProxyProfileEvent* event = NULL;
+}
+
+void ncclProfilingInit() {
+  pthread_once(&profilingOnce, profilingInit);
+}
+
+static ncclResult_t profilingGetRing(struct ncclProxyProfileRing** ringPtr) {
+  struct ncclProxyProfileRing* ring;
+  pthread_mutex_lock(&profilingLock);
+  for (ring = profilingRings; ring; ring = ring->next) {
+    if (__atomic_load_n(&ring->inUse, __ATOMIC_ACQUIRE) == 0) break;
+  }
+  if (ring == NULL) {
+    ncclResult_t ret = ncclCalloc(&ring, 1);
+    if (ret == ncclSuccess) {
+      ret = ncclCalloc(&ring->events, profilingRingSize);
+      if (ret != ncclSuccess) free(ring);
+    }
+    if (ret != ncclSuccess) {
+      pthread_mutex_unlock(&profilingLock);
+      return ret;
+    }
+    ring->id = profilingNRings++;
+    ring->next = profilingRings;
+    profilingRings = ring;
+  }
+  ring->inUse = 1;
+  pthread_mutex_unlock(&profilingLock);
+  pthread_setspecific(profilingKey, ring);
+  *ringPtr = profilingRing = ring;
+  return ncclSuccess;
+}
+
+static double profilingTime() {
+  return (clockNano()-profilingStart)/1e3;
+}
+
+ncclResult_t ncclProfilingRecordEvent(struct ncclProxyArgs* args, int sub, int step, int state) {
+  struct ncclProxyProfileRing* ring = profilingRing;
+  if (ring == NULL) {
+    pthread_once(&profilingOnce, profilingInit);
+    NCCLCHECK(profilingGetRing(&ring));
+  }
+  const uint64_t mask = profilingRingSize-1;
+  // Events which are not tied to an op only have a placeholder args, keep their state in the ring
+  void** eventPtr = state < ncclProxyProfileSleep ? args->subs[sub].profilingEvents+(step%NCCL_STEPS) : ring->threadEvents+state/8;
+  struct ncclProxyProfileEvent* event;
   if (state%8 == 0) {
-    if (profilingIndex == MAX_EVENTS) return ncclSuccess;
-    args->subs[sub].profilingEvents[step%NCCL_STEPS] = event = profilingEvents+profilingIndex++;
+    uint64_t seq = ring->head+1;
+    event = ring->events+(ring->head & mask);
+    // Let snapshots know the event is being overwritten
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset(event->timestamp, 0, sizeof(event->timestamp));
     if (state == ncclProxyProfileBegin) {
       // Proxy operation information
       event->opCount = args->opCount;
@@ -47,69 +144,110 @@ ncclResult_t ncclProfilingRecord(struct ncclProxyArgs* args, int sub, int step,
       event->step = step;
       event->opIndex = (((uint64_t)args)/sizeof(struct ncclProxyArgs))%256;
     } else event->peer = -state;
-  } else {
-    event = (struct ncclProxyProfileEvent*)args->subs[sub].profilingEvents[step%NCCL_STEPS];
-    if (state == ncclProxyProfileEnd) args->subs[sub].profilingEvents[step%NCCL_STEPS] = NULL;
-    if (state == ncclProxyProfileAppendEnd) event->opCount = args->opCount;
+    event->timestamp[0] = profilingTime();
+    __atomic_store_n(&event->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, seq, __ATOMIC_RELEASE);
+    // Later states find the event through its sequence number, so that we can tell if it was overwritten
+    *eventPtr = (void*)seq;
+    return ncclSuccess;
   }
+  uint64_t seq = (uint64_t)*eventPtr;
+  if (state == ncclProxyProfileEnd) *eventPtr = NULL;
+  // Begin was not recorded (profiling was off) or the ring wrapped around since.
+  if (seq == 0 || seq > ring->head) return ncclSuccess;
+  event = ring->events+((seq-1) & mask);
+  if (event->seq != seq) return ncclSuccess;
+  if (state == ncclProxyProfileAppendEnd) event->opCount = args->opCount;
   // Timestamp
-  event->timestamp[state%8] = gettime()-profilingStart;
+  event->timestamp[state%8] = profilingTime();
   return ncclSuccess;
 }
 
-void ncclProfilingDump() {
-  static int dumpDone = 0;
-  if (dumpDone) return;
-  dumpDone = 1;
-  const char* str = getenv("NCCL_PROXY_PROFILE");
-  if (!str) { free(profilingEvents); return; }
-  FILE* f = fopen(str, "w");
-  fprintf(f, "[\n");
+static void profilingPrintEvent(FILE* f, struct ncclProxyProfileEvent* e, int i, int tid) {
+  const int sendrecv = e->peer >= 0;
+  const char* typeStr = sendrecv ? (e->type == ncclPatternSend ? "Send" : "Recv") :
+    profilingEventStr[-(e->peer/8)];
+
+  if (sendrecv) {
+    int state = ncclProxyProfileBegin;
+    const char** stateStr = e->type == ncclPatternSend ? profilingStateSendStr : profilingStateRecvStr;
+    fprintf(f, "{\"name\": \"%s-%d-%d\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": %d, \"tid\": %d, \"ts\": %f, \"args\": { \"opCount\": %ld, \"proxyOpIndex\":%d } },\n",
+        typeStr, e->peer, e->step, i, e->channel, tid, e->timestamp[state], e->opCount, e->opIndex);
 
-  for (int i=0; i<profilingIndex; i++) {
-    struct ncclProxyProfileEvent* e = profilingEvents+i;
-    const int sendrecv = e->peer >= 0;
-    const char* typeStr = sendrecv ? (e->type == ncclPatternSend ? "Send" : "Recv") :
-      profilingEventStr[-(e->peer/8)];
-
-
-    if (sendrecv) {
-      int state = ncclProxyProfileBegin;
-      const char** stateStr = e->type == ncclPatternSend ? profilingStateSendStr : profilingStateRecvStr;
-      fprintf(f, "{\"name\": \"%s-%d-%d\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": %d, \"tid\": 1, \"ts\": %f, \"args\": { \"opCount\": %ld, \"proxyOpIndex\":%d } },\n",
-          typeStr, e->peer, e->step, i, e->channel, e->timestamp[state], e->opCount, e->opIndex);
-
-      while (state<ncclProxyProfileEnd) {
-        if (e->timestamp[state]) {
-          const char* name = stateStr[state];
-          fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": %d, \"tid\": 1, \"ts\": %f },\n",
-              name, i, e->channel, e->timestamp[state]);
-          state++;
-          while (e->timestamp[state] == 0) state++;
-          fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": %d, \"tid\": 1, \"ts\": %f },\n",
-              name, i, e->channel, e->timestamp[state]);
-        }
-      }
-
-      fprintf(f, "{\"name\": \"%s-%d-%d\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": %d, \"tid\": 1, \"ts\": %f },\n",
-          typeStr, e->peer, e->step, i, e->channel, e->timestamp[state]);
+    while (state<ncclProxyProfileEnd) {
+      const char* name = stateStr[state];
+      double start = e->timestamp[state];
+      state++;
+      while (state < ncclProxyProfileEnd && e->timestamp[state] == 0) state++;
+      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": %d, \"tid\": %d, \"ts\": %f },\n",
+          name, i, e->channel, tid, start);
+      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": %d, \"tid\": %d, \"ts\": %f },\n",
+          name, i, e->channel, tid, e->timestamp[state]);
+    }
+
+    fprintf(f, "{\"name\": \"%s-%d-%d\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": %d, \"tid\": %d, \"ts\": %f },\n",
+        typeStr, e->peer, e->step, i, e->channel, tid, e->timestamp[state]);
+  } else {
+    if (e->peer == -ncclProxyProfileAppend) {
+      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": -1, \"tid\": %d, \"ts\": %f, \"args\": { \"added\": %ld } },\n",
+          typeStr, i, tid, e->timestamp[0], e->opCount);
     } else {
-      if (e->peer == -ncclProxyProfileAppend) {
-      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": -1, \"tid\": 1, \"ts\": %f, \"args\": { \"added\": %ld } },\n",
-          typeStr, i, e->timestamp[0], e->opCount);
-      } else {
-        fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": -1, \"tid\": 1, \"ts\": %f },\n",
-          typeStr, i, e->timestamp[0]);
-      }
-      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": -1, \"tid\": 1, \"ts\": %f },\n",
-          typeStr, i, e->timestamp[1]);
+      fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"b\", \"id\": %d, \"pid\": -1, \"tid\": %d, \"ts\": %f },\n",
+          typeStr, i, tid, e->timestamp[0]);
+    }
+    fprintf(f, "{\"name\": \"%s\", \"cat\": \"NET\", \"ph\": \"e\", \"id\": %d, \"pid\": -1, \"tid\": %d, \"ts\": %f },\n",
+        typeStr, i, tid, e->timestamp[1]);
+  }
+}
+
+// Write events which started during the last `seconds` seconds (all events if seconds <= 0) to filename
+static ncclResult_t profilingSnapshot(const char* filename, double seconds) {
+  pthread_once(&profilingOnce, profilingInit);
+  FILE* f = fopen(filename, "w");
+  if (f == NULL) {
+    WARN("Proxy profiler : could not open %s : %s", filename, strerror(errno));
+    return ncclSystemError;
+  }
+  const double from = seconds > 0 ? profilingTime() - seconds*1e6 : 0;
+  int i = 0;
+  fprintf(f, "[\n");
+  pthread_mutex_lock(&profilingLock);
+  for (struct ncclProxyProfileRing* ring = profilingRings; ring; ring = ring->next) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > profilingRingSize ? head-profilingRingSize+1 : 1;
+    for (uint64_t seq = first; seq <= head; seq++) {
+      struct ncclProxyProfileEvent* src = ring->events+((seq-1) & (profilingRingSize-1));
+      struct ncclProxyProfileEvent e = {};
+      memcpy(&e, src, sizeof(struct ncclProxyProfileEvent));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      // Skip events overwritten while we copied them, and those still in progress
+      if (e.seq != seq || __atomic_load_n(&src->seq, __ATOMIC_RELAXED) != seq) continue;
+      if (e.timestamp[0] < from) continue;
+      if (e.timestamp[e.peer >= 0 ? ncclProxyProfileEnd : 1] == 0) continue;
+      profilingPrintEvent(f, &e, i++, ring->id+1);
     }
   }
+  pthread_mutex_unlock(&profilingLock);
   fprintf(f, "{} ]\n");
   fclose(f);
-  free(profilingEvents);
+  INFO(NCCL_INIT, "Proxy profiler : wrote %d events to %s", i, filename);
+  return ncclSuccess;
+}
+
+void ncclProfilingCheckSnapshot() {
+  if (profilingSnapshotRequested == 0) return;
+  if (__sync_lock_test_and_set(&profilingSnapshotRequested, 0) == 0) return;
+  const char* str = getenv("NCCL_PROXY_PROFILE");
+  char filename[PATH_MAX];
+  snprintf(filename, PATH_MAX, "%s.%d.%d", str ? str : "/tmp/nccl_proxy_profile", getpid(), profilingSnapshotCount++);
+  profilingSnapshot(filename, ncclParamProxyProfileWindow());
+}
+
+void ncclProfilingDump() {
+  static int dumpDone = 0;
+  if (dumpDone) return;
+  dumpDone = 1;
+  const char* str = getenv("NCCL_PROXY_PROFILE");
+  if (!str) return;
+  profilingSnapshot(str, 0);
 }
-#else
-ncclResult_t ncclProfilingRecord(struct ncclProxyArgs* args, int sub, int step, int state) { return ncclSuccess; }
-void ncclProfilingDump() {}
-#endif
@@ -11,6 +11,20 @@
 #include <unistd.h>
 #include <ifaddrs.h>
 #include <net/if.h>
+#include <linux/errqueue.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
 
 static ncclResult_t socketProgressOpt(int op, struct ncclSocket* sock, void* ptr, int size, int* offset, int block, int* closed) {
   int bytes = 0;
@@ -731,12 +745,16 @@ fail:
   goto exit;
 }
 
-ncclResult_t ncclSocketProgress(int op, struct ncclSocket* sock, void* ptr, int size, int* offset) {
+ncclResult_t ncclSocketProgress(int op, struct ncclSocket* sock, void* ptr, int size, int* offset, int* closed) {
   if (sock == NULL) {
     WARN("ncclSocketProgress: pass NULL socket");
     return ncclInvalidArgument;
   }
-  NCCLCHECK(socketProgress(op, sock, ptr, size, offset));
+  if (closed) {
+    NCCLCHECK(socketProgressOpt(op, sock, ptr, size, offset, 0, closed));
+  } else {
+    NCCLCHECK(socketProgress(op, sock, ptr, size, offset));
+  }
   return ncclSuccess;
 }
 
@@ -792,6 +810,87 @@ ncclResult_t ncclSocketTryRecv(struct ncclSocket* sock, void* ptr, int size, int
   return ncclSuccess;
 }
 
+ncclResult_t ncclSocketEnableZeroCopy(struct ncclSocket* sock, int* enabled) {
+  int one = 1;
+  if (sock == NULL) {
+    WARN("ncclSocketEnableZeroCopy: pass NULL socket");
+    return ncclInvalidArgument;
+  }
+  *enabled = 0;
+  if (setsockopt(sock->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0) {
+    *enabled = 1;
+  } else {
+    // Not supported by this kernel or socket type; the caller falls back to regular sends.
+    INFO(NCCL_NET, "ncclSocketEnableZeroCopy: setsockopt(SO_ZEROCOPY) failed : %s", strerror(errno));
+  }
+  return ncclSuccess;
+}
+
+ncclResult_t ncclSocketProgressZeroCopy(struct ncclSocket* sock, void* ptr, int size, int* offset, uint32_t* seq) {
+  char* data = (char*)ptr;
+  char line[SOCKET_NAME_MAXLEN+1];
+  int bytes;
+  if (sock == NULL) {
+    WARN("ncclSocketProgressZeroCopy: pass NULL socket");
+    return ncclInvalidArgument;
+  }
+  do {
+    bytes = send(sock->fd, data+(*offset), size-(*offset), MSG_DONTWAIT | MSG_NOSIGNAL | MSG_ZEROCOPY);
+    if (bytes == -1) {
+      // ENOBUFS means too many pages are still pinned by pending completions; retry once some are reaped.
+      if (errno != EINTR && errno != EWOULDBLOCK && errno != EAGAIN && errno != ENOBUFS) {
+        WARN("ncclSocketProgressZeroCopy: Call to send to %s failed : %s", ncclSocketToString(&sock->addr, line), strerror(errno));
+        return ncclRemoteError;
+      }
+      bytes = 0;
+    } else {
+      (*seq)++;
+    }
+    (*offset) += bytes;
+    if (sock->abortFlag && *sock->abortFlag != 0) {
+      INFO(NCCL_NET, "ncclSocketProgressZeroCopy: abort called");
+      return ncclInternalError;
+    }
+  } while (bytes > 0 && (*offset) < size);
+  return ncclSuccess;
+}
+
+ncclResult_t ncclSocketReapZeroCopy(struct ncclSocket* sock, uint32_t* completed, int* copied, int* reaped) {
+  char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+  char line[SOCKET_NAME_MAXLEN+1];
+  if (sock == NULL) {
+    WARN("ncclSocketReapZeroCopy: pass NULL socket");
+    return ncclInvalidArgument;
+  }
+  *reaped = 0;
+  while (1) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return ncclSuccess;
+      if (errno == EINTR) continue;
+      WARN("ncclSocketReapZeroCopy: Call to recvmsg from %s failed : %s", ncclSocketToString(&sock->addr, line), strerror(errno));
+      return ncclRemoteError;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) continue;
+      struct sock_extended_err* serr = (struct sock_extended_err*)CMSG_DATA(cm);
+      if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        WARN("ncclSocketReapZeroCopy: unexpected error on %s : %s", ncclSocketToString(&sock->addr, line), strerror(serr->ee_errno));
+        return ncclRemoteError;
+      }
+      // [ee_info, ee_data] is the range of completed sends. TCP reports them in order.
+      uint32_t next = serr->ee_data + 1;
+      if ((int32_t)(next - *completed) > 0) *completed = next;
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) *copied = 1;
+      *reaped = 1;
+    }
+  }
+}
+
 ncclResult_t ncclSocketClose(struct ncclSocket* sock) {
   if (sock != NULL) {
     if (sock->fd >= 0) close(sock->fd);
@@ -269,6 +269,7 @@ unhunked:
 
 malloc_exhausted:
   WARN("%s:%d Unrecoverable error detected: malloc(size=%llu) returned null.", __FILE__, __LINE__, (unsigned long long)mallocSize);
+  ncclDebugFlush();
   abort();
 }
 
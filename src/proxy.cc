@@ -14,6 +14,10 @@
 #include "timer.h"
 
 #include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/futex.h>
 
 enum { proxyRecv=0, proxySend=1 };
 
@@ -37,9 +41,9 @@ struct ncclProxyPool {
   struct ncclProxyArgs elems[PROXYARGS_ALLOCATE_SIZE];
 };
 
-static ncclResult_t allocateArgs(struct ncclProxyProgressState* state, struct ncclProxyArgs** argsptr) {
+static ncclResult_t allocateArgs(struct ncclProxyShard* shard, struct ncclProxyArgs** argsptr) {
   struct ncclProxyArgs* elem;
-  if (state->pool == NULL) {
+  if (shard->pool == NULL) {
     // Allocate a new pool of elements. Make sure we allocate the memory close
     // to the network thread
     struct ncclProxyPool* newPool;
@@ -51,13 +55,13 @@ static ncclResult_t allocateArgs(struct ncclProxyProgressState* state, struct nc
       if (i+1 < PROXYARGS_ALLOCATE_SIZE) newElems[i].next = newElems+i+1;
     }
     // Add them all to the pool list
-    state->pool = newElems;
+    shard->pool = newElems;
     // Save the pool memory block for later resource release
-    newPool->next = state->pools;
-    state->pools = newPool;
+    newPool->next = shard->pools;
+    shard->pools = newPool;
   }
-  elem = state->pool;
-  state->pool = state->pool->next;
+  elem = shard->pool;
+  shard->pool = shard->pool->next;
   elem->next = elem->nextPeer = NULL;
   *argsptr = elem;
   return ncclSuccess;
@@ -70,11 +74,11 @@ static ncclResult_t allocateArgs(struct ncclProxyProgressState* state, struct nc
 #define DEBUG_PROXY_PRINT(...)
 #endif
 
-#define OP_INDEX(op) ((op) ? (op)-state->pools->elems : -1)
+#define OP_INDEX(op) ((op) ? (op)-shard->pools->elems : -1)
 #define OP_SEEN 0x100000
 
-ncclResult_t getOpIndex(struct ncclProxyArgs* op, struct ncclProxyProgressState* state, int* poolIndex, int* opIndex) {
-  struct ncclProxyPool* pool = state->pools;
+ncclResult_t getOpIndex(struct ncclProxyArgs* op, struct ncclProxyShard* shard, int* poolIndex, int* opIndex) {
+  struct ncclProxyPool* pool = shard->pools;
   int p = 0;
   while (pool) {
     uint64_t o = op-pool->elems;
@@ -117,12 +121,12 @@ ncclResult_t printProxyOp(struct ncclProxyArgs* op, int poolIndex, int opIndex)
   printf("]");
   return ncclSuccess;
 }
-ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
-  struct ncclProxyArgs* op = state->active;
+ncclResult_t dumpProxyState(struct ncclProxyShard* shard) {
+  struct ncclProxyArgs* op = shard->active;
   int poolIndex, opIndex;
   printf("ACTIVE OPS\n");
   while (op) {
-    NCCLCHECK(getOpIndex(op, state, &poolIndex, &opIndex));
+    NCCLCHECK(getOpIndex(op, shard, &poolIndex, &opIndex));
     if (op->state & OP_SEEN) {
       WARN("List loop at element %d-%d", poolIndex, opIndex);
     }
@@ -131,7 +135,7 @@ ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
     printf("\n");
     struct ncclProxyArgs* nextOp = op->nextPeer;
     while (nextOp) {
-      NCCLCHECK(getOpIndex(nextOp, state, &poolIndex, &opIndex));
+      NCCLCHECK(getOpIndex(nextOp, shard, &poolIndex, &opIndex));
       if (nextOp->state & OP_SEEN) {
         WARN("List loop at element %d-%d", poolIndex, opIndex);
       }
@@ -152,9 +156,9 @@ ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
 
 # if 0
   printf("FREE OPS\n");
-  op = state->pool;
+  op = shard->pool;
   while (op) {
-    NCCLCHECK(getOpIndex(op, state, &poolIndex, &opIndex));
+    NCCLCHECK(getOpIndex(op, shard, &poolIndex, &opIndex));
     if (op->state & OP_SEEN) {
       WARN("List loop at element %d-%d", poolIndex, opIndex);
     }
@@ -165,9 +169,9 @@ ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
   }
   printf("[X]\n");
 #else
-  op = state->pool;
+  op = shard->pool;
   while (op) {
-    NCCLCHECK(getOpIndex(op, state, &poolIndex, &opIndex));
+    NCCLCHECK(getOpIndex(op, shard, &poolIndex, &opIndex));
     if (op->state & OP_SEEN) {
       WARN("List loop at element %d-%d", poolIndex, opIndex);
     }
@@ -176,7 +180,7 @@ ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
   }
 #endif
 
-  struct ncclProxyPool* pool = state->pools;
+  struct ncclProxyPool* pool = shard->pools;
   poolIndex = 0;
   while (pool) {
     struct ncclProxyArgs* elem = pool->elems;
@@ -195,12 +199,17 @@ ncclResult_t dumpProxyState(struct ncclProxyProgressState* state) {
   return ncclSuccess;
 }
 
-static ncclResult_t ncclProxyOpToArgs(struct ncclProxyOp* op, struct ncclProxyArgs* args, int subIndex) {
-  struct ncclProxySubArgs* sub = args->subs+subIndex;
+static ncclResult_t ncclProxyOpToArgs(struct ncclProxyShard* shard, struct ncclProxyOp* op, struct ncclProxyArgs* args, int subIndex) {
   if (subIndex >= NCCL_PROXY_MAX_SUBS) {
     WARN("Proxy append out of bounds");
     return ncclInternalError;
   }
+  if (subIndex && args->state != ncclProxyOpReady) {
+    WARN("Proxy append on running operation");
+    return ncclInternalError;
+  }
+  NCCLCHECK(ncclProxySubsReserve(shard, args, subIndex));
+  struct ncclProxySubArgs* sub = args->subs+subIndex;
 
   //memset(sub, 0, sizeof(struct ncclProxySubArgs));
   sub->connection = op->connection;
@@ -218,14 +227,11 @@ static ncclResult_t ncclProxyOpToArgs(struct ncclProxyOp* op, struct ncclProxyAr
       WARN("Proxy append mismatch");
       return ncclInternalError;
     }
-    if (args->state != ncclProxyOpReady) {
-      WARN("Proxy append on running operation");
-      return ncclInternalError;
-    }
     return ncclSuccess;
   }
   //memset(&args->progress, 0, sizeof(struct ncclProxyArgs)-offsetof(struct ncclProxyArgs, progress));
   args->done = 0;
+  args->netInflight = 0;
   args->opCount = op->opCount;
   args->sliceSteps = op->sliceSteps;
   args->chunkSteps = op->chunkSteps;
@@ -240,34 +246,34 @@ static ncclResult_t ncclProxyOpToArgs(struct ncclProxyOp* op, struct ncclProxyAr
   return ncclSuccess;
 }
 
-static ncclResult_t ProxyAppend(struct ncclProxyProgressState* state, struct ncclProxyOp* op) {
+static ncclResult_t ProxyAppend(struct ncclProxyShard* shard, struct ncclProxyOp* op) {
   struct ncclProxyConnection* connection = op->connection;
   int shared = connection->shared;
   struct ncclProxyArgs* args = *connection->proxyAppendPtr;
 
   if (args) {
     if (shared && args->opCount == op->opCount) {
-      NCCLCHECK(ncclProxyOpToArgs(op, args, args->nsubs));
+      NCCLCHECK(ncclProxyOpToArgs(shard, op, args, args->nsubs));
       DEBUG_PROXY_PRINT("Insert (%d/%5ld/%5ld) as group with %5ld\n", shared, args->opCount, op->opCount, OP_INDEX(args));
     } else {
       struct ncclProxyArgs* prevArgs = args;
-      NCCLCHECK(allocateArgs(state, &args));
-      NCCLCHECK(ncclProxyOpToArgs(op, args, 0));
+      NCCLCHECK(allocateArgs(shard, &args));
+      NCCLCHECK(ncclProxyOpToArgs(shard, op, args, 0));
       prevArgs->nextPeer = args;
       DEBUG_PROXY_PRINT("Insert  %5ld (%d/%5ld/%5ld) as nextPeer of %5ld\n", OP_INDEX(args), shared, prevArgs->opCount, args->opCount, OP_INDEX(prevArgs));
       *(args->proxyAppendPtr) = args;
     }
   } else {
     // Nothing running for that peer. Add to the list
-    NCCLCHECK(allocateArgs(state, &args));
-    NCCLCHECK(ncclProxyOpToArgs(op, args, 0));
-    if (state->active == NULL) {
+    NCCLCHECK(allocateArgs(shard, &args));
+    NCCLCHECK(ncclProxyOpToArgs(shard, op, args, 0));
+    if (shard->active == NULL) {
       // Create the list
       DEBUG_PROXY_PRINT("Insert  %5ld (%d/%5ld) as first element\n", OP_INDEX(args), shared, args->opCount);
-      state->active = args;
+      shard->active = args;
     } else {
       // Append element at the end of the list
-      struct ncclProxyArgs* last = state->active;
+      struct ncclProxyArgs* last = shard->active;
       while (last->next) last = last->next;
       last->next = args;
       DEBUG_PROXY_PRINT("Insert  %5ld (%d/%5ld) as last element\n", OP_INDEX(args), shared, args->opCount);
@@ -277,16 +283,28 @@ static ncclResult_t ProxyAppend(struct ncclProxyProgressState* state, struct ncc
   return ncclSuccess;
 }
 
+// The pool lives in shared memory, so use process-shared futexes
+// timeout is relative, NULL to wait until woken up
+static void proxyOpsPoolWait(struct ncclProxyOpsPool* pool, const struct timespec* timeout) {
+  syscall(SYS_futex, &pool->sleeping, FUTEX_WAIT, 1, timeout, NULL, 0);
+}
+
+static void proxyOpsPoolWake(struct ncclProxyOpsPool* pool) {
+  __atomic_store_n(&pool->sleeping, 0, __ATOMIC_SEQ_CST);
+  syscall(SYS_futex, &pool->sleeping, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
 ncclResult_t ncclProxyPost(struct ncclProxyOpsPool* pool, int nextOps, int nextOpsEnd) {
-  pthread_mutex_lock(&pool->mutex);
-  if (pool->nextOps == -1) {
-    pool->nextOps = nextOps;
-    pthread_cond_signal(&pool->cond);
+  int prev = __atomic_exchange_n(&pool->nextOpsEnd, nextOpsEnd, __ATOMIC_SEQ_CST);
+  if (prev == -1) {
+    __atomic_store_n(&pool->nextOps, nextOps, __ATOMIC_RELEASE);
+    // The queue was empty, the progress thread may be asleep. It sets sleeping before
+    // checking nextOpsEnd one last time, so one of us sees the other.
+    if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST)) proxyOpsPoolWake(pool);
   } else {
-    pool->ops[pool->nextOpsEnd].next = nextOps;
+    // The progress thread waits for this link if it already detached the chain
+    __atomic_store_n(&pool->ops[prev].next, nextOps, __ATOMIC_RELEASE);
   }
-  pool->nextOpsEnd = nextOpsEnd;
-  pthread_mutex_unlock(&pool->mutex);
   return ncclSuccess;
 }
 
@@ -478,9 +496,126 @@ ncclResult_t ncclProxyComputeP2p(struct ncclInfo* info, struct ncclProxyOp* op)
   return ncclSuccess;
 }
 
-static ncclResult_t removeOp(struct ncclProxyProgressState* state, struct ncclProxyArgs** opPtr, struct ncclProxyArgs** prevOpPtr) {
+// Report ops whose network requests made no progress for NCCL_PROXY_STUCK_TIMEOUT seconds,
+// and fail the communicator with NCCL_PROXY_STUCK_ABORT=1.
+NCCL_PARAM(ProxyStuckTimeout, "PROXY_STUCK_TIMEOUT", 0);
+NCCL_PARAM(ProxyStuckAbort, "PROXY_STUCK_ABORT", 0);
+#define PROXY_WHEEL_TICK_NS 10000000ULL // 10ms
+// Progress loop iterations between two reads of the clock while ops are armed
+#define PROXY_WHEEL_CLOCK_WALKS 64
+
+static uint64_t proxyTimerTicks(struct ncclProxyTimerWheel* wheel, uint64_t ns) {
+  return (ns-wheel->start)/PROXY_WHEEL_TICK_NS;
+}
+
+static void proxyTimerInit(struct ncclProxyTimerWheel* wheel) {
+  memset(wheel, 0, sizeof(struct ncclProxyTimerWheel));
+  wheel->timeout = ncclParamProxyStuckTimeout() > 0 ? ncclParamProxyStuckTimeout()*1000000000ULL : 0;
+  wheel->timeoutTicks = wheel->timeout/PROXY_WHEEL_TICK_NS;
+  wheel->start = clockNano();
+}
+
+static void proxyTimerInsert(struct ncclProxyTimerWheel* wheel, struct ncclProxyArgs* op, uint64_t expire) {
+  if (expire <= wheel->tick) expire = wheel->tick+1;
+  // Beyond the top level, park in the last slot; the op is re-armed when it expires.
+  const uint64_t maxDelta = (1ULL << (NCCL_PROXY_WHEEL_LEVELS*NCCL_PROXY_WHEEL_BITS))-1;
+  if (expire-wheel->tick > maxDelta) expire = wheel->tick+maxDelta;
+  int level = 0;
+  while (level < NCCL_PROXY_WHEEL_LEVELS-1 && expire-wheel->tick >= (1ULL << ((level+1)*NCCL_PROXY_WHEEL_BITS))) level++;
+  struct ncclProxyArgs** slot = wheel->slots[level]+((expire >> (level*NCCL_PROXY_WHEEL_BITS)) & (NCCL_PROXY_WHEEL_SLOTS-1));
+  op->timerExpire = expire;
+  op->timerNext = *slot;
+  if (*slot) (*slot)->timerPrevPtr = &op->timerNext;
+  op->timerPrevPtr = slot;
+  *slot = op;
+}
+
+static void proxyTimerRemove(struct ncclProxyTimerWheel* wheel, struct ncclProxyArgs* op) {
+  if (op->timerPrevPtr == NULL) return;
+  *op->timerPrevPtr = op->timerNext;
+  if (op->timerNext) op->timerNext->timerPrevPtr = op->timerPrevPtr;
+  op->timerNext = NULL;
+  op->timerPrevPtr = NULL;
+  wheel->nArmed--;
+}
+
+// Arm the timer when the op starts waiting on the network and disarm it when it no longer
+// does. Waiting for the GPU to fill or free a buffer can legitimately last as long as the
+// kernel ahead of us, so it is never reported. O(1), called after each progress of the op.
+static void proxyTimerUpdate(struct ncclProxyTimerWheel* wheel, struct ncclProxyArgs* op) {
+  if (op->netInflight == 0) {
+    proxyTimerRemove(wheel, op);
+  } else if (op->timerPrevPtr == NULL) {
+    // The tick is only kept current while ops are armed
+    if (wheel->nArmed == 0) wheel->tick = proxyTimerTicks(wheel, clockNano());
+    op->timerEvents = op->netEvents;
+    op->lastProgress = wheel->tick;
+    proxyTimerInsert(wheel, op, wheel->tick+wheel->timeoutTicks);
+    wheel->nArmed++;
+  }
+}
+
+static ncclResult_t proxyReportStuckOp(struct ncclComm* comm, struct ncclProxyArgs* op, uint64_t tick) {
+  WARN("Proxy op stuck for %.1f s : opCount %lx pattern %d protocol %d nsubs %d state %d, %d steps in flight on the network",
+      (tick-op->lastProgress)*PROXY_WHEEL_TICK_NS/1e9, op->opCount, op->pattern, op->protocol, op->nsubs, op->state, op->netInflight);
+  for (int s=0; s<op->nsubs; s++) {
+    struct ncclProxySubArgs* sub = op->subs+s;
+    WARN("Proxy op stuck : opCount %lx sub %d channel %d peer %d nsteps %d base %ld posted %ld received %ld flushed %ld transmitted %ld done %ld",
+        op->opCount, s, sub->channelId, sub->peer, sub->nsteps, sub->base, sub->posted, sub->received, sub->flushed, sub->transmitted, sub->done);
+  }
+  if (ncclParamProxyStuckAbort()) return ncclRemoteError;
+  return ncclSuccess;
+}
+
+// Process the ticks elapsed since the last call. Each armed op is looked at once per
+// timeout, whatever the number of network requests it posted or completed since.
+static ncclResult_t proxyTimerAdvance(struct ncclComm* comm, struct ncclProxyShard* shard, uint64_t now) {
+  struct ncclProxyTimerWheel* wheel = &shard->timers;
+  ncclResult_t ret = ncclSuccess;
+  const uint64_t target = proxyTimerTicks(wheel, now);
+  while (wheel->tick < target) {
+    wheel->tick++;
+    // Cascade higher levels down when lower levels wrap around
+    for (int level=NCCL_PROXY_WHEEL_LEVELS-1; level>0; level--) {
+      if (wheel->tick & ((1ULL << (level*NCCL_PROXY_WHEEL_BITS))-1)) continue;
+      struct ncclProxyArgs** slot = wheel->slots[level]+((wheel->tick >> (level*NCCL_PROXY_WHEEL_BITS)) & (NCCL_PROXY_WHEEL_SLOTS-1));
+      struct ncclProxyArgs* op = *slot;
+      *slot = NULL;
+      while (op) {
+        struct ncclProxyArgs* next = op->timerNext;
+        op->timerPrevPtr = NULL;
+        proxyTimerInsert(wheel, op, op->timerExpire);
+        op = next;
+      }
+    }
+    struct ncclProxyArgs** slot = wheel->slots[0]+(wheel->tick & (NCCL_PROXY_WHEEL_SLOTS-1));
+    struct ncclProxyArgs* op = *slot;
+    *slot = NULL;
+    while (op) {
+      struct ncclProxyArgs* next = op->timerNext;
+      op->timerPrevPtr = NULL;
+      if (op->netEvents != op->timerEvents) {
+        // A network request was posted or completed since the timer was armed
+        op->timerEvents = op->netEvents;
+        op->lastProgress = wheel->tick;
+        op->timerExpire = wheel->tick+wheel->timeoutTicks;
+      } else {
+        ncclResult_t res = proxyReportStuckOp(comm, op, wheel->tick);
+        if (res != ncclSuccess) ret = res;
+        // Report again if still stuck after another timeout
+        op->timerExpire = wheel->tick+wheel->timeoutTicks;
+      }
+      proxyTimerInsert(wheel, op, op->timerExpire);
+      op = next;
+    }
+  }
+  return ret;
+}
+
+static ncclResult_t removeOp(struct ncclProxyShard* shard, struct ncclProxyArgs** opPtr, struct ncclProxyArgs** prevOpPtr) {
   struct ncclProxyArgs* freeOp = *opPtr;
   struct ncclProxyArgs* next = freeOp->next;
+  proxyTimerRemove(&shard->timers, freeOp);
   DEBUG_PROXY_PRINT("Remove %ld -> %ld -> %ld\n", OP_INDEX(*prevOpPtr), OP_INDEX(freeOp), OP_INDEX(next));
   *opPtr = next;
   if (freeOp->nextPeer) {
@@ -489,7 +624,7 @@ static ncclResult_t removeOp(struct ncclProxyProgressState* state, struct ncclPr
     if (*prevOpPtr) {
       (*prevOpPtr)->next = nextPeer;
     } else {
-      state->active = nextPeer;
+      shard->active = nextPeer;
     }
     nextPeer->next = next;
     *(prevOpPtr) = nextPeer;
@@ -498,41 +633,111 @@ static ncclResult_t removeOp(struct ncclProxyProgressState* state, struct ncclPr
     if (*prevOpPtr) {
       (*prevOpPtr)->next = next;
     } else {
-      state->active = next;
+      shard->active = next;
     }
   }
-  freeOp->next = state->pool;
-  state->pool = freeOp;
+  ncclProxySubsFree(shard, freeOp);
+  freeOp->next = shard->pool;
+  shard->pool = freeOp;
   DEBUG_PROXY_PRINT("Removed %5ld (%5ld) : ", OP_INDEX(freeOp), OP_INDEX(*freeOp->proxyAppendPtr));
 #ifdef DEBUG_PROXY
-  NCCLCHECK(dumpProxyState(state));
+  NCCLCHECK(dumpProxyState(shard));
 #endif
   return ncclSuccess;
 }
 
-static ncclResult_t progressOps(struct ncclComm* comm, struct ncclProxyProgressState* state, struct ncclProxyArgs* opStart, int* idle) {
+static ncclResult_t progressOps(struct ncclComm* comm, struct ncclProxyShard* shard, struct ncclProxyArgs* opStart, int* idle) {
   struct ncclProxyArgs* prevOp = NULL;
   struct ncclProxyArgs* op = opStart;
+  struct ncclProxyTimerWheel* wheel = &shard->timers;
   while (op) {
     if (op->state == ncclProxyOpNone) return ncclInternalError;
     TIME_START(0); TIME_START(1);
     NCCLCHECK(op->progress(comm, op));
     if (op->idle) { TIME_STOP(1); TIME_CANCEL(0); } else { TIME_CANCEL(1); TIME_STOP(0); }
     *idle &= op->idle;
+    if (wheel->timeout) proxyTimerUpdate(wheel, op);
     if (op->state == ncclProxyOpNone) {
       TIME_START(2);
-      NCCLCHECK(removeOp(state, &op, &prevOp));
+      NCCLCHECK(removeOp(shard, &op, &prevOp));
       TIME_STOP(2);
     } else {
       prevOp = op;
       op = op->next;
     }
   }
+  if (wheel->nArmed && ++wheel->walks % PROXY_WHEEL_CLOCK_WALKS == 0) NCCLCHECK(proxyTimerAdvance(comm, shard, clockNano()));
   return ncclSuccess;
 }
 
 NCCL_PARAM(ProxyAppendBatchSize, "PROXY_APPEND_BATCH_SIZE", 16);
 
+// Ops of shared connections are chained with the other ops of the same local rank and
+// channel (NET) or net device (CollNet), so they have to stay on the same shard.
+static int proxyShardOf(struct ncclProxyProgressState* state, struct ncclProxyOp* op) {
+  if (state->nShards == 1) return 0;
+  struct ncclProxyConnection* connection = op->connection;
+  int key = op->channelId;
+  if (connection->transport == TRANSPORT_COLLNET) key = connection->netDev;
+  else if (connection->transport == TRANSPORT_NET && state->shardByNetDev && !connection->shared) key = connection->netDev;
+  return key % state->nShards;
+}
+
+static void proxyShardWait(struct ncclProxyShard* shard, const struct timespec* timeout) {
+  syscall(SYS_futex, &shard->sleeping, FUTEX_WAIT_PRIVATE, 1, timeout, NULL, 0);
+}
+
+static void proxyShardWake(struct ncclProxyShard* shard) {
+  __atomic_store_n(&shard->sleeping, 0, __ATOMIC_SEQ_CST);
+  syscall(SYS_futex, &shard->sleeping, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static bool proxyShardPending(struct ncclProxyShard* shard) {
+  return __atomic_load_n(&shard->inboxTail, __ATOMIC_SEQ_CST) != shard->inboxHead;
+}
+
+// Called by shard 0 to hand an op to another shard
+static ncclResult_t proxyShardPush(struct ncclComm* comm, struct ncclProxyShard* shard, struct ncclProxyOp* op) {
+  uint64_t tail = shard->inboxTail;
+  while (tail - __atomic_load_n(&shard->inboxHead, __ATOMIC_ACQUIRE) == (uint64_t)shard->inboxSize) {
+    // Inbox is full, wait for the shard to catch up.
+    if (*comm->abortFlag) return ncclSuccess;
+    sched_yield();
+  }
+  memcpy(shard->inbox+(tail & (shard->inboxSize-1)), op, sizeof(struct ncclProxyOp));
+  __atomic_store_n(&shard->inboxTail, tail+1, __ATOMIC_SEQ_CST);
+  // The shard sets sleeping before checking its inbox one last time, so one of us sees the other.
+  if (__atomic_load_n(&shard->sleeping, __ATOMIC_SEQ_CST)) proxyShardWake(shard);
+  return ncclSuccess;
+}
+
+// Called by shards other than 0 to append the ops routed to them
+static ncclResult_t proxyShardGetOps(struct ncclProxyProgressState* state, struct ncclProxyShard* shard, int* added) {
+  if (shard->active == NULL) {
+    // Nothing to progress, wait for shard 0 to route something to us.
+    while (!proxyShardPending(shard) && !__atomic_load_n(&state->stop, __ATOMIC_SEQ_CST)) {
+      __atomic_store_n(&shard->sleeping, 1, __ATOMIC_SEQ_CST);
+      if (!proxyShardPending(shard) && !__atomic_load_n(&state->stop, __ATOMIC_SEQ_CST)) {
+        struct ncclProxyArgs profArgs; // Only used for profiling purposes
+        ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileSleep);
+        proxyShardWait(shard, NULL);
+        ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileWakeup);
+      }
+      __atomic_store_n(&shard->sleeping, 0, __ATOMIC_RELAXED);
+    }
+  }
+  uint64_t head = shard->inboxHead;
+  uint64_t tail = __atomic_load_n(&shard->inboxTail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    NCCLCHECK(ProxyAppend(shard, shard->inbox+(head & (shard->inboxSize-1))));
+    (*added)++;
+  }
+  __atomic_store_n(&shard->inboxHead, head, __ATOMIC_RELEASE);
+  return ncclSuccess;
+}
+
+#define PROXY_LINK_WAIT_SPINS 64
+
 static ncclResult_t ncclProxyGetPostedOps(struct ncclComm* comm, int* added) {
   struct ncclProxyProgressState* state = &comm->proxyState.progressState;
   if (state->opsPool == NULL) return ncclInternalError;
@@ -541,28 +746,30 @@ static ncclResult_t ncclProxyGetPostedOps(struct ncclComm* comm, int* added) {
   struct ncclProxyArgs profArgs; // Only used for profiling purposes
   if (state->nextOps != -1) goto process_nextops;
 
-  // If we have ops to progress, no need to block waiting for something to arrive or even wait for the lock
-  // to be available. Exit, continue progress, and come back later.
-  if (state->active != NULL && (pool->nextOps == -1 || pthread_mutex_trylock(&pool->mutex) != 0)) return ncclSuccess;
-
-  if (state->active == NULL) {
-    pthread_mutex_lock(&pool->mutex);
-    while (pool->nextOps == -1 && !state->stop) {
-      struct ncclProxyArgs profArgs; // Only used for profiling purposes
-      ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileSleep);
-      pthread_cond_wait(&pool->cond, &pool->mutex);
-      ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileWakeup);
-    }
-    if (state->stop) { // We might have been woken up to stop.
-      pthread_mutex_unlock(&pool->mutex);
-      return ncclSuccess;
+  // If we have ops to progress, no need to block waiting for something to arrive.
+  // Exit, continue progress, and come back later.
+  if (state->shards[0].active != NULL && __atomic_load_n(&pool->nextOpsEnd, __ATOMIC_ACQUIRE) == -1) return ncclSuccess;
+
+  if (state->shards[0].active == NULL) {
+    while (__atomic_load_n(&pool->nextOpsEnd, __ATOMIC_ACQUIRE) == -1 && !state->stop) {
+      __atomic_store_n(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+      if (__atomic_load_n(&pool->nextOpsEnd, __ATOMIC_SEQ_CST) == -1 && !__atomic_load_n(&state->stop, __ATOMIC_SEQ_CST)) {
+        struct ncclProxyArgs profArgs; // Only used for profiling purposes
+        ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileSleep);
+        proxyOpsPoolWait(pool, NULL);
+        ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileWakeup);
+      }
+      __atomic_store_n(&pool->sleeping, 0, __ATOMIC_RELAXED);
     }
+    if (state->stop) return ncclSuccess; // We might have been woken up to stop.
   }
 
+  // A main thread may have swapped nextOpsEnd but not set nextOps yet; come back later.
+  if (__atomic_load_n(&pool->nextOps, __ATOMIC_ACQUIRE) == -1) return ncclSuccess;
+  // Detach the chain. Clear nextOps first: the next poster to see an empty queue will set it.
   state->nextOps = pool->nextOps;
-  pool->nextOps = pool->nextOpsEnd = -1;
-  pthread_mutex_unlock(&pool->mutex);
-  if (state->nextOps == -1) return ncclInternalError;
+  __atomic_store_n(&pool->nextOps, -1, __ATOMIC_RELAXED);
+  state->nextOpsEnd = __atomic_exchange_n(&pool->nextOpsEnd, -1, __ATOMIC_ACQ_REL);
 
 process_nextops:
   ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileAppend);
@@ -582,11 +789,27 @@ process_nextops:
     lastOpCount = peerOp->opCount;
     lastPeer = peer;
     if (peerOp->connection == NULL) return ncclInternalError;
-    if (peerOp->next != -1) __builtin_prefetch(pool->ops+peerOp->next);
-    NCCLCHECK(ProxyAppend(state, peerOp));
+    int nextOpIndex = -1;
+    if (opIndex != state->nextOpsEnd) {
+      // The poster of the next chain swapped nextOpsEnd before linking it to ours, wait for the link.
+      // It normally follows right away. If not (e.g. the poster died), resume from this op on the
+      // next call rather than spin, so that stop and abort are still seen.
+      for (int spins=0; (nextOpIndex = __atomic_load_n(&peerOp->next, __ATOMIC_ACQUIRE)) == -1; spins++) {
+        if (spins == PROXY_LINK_WAIT_SPINS || state->stop || *comm->abortFlag) break;
+        sched_yield();
+      }
+      if (nextOpIndex == -1) break;
+      __builtin_prefetch(pool->ops+nextOpIndex);
+    }
+    int shard = proxyShardOf(state, peerOp);
+    if (shard == 0) {
+      NCCLCHECK(ProxyAppend(state->shards, peerOp));
+    } else {
+      NCCLCHECK(proxyShardPush(comm, state->shards+shard, peerOp));
+    }
     (*added)++;
     int lastOpIndex = opIndex;
-    opIndex = peerOp->next;
+    opIndex = nextOpIndex;
     // Return op to peer pool
     if (freeOp[peer] == -1) {
       freeOpEnd[peer] = lastOpIndex;
@@ -625,7 +848,7 @@ process_nextops:
 #include <signal.h>
 static ncclProxyProgressState* ncclLastProxyState;
 void ncclDumpProxyState(int signal) {
-  dumpProxyState(ncclLastProxyState);
+  for (int s=0; s<ncclLastProxyState->nShards; s++) dumpProxyState(ncclLastProxyState->shards+s);
 }
 
 NCCL_PARAM(CreateThreadContext, "CREATE_THREAD_CONTEXT", 0);
@@ -664,29 +887,150 @@ ncclResult_t ncclSetThreadContext(struct ncclComm* comm) {
 // Set to SIGUSR1 or SIGUSR2 to help debug proxy state during hangs
 NCCL_PARAM(ProxyDumpSignal, "PROXY_DUMP_SIGNAL", -1);
 
-void* ncclProxyProgress(void *comm_) {
-  struct ncclComm* comm = (struct ncclComm*)comm_;
+// Backoff of the progress thread when ops are active but none of them progressed.
+// We spin for a window derived from the length of previous idle periods, then yield
+// for NCCL_PROXY_YIELD_NS, then, if NCCL_PROXY_PARK_NS is set, park on the ops pool
+// futex for that long at a time. Posting new ops wakes a parked thread right away, but
+// network and GPU progress of active ops does not: a completion can be noticed up to
+// NCCL_PROXY_PARK_NS late, hence parking is off by default. Setting
+// NCCL_PROXY_SPIN_MAX_NS to 0 as well makes the thread always yield.
+NCCL_PARAM(ProxySpinMaxNs, "PROXY_SPIN_MAX_NS", 20000);
+NCCL_PARAM(ProxyYieldNs, "PROXY_YIELD_NS", 200000);
+NCCL_PARAM(ProxyParkNs, "PROXY_PARK_NS", 0);
+
+enum { proxyPhaseBusy=0, proxyPhaseSpin=1, proxyPhaseYield=2, proxyPhasePark=3, proxyNumPhases=4 };
+static const char* proxyPhaseStr[] = { "busy", "spin", "yield", "park" };
+
+struct proxyBackoff {
+  uint64_t spinMax;
+  uint64_t yieldTime;
+  uint64_t parkTime;
+  uint64_t avgIdle;    // Moving average of the length of idle periods
+  uint64_t idleStart;
+  uint64_t spinWindow;
+  uint64_t phaseStart;
+  int phase;
+  uint64_t time[proxyNumPhases];
+  uint64_t parks;
+  struct timespec parkTimeout;
+};
+
+static void proxyBackoffInit(struct proxyBackoff* b) {
+  memset(b, 0, sizeof(struct proxyBackoff));
+  b->spinMax = ncclParamProxySpinMaxNs();
+  b->yieldTime = ncclParamProxyYieldNs();
+  b->parkTime = ncclParamProxyParkNs();
+  b->parkTimeout.tv_sec = b->parkTime/1000000000ULL;
+  b->parkTimeout.tv_nsec = b->parkTime%1000000000ULL;
+  b->avgIdle = b->spinMax/2;
+  b->phaseStart = clockNano();
+}
+
+static void proxyBackoffSetPhase(struct proxyBackoff* b, int phase, uint64_t now) {
+  b->time[b->phase] += now-b->phaseStart;
+  b->phase = phase;
+  b->phaseStart = now;
+}
+
+// Something progressed or was added
+static void proxyBackoffEvent(struct proxyBackoff* b) {
+  if (b->phase == proxyPhaseBusy) return;
+  uint64_t now = clockNano();
+  b->avgIdle += ((int64_t)(now-b->idleStart)-(int64_t)b->avgIdle)/8;
+  proxyBackoffSetPhase(b, proxyPhaseBusy, now);
+}
+
+// Nothing progressed. Returns 1 when the caller should park for b->parkTimeout.
+static int proxyBackoffIdle(struct proxyBackoff* b, bool canPark) {
+  uint64_t now = clockNano();
+  if (b->phase == proxyPhaseBusy) {
+    // Spinning only pays off if the wait is likely to end within the window. When idle
+    // periods are usually longer, spin briefly and move on to yielding.
+    b->spinWindow = b->avgIdle < b->spinMax ? std::min(2*b->avgIdle, b->spinMax) : b->spinMax/16;
+    b->idleStart = now;
+    proxyBackoffSetPhase(b, proxyPhaseSpin, now);
+  }
+  if (b->phase == proxyPhaseSpin) {
+    if (now-b->idleStart < b->spinWindow) return 0;
+    proxyBackoffSetPhase(b, proxyPhaseYield, now);
+  }
+  if (b->phase == proxyPhaseYield) {
+    if (b->parkTime == 0 || !canPark || now-b->idleStart < b->spinWindow+b->yieldTime) {
+      sched_yield();
+      return 0;
+    }
+    proxyBackoffSetPhase(b, proxyPhasePark, now);
+  }
+  b->parks++;
+  return 1;
+}
+
+// Park shard 0 on the ops pool, posting new ops wakes it up
+static void proxyOpsPoolPark(struct ncclProxyProgressState* state, const struct timespec* timeout) {
+  struct ncclProxyOpsPool* pool = state->opsPool;
+  __atomic_store_n(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&pool->nextOpsEnd, __ATOMIC_SEQ_CST) == -1 && !__atomic_load_n(&state->stop, __ATOMIC_SEQ_CST)) {
+    struct ncclProxyArgs profArgs; // Only used for profiling purposes
+    ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileSleep);
+    proxyOpsPoolWait(pool, timeout);
+    ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileWakeup);
+  }
+  __atomic_store_n(&pool->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+// Park other shards on their inbox, shard 0 routing ops to them wakes them up
+static void proxyShardPark(struct ncclProxyProgressState* state, struct ncclProxyShard* shard, const struct timespec* timeout) {
+  __atomic_store_n(&shard->sleeping, 1, __ATOMIC_SEQ_CST);
+  if (!proxyShardPending(shard) && !__atomic_load_n(&state->stop, __ATOMIC_SEQ_CST)) {
+    struct ncclProxyArgs profArgs; // Only used for profiling purposes
+    ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileSleep);
+    proxyShardWait(shard, timeout);
+    ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileWakeup);
+  }
+  __atomic_store_n(&shard->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+static void proxyBackoffReport(struct proxyBackoff* b, int cudaDev, int shard) {
+  proxyBackoffSetPhase(b, b->phase, clockNano());
+  char line[256];
+  int len = 0;
+  for (int p=0; p<proxyNumPhases; p++) {
+    len += snprintf(line+len, sizeof(line)-len, "%s%s %.3f s", p ? ", " : "", proxyPhaseStr[p], b->time[p]/1e9);
+  }
+  INFO(NCCL_INIT, "Proxy progress thread %d for device %d : %s, %ld parks, average idle period %ld ns",
+      shard, cudaDev, line, b->parks, b->avgIdle);
+}
+
+void* ncclProxyProgress(void *shard_) {
+  struct ncclProxyShard* shard = (struct ncclProxyShard*)shard_;
+  struct ncclComm* comm = shard->comm;
   if (ncclSetThreadContext(comm) != ncclSuccess) {
     WARN("[Proxy Progress] Failed to set CUDA context on device %d", comm->cudaDev);
   } else if (cudaSetDevice(comm->cudaDev) != cudaSuccess) {
     WARN("[Proxy Progress] Failed to set CUDA device %d", comm->cudaDev);
   }
-  if (CPU_COUNT(&comm->cpuAffinity)) sched_setaffinity(0, sizeof(cpu_set_t), &comm->cpuAffinity);
+  if (CPU_COUNT(&shard->cpuAffinity)) sched_setaffinity(0, sizeof(cpu_set_t), &shard->cpuAffinity);
 
   struct ncclProxyProgressState* state = &comm->proxyState.progressState;
-  state->nextOps = -1;
-  const int sig = ncclParamProxyDumpSignal();
-  if (sig != -1) signal(sig, ncclDumpProxyState);
-  ncclLastProxyState = state;
   char threadName[NCCL_THREAD_NAMELEN];
-  snprintf(threadName, NCCL_THREAD_NAMELEN, "NCCL Progress%2d", comm->cudaDev);
+  if (shard->id == 0) {
+    state->nextOps = -1;
+    const int sig = ncclParamProxyDumpSignal();
+    if (sig != -1) signal(sig, ncclDumpProxyState);
+    ncclLastProxyState = state;
+    snprintf(threadName, NCCL_THREAD_NAMELEN, "NCCL Progress%2d", comm->cudaDev);
+  } else {
+    snprintf(threadName, NCCL_THREAD_NAMELEN, "NCCL Prog%2d-%2d", comm->cudaDev, shard->id);
+  }
   nvtxNameOsThreadA(syscall(SYS_gettid), threadName);
 
   int lastIdle = 0;
   struct ncclProxyArgs profArgs; // Only used for profiling purposes
-  while ((state->stop == false || (state->stop == true && state->active)) && *comm->abortFlag == 0) {
+  struct proxyBackoff backoff;
+  proxyBackoffInit(&backoff);
+  while ((state->stop == false || shard->active || proxyShardPending(shard)) && *comm->abortFlag == 0) {
     int idle = 1;
-    ncclResult_t ret = progressOps(comm, state, state->active, &idle);
+    ncclResult_t ret = progressOps(comm, shard, shard->active, &idle);
     if (ret != ncclSuccess) {
       (void) ncclCommSetAsyncError(comm, ret);
       INFO(NCCL_ALL,"%s:%d -> %d [Proxy Thread]", __FILE__, __LINE__, ret);
@@ -696,18 +1040,28 @@ void* ncclProxyProgress(void *comm_) {
     if (lastIdle == 1 && idle == 0) ncclProfilingRecord(&profArgs, 0, 0, ncclProxyProfileActive);
     int added = 0;
     TIME_START(3);
-    if (state->stop == false)
+    if (shard->id != 0)
+      ret = proxyShardGetOps(state, shard, &added);
+    else if (state->stop == false)
       ret = ncclProxyGetPostedOps(comm, &added);
     if (added) { TIME_STOP(3); } else { TIME_CANCEL(3); }
     if (ret != ncclSuccess) {
       (void) ncclCommSetAsyncError(comm, ret);
       INFO(NCCL_ALL,"%s:%d -> %d [Proxy Thread]", __FILE__, __LINE__, ret);
     }
-    if (added == 0) {
-      sched_yield(); // No request progressed. Let others run.
+    if (added == 0 && idle == 1) {
+      // No request progressed. Let others run.
+      if (shard->id != 0) {
+        if (proxyBackoffIdle(&backoff, true)) proxyShardPark(state, shard, &backoff.parkTimeout);
+      } else {
+        if (proxyBackoffIdle(&backoff, state->opsPool != NULL)) proxyOpsPoolPark(state, &backoff.parkTimeout);
+      }
+    } else {
+      proxyBackoffEvent(&backoff);
     }
     lastIdle = idle;
   }
+  proxyBackoffReport(&backoff, comm->cudaDev, shard->id);
   return NULL;
 }
 
@@ -727,11 +1081,58 @@ ncclResult_t ncclProxyStart(struct ncclComm* comm) {
   return ncclSuccess;
 }
 
+// Number of progress threads per communicator, and whether ops are sharded across them
+// by channel (0) or by net device (1).
+NCCL_PARAM(ProxyThreads, "PROXY_THREADS", 1);
+NCCL_PARAM(ProxyShardByNetDev, "PROXY_SHARD_BY_NETDEV", 0);
+
+// With several progress threads, pin each one to its own CPU of the GPU affinity. Offset by
+// the local rank so that ranks sharing a CPU set spread over it.
+static void proxyShardAffinity(struct ncclComm* comm, int nShards, int s, cpu_set_t* mask) {
+  int nCpus = CPU_COUNT(&comm->cpuAffinity);
+  if (nShards == 1 || nCpus == 0) {
+    memcpy(mask, &comm->cpuAffinity, sizeof(cpu_set_t));
+    return;
+  }
+  CPU_ZERO(mask);
+  int target = (comm->localRank*nShards+s) % nCpus;
+  for (int c=0, i=0; c<CPU_SETSIZE; c++) {
+    if (CPU_ISSET(c, &comm->cpuAffinity) && i++ == target) {
+      CPU_SET(c, mask);
+      break;
+    }
+  }
+}
+
 ncclResult_t ncclProxyProgressCreate(struct ncclComm* comm) {
   struct ncclProxyProgressState* state = &comm->proxyState.progressState;
-  if (!state->thread) {
-    pthread_create(&state->thread, NULL, ncclProxyProgress, comm);
-    ncclSetThreadName(state->thread, "NCCL Progress%2d", comm->cudaDev);
+  if (state->shards == NULL) {
+    ncclProfilingInit();
+    int nShards = std::min(std::max((int)ncclParamProxyThreads(), 1), NCCL_PROXY_MAX_THREADS);
+    NCCLCHECK(ncclCalloc(&state->shards, nShards));
+    for (int s=0; s<nShards; s++) {
+      struct ncclProxyShard* shard = state->shards+s;
+      shard->id = s;
+      shard->comm = comm;
+      proxyTimerInit(&shard->timers);
+      proxyShardAffinity(comm, nShards, s, &shard->cpuAffinity);
+      if (s == 0) continue;
+      // A power of two, so that head and tail can wrap around
+      shard->inboxSize = MAX_OPS_PER_PEER;
+      NCCLCHECK(ncclCalloc(&shard->inbox, shard->inboxSize));
+    }
+    state->nShards = nShards;
+    state->shardByNetDev = ncclParamProxyShardByNetDev();
+    if (nShards > 1) INFO(NCCL_INIT, "Proxy: %d progress threads, ops sharded by %s", nShards, state->shardByNetDev ? "net device" : "channel");
+    for (int s=0; s<nShards; s++) {
+      struct ncclProxyShard* shard = state->shards+s;
+      pthread_create(&shard->thread, NULL, ncclProxyProgress, shard);
+      if (s == 0) {
+        ncclSetThreadName(shard->thread, "NCCL Progress%2d", comm->cudaDev);
+      } else {
+        ncclSetThreadName(shard->thread, "NCCL Prog%2d-%2d", comm->cudaDev, s);
+      }
+    }
   }
   return ncclSuccess;
 }
@@ -740,20 +1141,26 @@ ncclResult_t ncclProxyProgressDestroy(struct ncclComm* comm) {
   struct ncclProxyProgressState* state = &comm->proxyState.progressState;
 
   // Request the proxy to stop and then wake it
-  if (state->opsPool) {
-    pthread_mutex_lock(&state->opsPool->mutex);
-    state->stop = true;
-    pthread_cond_signal(&state->opsPool->cond);
-    pthread_mutex_unlock(&state->opsPool->mutex);
-    pthread_join(state->thread, NULL);
+  if (state->opsPool && state->shards) {
+    __atomic_store_n(&state->stop, true, __ATOMIC_SEQ_CST);
+    proxyOpsPoolWake(state->opsPool);
+    for (int s=1; s<state->nShards; s++) proxyShardWake(state->shards+s);
+    for (int s=0; s<state->nShards; s++) pthread_join(state->shards[s].thread, NULL);
   }
 
   // Free off any memory allocated for the proxy arg pools
-  while (state->pools != NULL) {
-    struct ncclProxyPool *next = state->pools->next;
-    free(state->pools);
-    state->pools = next;
+  for (int s=0; s<state->nShards; s++) {
+    struct ncclProxyShard* shard = state->shards+s;
+    while (shard->pools != NULL) {
+      struct ncclProxyPool *next = shard->pools->next;
+      free(shard->pools);
+      shard->pools = next;
+    }
+    ncclProxySubsDestroy(shard);
+    free(shard->inbox);
   }
+  free(state->shards);
+  state->shards = NULL;
 
   ncclProfilingDump();
   TIME_PRINT("Proxy");
@@ -765,12 +1172,21 @@ struct ncclProxyAsyncOp {
   struct ncclProxyConnection* connection;
   int reqSize, respSize;
   char *reqBuff, *respBuff;
+  int done;
 };
 
+// Setup and Connect requests a local peer can have in flight
+#define NCCL_PROXY_MAX_ASYNC_OPS 32
+
 struct ncclProxyLocalPeer {
   struct ncclSocket sock;
   int localRank;
-  struct ncclProxyAsyncOp asyncOps;
+  // Requests are progressed concurrently but answered in the order they were received
+  struct ncclProxyAsyncOp asyncOps[NCCL_PROXY_MAX_ASYNC_OPS];
+  int asyncOpsHead;
+  int nAsyncOps;
+  // Other request received while async ops were in flight, executed once they complete
+  int pendingType;
 };
 
 #define NCCL_PROXY_CONN_POOL_SIZE_POW2 7
@@ -833,16 +1249,108 @@ static ncclResult_t ncclProxyFreeConnections(struct ncclProxyConnectionPool* poo
 
 #include "transport.h"
 
+const char* ncclProxyMsgTypeStr[] = { "Unknown", "Init", "SharedInit", "Setup", "Connect", "Start", "Close", "Abort", "Stop" };
+
+// Grow and unwrap a ring of queued calls
+template <typename T>
+static ncclResult_t proxyCallsGrow(T** elems, int* size, int* head, int count) {
+  T* newElems;
+  int newSize = *size ? 2*(*size) : 16;
+  NCCLCHECK(ncclCalloc(&newElems, newSize));
+  for (int i=0; i<count; i++) newElems[i] = (*elems)[(*head+i)%(*size)];
+  free(*elems);
+  *elems = newElems;
+  *size = newSize;
+  *head = 0;
+  return ncclSuccess;
+}
+
+static ncclResult_t proxyCallSend(struct ncclSocket* sock, void* connection, int type, void* reqBuff, int reqSize, int respSize) {
+  NCCLCHECK(ncclSocketSend(sock, &type, sizeof(int)));
+  NCCLCHECK(ncclSocketSend(sock, &connection, sizeof(void*)));
+  NCCLCHECK(ncclSocketSend(sock, &reqSize, sizeof(int)));
+  NCCLCHECK(ncclSocketSend(sock, &respSize, sizeof(int)));
+  if (reqSize) NCCLCHECK(ncclSocketSend(sock, reqBuff, reqSize));
+  return ncclSuccess;
+}
+
+static ncclResult_t proxyCallPush(struct ncclProxyPendingCalls* pending, struct ncclProxyConnector* proxyConn, int type, void* respBuff, int respSize, int opsPool) {
+  if (pending->count == pending->size) NCCLCHECK(proxyCallsGrow(&pending->calls, &pending->size, &pending->head, pending->count));
+  struct ncclProxyPendingCall* call = pending->calls+(pending->head+pending->count)%pending->size;
+  call->type = type;
+  call->proxyConn = proxyConn;
+  call->respBuff = respBuff;
+  call->respSize = respSize;
+  call->opsPool = opsPool;
+  pending->count++;
+  return ncclSuccess;
+}
+
+// Send the deferred calls whose connection is now known, in order, as long as the
+// proxy can take them.
+static ncclResult_t proxyCallFlush(struct ncclComm* comm, int localRank) {
+  struct ncclSocket* sock = comm->proxyState.peerSocks + localRank;
+  struct ncclProxyPendingCalls* pending = comm->proxyState.pendingCalls + localRank;
+  while (pending->deferredCount) {
+    struct ncclProxyDeferredCall* call = pending->deferred+pending->deferredHead;
+    if (call->proxyConn->connection == NULL) break;
+    if (call->respSize && pending->count >= NCCL_PROXY_MAX_ASYNC_OPS) break;
+    ncclResult_t ret = proxyCallSend(sock, call->proxyConn->connection, call->type, call->reqBuff, call->reqSize, call->respSize);
+    if (ret != ncclSuccess) {
+      WARN("Proxy Call to rank %d failed (%s)", comm->localRankToRank[localRank], ncclProxyMsgTypeStr[call->type]);
+      return ret;
+    }
+    if (call->respSize) NCCLCHECK(proxyCallPush(pending, call->proxyConn, call->type, call->respBuff, call->respSize, 0));
+    free(call->reqBuff);
+    call->reqBuff = NULL;
+    pending->deferredHead = (pending->deferredHead+1)%pending->deferredSize;
+    pending->deferredCount--;
+  }
+  return ncclSuccess;
+}
+
+// Receive the oldest pending response from a proxy
+static ncclResult_t proxyCallRecv(struct ncclComm* comm, int localRank) {
+  struct ncclSocket* sock = comm->proxyState.peerSocks + localRank;
+  struct ncclProxyPendingCalls* pending = comm->proxyState.pendingCalls + localRank;
+  struct ncclProxyPendingCall* call = pending->calls+pending->head;
+  ncclResult_t ret = ncclSocketRecv(sock, call->respBuff, call->respSize);
+  if (ret == ncclSuccess && call->opsPool) {
+    // Init of a connection which needs proxy progress, map progress ops
+    char poolPath[] = "/dev/shm/nccl-XXXXXX";
+    ret = ncclSocketRecv(sock, poolPath+sizeof("/dev/shm/nccl-")-1, sizeof("XXXXXX")-1);
+    struct ncclProxyOps* proxyOps = comm->proxyState.proxyOps+localRank;
+    if (ret == ncclSuccess && proxyOps->pool == NULL) {
+      NCCLCHECK(ncclShmOpen(poolPath, sizeof(struct ncclProxyOpsPool), (void**)(&proxyOps->pool), NULL, -1, &proxyOps->handle));
+      proxyOps->nextOps = proxyOps->nextOpsEnd = proxyOps->freeOp = -1;
+    }
+  }
+  if (ret != ncclSuccess) {
+    WARN("Proxy Call to rank %d failed (%s)", comm->localRankToRank[localRank], ncclProxyMsgTypeStr[call->type]);
+    return ret;
+  }
+  if (call->type == ncclProxyMsgInit) {
+    INFO(NCCL_NET, "Connection to proxy localRank %d -> connection %p", localRank, call->proxyConn->connection);
+  }
+  pending->head = (pending->head+1)%pending->size;
+  pending->count--;
+  NCCLCHECK(proxyCallFlush(comm, localRank));
+  return ncclSuccess;
+}
+
 ncclResult_t ncclProxyConnect(struct ncclComm* comm, int transport, int send, int rank, struct ncclProxyConnector* proxyConn) {
   struct ncclSocket* sock;
+  struct ncclProxyPendingCalls* pending;
   int ready;
-  int type = ncclProxyMsgInit;
+  int req[3] = { transport, send, comm->localRank };
 
   // Keep one connection per mlocal rank
   proxyConn->connection = NULL;
   proxyConn->rank = rank;
+  proxyConn->comm = comm;
   if (comm->proxyState.peerSocks == NULL) {
     NCCLCHECK(ncclCalloc(&comm->proxyState.peerSocks, comm->localRanks));
+    NCCLCHECK(ncclCalloc(&comm->proxyState.pendingCalls, comm->localRanks));
     NCCLCHECK(ncclCalloc(&comm->proxyState.proxyOps, comm->localRanks));
     NCCLCHECK(ncclCalloc(&comm->proxyState.sharedDevMems, comm->localRanks));
     for (int i = 0; i < comm->localRanks; ++i) {
@@ -852,52 +1360,93 @@ ncclResult_t ncclProxyConnect(struct ncclComm* comm, int transport, int send, in
 
   NCCLCHECK(ncclTopoGetLocalRank(comm->topo, rank, &proxyConn->localRank));
   sock = comm->proxyState.peerSocks + proxyConn->localRank;
+  pending = comm->proxyState.pendingCalls + proxyConn->localRank;
   NCCLCHECK(ncclSocketReady(sock, &ready));
   if (!ready) {
     NCCLCHECK(ncclSocketInit(sock, comm->proxyState.peerAddresses+rank, comm->magic, ncclSocketTypeProxy, comm->abortFlag));
     NCCLCHECK(ncclSocketConnect(sock));
   }
+  // The connection is returned like any other response, followed by the name of the ops
+  // pool if the transport needs proxy progress. Calls made on this connector before the
+  // response arrives are deferred until then.
+  while (pending->count >= NCCL_PROXY_MAX_ASYNC_OPS) NCCLCHECK(proxyCallRecv(comm, proxyConn->localRank));
+  int type = ncclProxyMsgInit;
   NCCLCHECK(ncclSocketSend(sock, &type, sizeof(int)));
-  NCCLCHECK(ncclSocketSend(sock, &transport, sizeof(int)));
-  NCCLCHECK(ncclSocketSend(sock, &send, sizeof(int)));
-  NCCLCHECK(ncclSocketSend(sock, &comm->localRank, sizeof(int)));
-  NCCLCHECK(ncclSocketRecv(sock, &proxyConn->connection, sizeof(void*)));
+  NCCLCHECK(ncclSocketSend(sock, req, sizeof(req)));
   struct ncclTransportComm* tcomm = send ? &ncclTransports[transport]->send : &ncclTransports[transport]->recv;
-  // If we need proxy progress, map progress ops
-  if (tcomm->proxyProgress) {
-    char poolPath[] = "/dev/shm/nccl-XXXXXX";
-    NCCLCHECK(ncclSocketRecv(sock, poolPath+sizeof("/dev/shm/nccl-")-1, sizeof("XXXXXX")-1));
-    struct ncclProxyOps* proxyOps = comm->proxyState.proxyOps+proxyConn->localRank;
-    if (proxyOps->pool == NULL) {
-      NCCLCHECK(ncclShmOpen(poolPath, sizeof(struct ncclProxyOpsPool), (void**)(&proxyOps->pool), NULL, -1, &proxyOps->handle));
-      proxyOps->nextOps = proxyOps->nextOpsEnd = proxyOps->freeOp = -1;
-    }
-  }
-  INFO(NCCL_NET, "Connection to proxy localRank %d -> connection %p", proxyConn->localRank, proxyConn->connection);
-  proxyConn->comm = comm;
+  NCCLCHECK(proxyCallPush(pending, proxyConn, type, &proxyConn->connection, sizeof(void*), tcomm->proxyProgress ? 1 : 0));
   return ncclSuccess;
 }
 
-const char* ncclProxyMsgTypeStr[] = { "Unknown", "Init", "SharedInit", "Setup", "Connect", "Start", "Close", "Abort", "Stop" };
-ncclResult_t ncclProxyCall(struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize) {
+ncclResult_t ncclProxyCallAsync(struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize) {
+  struct ncclComm* comm = proxyConn->comm;
   struct ncclSocket* sock;
+  struct ncclProxyPendingCalls* pending;
   ncclResult_t ret = ncclSuccess;
 
-  if (proxyConn->comm->proxyState.peerSocks == NULL) return ncclInternalError;
-  sock = proxyConn->comm->proxyState.peerSocks + proxyConn->localRank;
-  if (sock == NULL) return ncclInternalError;
-  NCCLCHECKGOTO(ncclSocketSend(sock, &type, sizeof(int)), ret, error);
-  NCCLCHECKGOTO(ncclSocketSend(sock, &proxyConn->connection, sizeof(void*)), ret, error);
-  NCCLCHECKGOTO(ncclSocketSend(sock, &reqSize, sizeof(int)), ret, error);
-  NCCLCHECKGOTO(ncclSocketSend(sock, &respSize, sizeof(int)), ret, error);
-  if (reqSize) NCCLCHECKGOTO(ncclSocketSend(sock, reqBuff, reqSize), ret, error);
-  if (respSize) NCCLCHECKGOTO(ncclSocketRecv(sock, respBuff, respSize), ret, error);
+  if (comm->proxyState.peerSocks == NULL) return ncclInternalError;
+  sock = comm->proxyState.peerSocks + proxyConn->localRank;
+  pending = comm->proxyState.pendingCalls + proxyConn->localRank;
+  // Keep at most NCCL_PROXY_MAX_ASYNC_OPS responses outstanding, the proxy stops reading
+  // requests past that and both sides could block sending.
+  while (respSize && pending->count >= NCCL_PROXY_MAX_ASYNC_OPS && pending->deferredCount == 0 && proxyConn->connection) {
+    NCCLCHECK(proxyCallRecv(comm, proxyConn->localRank));
+  }
+  if (pending->deferredCount || proxyConn->connection == NULL) {
+    // Connection not known yet, or calls queued before us: keep a copy of the request
+    if (pending->deferredCount == pending->deferredSize) {
+      NCCLCHECK(proxyCallsGrow(&pending->deferred, &pending->deferredSize, &pending->deferredHead, pending->deferredCount));
+    }
+    struct ncclProxyDeferredCall* call = pending->deferred+(pending->deferredHead+pending->deferredCount)%pending->deferredSize;
+    call->proxyConn = proxyConn;
+    call->type = type;
+    call->reqBuff = NULL;
+    if (reqSize) {
+      NCCLCHECK(ncclCalloc(&call->reqBuff, reqSize));
+      memcpy(call->reqBuff, reqBuff, reqSize);
+    }
+    call->reqSize = reqSize;
+    call->respBuff = respBuff;
+    call->respSize = respSize;
+    pending->deferredCount++;
+    return ncclSuccess;
+  }
+  NCCLCHECKGOTO(proxyCallSend(sock, proxyConn->connection, type, reqBuff, reqSize, respSize), ret, error);
+  if (respSize) NCCLCHECK(proxyCallPush(pending, proxyConn, type, respBuff, respSize, 0));
   return ncclSuccess;
 error:
-  WARN("Proxy Call to rank %d failed (%s)", proxyConn->comm->localRankToRank[proxyConn->localRank], ncclProxyMsgTypeStr[type]);
+  WARN("Proxy Call to rank %d failed (%s)", comm->localRankToRank[proxyConn->localRank], ncclProxyMsgTypeStr[type]);
   return ret;
 }
 
+static ncclResult_t proxyCallWait(struct ncclComm* comm, int localRank) {
+  struct ncclProxyPendingCalls* pending = comm->proxyState.pendingCalls + localRank;
+  while (pending->count || pending->deferredCount) {
+    // Deferred calls wait for an Init response, there must be one pending
+    if (pending->count == 0) return ncclInternalError;
+    NCCLCHECK(proxyCallRecv(comm, localRank));
+  }
+  return ncclSuccess;
+}
+
+ncclResult_t ncclProxyCallWait(struct ncclProxyConnector* proxyConn) {
+  if (proxyConn->comm->proxyState.pendingCalls == NULL) return ncclInternalError;
+  NCCLCHECK(proxyCallWait(proxyConn->comm, proxyConn->localRank));
+  return ncclSuccess;
+}
+
+ncclResult_t ncclProxyCallWaitAll(struct ncclComm* comm) {
+  if (comm->proxyState.pendingCalls == NULL) return ncclSuccess;
+  for (int r=0; r<comm->localRanks; r++) NCCLCHECK(proxyCallWait(comm, r));
+  return ncclSuccess;
+}
+
+ncclResult_t ncclProxyCall(struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize) {
+  NCCLCHECK(ncclProxyCallAsync(proxyConn, type, reqBuff, reqSize, respBuff, respSize));
+  NCCLCHECK(ncclProxyCallWait(proxyConn));
+  return ncclSuccess;
+}
+
 static ncclResult_t proxyProgressInit(struct ncclComm* comm) {
   struct ncclProxyProgressState* state = &comm->proxyState.progressState;
   if (state->opsPool == NULL) {
@@ -911,7 +1460,7 @@ static ncclResult_t proxyProgressInit(struct ncclComm* comm) {
     shmPath[0] = '\0';
     NCCLCHECK(ncclShmOpen(shmPath, size, (void**)&pool, NULL, comm->localRanks + 1, &state->handle));
     // Init pool
-    pool->nextOps = -1;
+    pool->nextOps = pool->nextOpsEnd = -1;
 
     for (int r=0; r<comm->localRanks; r++) {
       pool->freeOps[r] = r*MAX_OPS_PER_PEER;
@@ -919,14 +1468,6 @@ static ncclResult_t proxyProgressInit(struct ncclComm* comm) {
       pool->ops[(r+1)*MAX_OPS_PER_PEER-1].next = -1;
     }
 
-    // Setup mutex/cond to work inter-process
-    pthread_mutexattr_t mutexAttr;
-    pthread_mutexattr_init(&mutexAttr);
-    pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
-    pthread_mutex_init(&pool->mutex, &mutexAttr);
-    pthread_condattr_t condAttr;
-    pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
-    pthread_cond_init(&pool->cond, &condAttr);
     state->opsPool = pool;
 
     memcpy(state->opsPoolShmSuffix, shmPath+sizeof("/dev/shm/nccl-")-1, sizeof("XXXXXX")-1);
@@ -1005,20 +1546,7 @@ static ncclResult_t proxyProgressAsync(struct ncclProxyAsyncOp* op, struct ncclC
       __atomic_store_n(&op->connection->state, connSetupDone, __ATOMIC_RELEASE);
     else if (op->type == ncclProxyMsgConnect)
       __atomic_store_n(&op->connection->state, connConnected, __ATOMIC_RELEASE);
-    /* if setup or connect is done, we should not return any error at this point since
-     * ncclSocketSend might already send the respBuff to the requester. If we still choose
-     * to abort and close the connection, it can cause segfault if the requester is using
-     * the respBuff. */
-    if (op->respSize) ncclSocketSend(op->connection->sock, op->respBuff, op->respSize);
-    if (op->reqBuff) {
-      free(op->reqBuff);
-      op->reqBuff = NULL;
-    }
-    if (op->respBuff) {
-      free(op->respBuff);
-      op->respBuff = NULL;
-    }
-    op->type = 0;
+    op->done = 1;
     (*asyncOpCount)--;
   } else if (*comm->abortFlag != 0) {
     return ncclInternalError;
@@ -1027,10 +1555,88 @@ static ncclResult_t proxyProgressAsync(struct ncclProxyAsyncOp* op, struct ncclC
   return ncclSuccess;
 }
 
+static void proxyAsyncOpFree(struct ncclProxyAsyncOp* op) {
+  if (op->reqBuff) {
+    free(op->reqBuff);
+    op->reqBuff = NULL;
+  }
+  if (op->respBuff) {
+    free(op->respBuff);
+    op->respBuff = NULL;
+  }
+  op->type = 0;
+  op->done = 0;
+}
+
+static struct ncclProxyAsyncOp* proxyPeerAsyncOp(struct ncclProxyLocalPeer* peer, int i) {
+  return peer->asyncOps+(peer->asyncOpsHead+i)%NCCL_PROXY_MAX_ASYNC_OPS;
+}
+
+static ncclResult_t proxySendv(struct ncclSocket* sock, struct iovec* iov, int niov, volatile uint32_t* abortFlag) {
+  int fd;
+  NCCLCHECK(ncclSocketGetFd(sock, &fd));
+  while (niov) {
+    ssize_t n = writev(fd, iov, niov);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        if (*abortFlag) return ncclInternalError;
+        continue;
+      }
+      WARN("[Proxy Service] writev failed : %s", strerror(errno));
+      return ncclRemoteError;
+    }
+    while (niov && n >= (ssize_t)iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      niov--;
+    }
+    if (niov) {
+      iov->iov_base = (char*)iov->iov_base+n;
+      iov->iov_len -= n;
+    }
+  }
+  return ncclSuccess;
+}
+
+// Progress the requests of a peer, then send the responses of the completed requests at
+// the head of its queue in a single writev.
+static ncclResult_t proxyProgressPeer(struct ncclProxyLocalPeer* peer, struct ncclComm* comm, int* asyncOpCount) {
+  for (int i=0; i<peer->nAsyncOps; i++) {
+    struct ncclProxyAsyncOp* op = proxyPeerAsyncOp(peer, i);
+    if (op->done) continue;
+    // Requests for the same connection are executed in order
+    int j = 0;
+    while (j < i && (proxyPeerAsyncOp(peer, j)->done || proxyPeerAsyncOp(peer, j)->connection != op->connection)) j++;
+    if (j < i) continue;
+    NCCLCHECK(proxyProgressAsync(op, comm, asyncOpCount));
+  }
+  struct iovec iov[NCCL_PROXY_MAX_ASYNC_OPS];
+  int niov = 0;
+  int nDone = 0;
+  while (nDone < peer->nAsyncOps && proxyPeerAsyncOp(peer, nDone)->done) {
+    struct ncclProxyAsyncOp* op = proxyPeerAsyncOp(peer, nDone++);
+    if (op->respSize == 0) continue;
+    iov[niov].iov_base = op->respBuff;
+    iov[niov].iov_len = op->respSize;
+    niov++;
+  }
+  /* Once setup or connect is done, we should not return any error apart from a failed send
+   * since the requester may already be using the response. */
+  if (niov) NCCLCHECK(proxySendv(&peer->sock, iov, niov, comm->abortFlag));
+  for (int i=0; i<nDone; i++) proxyAsyncOpFree(proxyPeerAsyncOp(peer, i));
+  peer->asyncOpsHead = (peer->asyncOpsHead+nDone)%NCCL_PROXY_MAX_ASYNC_OPS;
+  peer->nAsyncOps -= nDone;
+  return ncclSuccess;
+}
+
 static ncclResult_t proxyConnSetupConnect(int type, struct ncclProxyLocalPeer* peer, struct ncclProxyConnectionPool* connectionPool, struct ncclComm* comm, int* asyncOpCount) {
   struct ncclSocket* sock = &peer->sock;
-  struct ncclProxyAsyncOp* asyncOp = &peer->asyncOps;
+  if (peer->nAsyncOps == NCCL_PROXY_MAX_ASYNC_OPS) return ncclInternalError;
+  struct ncclProxyAsyncOp* asyncOp = proxyPeerAsyncOp(peer, peer->nAsyncOps);
   asyncOp->type = type;
+  asyncOp->done = 0;
+  peer->nAsyncOps++;
+  (*asyncOpCount)++;
   NCCLCHECK(ncclSocketRecv(sock, &asyncOp->connection, sizeof(void*)));
 
   NCCLCHECK(ncclSocketRecv(sock, &asyncOp->reqSize, sizeof(int)));
@@ -1040,12 +1646,26 @@ static ncclResult_t proxyConnSetupConnect(int type, struct ncclProxyLocalPeer* p
     NCCLCHECK(ncclSocketRecv(sock, asyncOp->reqBuff, asyncOp->reqSize));
   }
   if (asyncOp->respSize) NCCLCHECK(ncclCalloc(&asyncOp->respBuff, asyncOp->respSize));
-  (*asyncOpCount)++;
-  NCCLCHECK(proxyProgressAsync(asyncOp, comm, asyncOpCount));
   return ncclSuccess;
 }
 
-#include <poll.h>
+// Requests other than Setup and Connect are executed right away
+static ncclResult_t proxyServiceRequest(int type, struct ncclProxyLocalPeer* peer, struct ncclProxyConnectionPool* connectionPool, struct ncclComm* comm, int* stop, int* closeConn) {
+  if (type == ncclProxyMsgStop) {
+    *stop = 1;
+    *closeConn = 1;
+  } else if (type == ncclProxyMsgClose) {
+    *closeConn = 1;
+  } else if (type == ncclProxyMsgInit) {
+    NCCLCHECK(proxyConnInit(peer, connectionPool, comm));
+  } else if (type == ncclProxyMsgSharedInit) {
+    NCCLCHECK(proxyConnSharedInit(peer, connectionPool, comm));
+  } else {
+    WARN("[Service thread] Unknown command %d from localRank %d\n", type, peer->localRank);
+    *closeConn = 1;
+  }
+  return ncclSuccess;
+}
 
 void* ncclProxyService(void* _args) {
   struct ncclComm* comm =  (struct ncclComm *) _args;
@@ -1057,24 +1677,35 @@ void* ncclProxyService(void* _args) {
   }
   if (CPU_COUNT(&comm->cpuAffinity)) sched_setaffinity(0, sizeof(cpu_set_t), &comm->cpuAffinity);
 
-  // Prepare poll descriptor
+  // Prepare epoll descriptor
   struct ncclProxyConnectionPool connectionPool;
   connectionPool.pools = NULL;
   connectionPool.banks = 0;
   connectionPool.offset = NCCL_PROXY_CONN_POOL_SIZE;
 
-  struct pollfd pollfds[NCCL_MAX_LOCAL_RANKS+1];
+  int fds[NCCL_MAX_LOCAL_RANKS];
+  uint32_t revents[NCCL_MAX_LOCAL_RANKS+1];
   struct ncclProxyLocalPeer peers[NCCL_MAX_LOCAL_RANKS];
   memset(&peers, 0, sizeof(struct ncclProxyLocalPeer)*NCCL_MAX_LOCAL_RANKS);
-  for (int s=0; s<NCCL_MAX_LOCAL_RANKS; s++) {
-    pollfds[s].fd = -1;
-    pollfds[s].events = POLLHUP|POLLIN;
-  }
-  if (ncclSocketGetFd(comm->proxyState.listenSock, &pollfds[NCCL_MAX_LOCAL_RANKS].fd) != ncclSuccess) {
+  for (int s=0; s<NCCL_MAX_LOCAL_RANKS; s++) fds[s] = -1;
+  int listenFd;
+  if (ncclSocketGetFd(comm->proxyState.listenSock, &listenFd) != ncclSuccess) {
     WARN("[Proxy Service] Get listenSock fd fails\n");
     return NULL;
   };
-  pollfds[NCCL_MAX_LOCAL_RANKS].events = POLLIN;
+  int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+    WARN("[Proxy Service] epoll_create failed : %s", strerror(errno));
+    return NULL;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u32 = NCCL_MAX_LOCAL_RANKS;
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) != 0) {
+    WARN("[Proxy Service] epoll_ctl failed : %s", strerror(errno));
+    close(epollFd);
+    return NULL;
+  }
 
   int maxnpeers = 0;
   int npeers = 0;
@@ -1085,18 +1716,23 @@ void* ncclProxyService(void* _args) {
      * connections. Need to wait until all other related comms call abort and safely exit
      * together, or we could face segmentation fault. */
     if (*comm->abortFlag != 0) stop = 1;
-    /* never let proxy service thread blocks in poll, or it cannot receive abortFlag. */
-    int ret;
+    // Snapshots requested through a signal are written from here, since the progress thread may be asleep
+    ncclProfilingCheckSnapshot();
+    /* never let proxy service thread blocks in epoll, or it cannot receive abortFlag. */
+    struct epoll_event events[NCCL_MAX_LOCAL_RANKS+1];
+    int nEvents;
     do {
-      ret = poll(pollfds, NCCL_MAX_LOCAL_RANKS+1, asyncOpCount ? 0 : 500);
-    } while (ret < 0 && errno == EINTR);
-    if (ret < 0) {
-      WARN("[Proxy Service] Poll failed: %s", strerror(errno));
+      nEvents = epoll_wait(epollFd, events, NCCL_MAX_LOCAL_RANKS+1, asyncOpCount ? 0 : 500);
+    } while (nEvents < 0 && errno == EINTR);
+    if (nEvents < 0) {
+      WARN("[Proxy Service] epoll_wait failed: %s", strerror(errno));
       return NULL;
     }
-    if (pollfds[NCCL_MAX_LOCAL_RANKS].revents) {
+    memset(revents, 0, sizeof(revents));
+    for (int e=0; e<nEvents; e++) revents[events[e].data.u32] = events[e].events;
+    if (revents[NCCL_MAX_LOCAL_RANKS]) {
       int s = 0;
-      while (s < NCCL_MAX_LOCAL_RANKS && pollfds[s].fd >= 0) s++;
+      while (s < NCCL_MAX_LOCAL_RANKS && fds[s] >= 0) s++;
       if (s == NCCL_MAX_LOCAL_RANKS) {
         WARN("[Proxy service] Too many connections (%d max)", NCCL_MAX_LOCAL_RANKS);
         return NULL;
@@ -1109,10 +1745,16 @@ void* ncclProxyService(void* _args) {
       if (ncclSocketAccept(&peers[s].sock, comm->proxyState.listenSock) != ncclSuccess) {
         WARN("[Service thread] Accept failed %s", strerror(errno));
       } else {
-        if (ncclSocketGetFd(&peers[s].sock, &pollfds[s].fd) != ncclSuccess) {
+        if (ncclSocketGetFd(&peers[s].sock, fds+s) != ncclSuccess) {
           WARN("[Service thread] Get peers[%d].sock fd fails\n", s);
           return NULL;
         }
+        ev.events = EPOLLIN|EPOLLRDHUP;
+        ev.data.u32 = s;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fds[s], &ev) != 0) {
+          WARN("[Service thread] epoll_ctl failed : %s", strerror(errno));
+          return NULL;
+        }
         npeers++;
         peers[s].localRank = -1;
       }
@@ -1120,60 +1762,59 @@ void* ncclProxyService(void* _args) {
     for (int s=0; s<maxnpeers; s++) {
       struct ncclProxyLocalPeer* peer = peers+s;
       struct ncclSocket* sock = &peer->sock;
-      struct ncclProxyAsyncOp* op = &peer->asyncOps;
       int closeConn = 0;
       int type = 0;
       ncclResult_t res = ncclSuccess;
 
-      if (pollfds[s].fd == -1) continue;
-      if (op->type != 0) {
-        res = proxyProgressAsync(op, comm, &asyncOpCount);
-        type = op->type;
-        if (res != ncclSuccess) closeConn = 1;
-      } else if (pollfds[s].revents & POLLIN) {
-        int closed;
-        if (ncclSocketTryRecv(sock, &type, sizeof(int), &closed) != ncclSuccess) {
-          WARN("[Service thread] Could not receive type from localRank %d", peer->localRank);
-          closeConn = 1;
-        } else if (closed) {
-          INFO(NCCL_INIT|NCCL_NET, "[Service thread] Connection closed by localRank %d", peer->localRank);
-          closeConn = 1;
-        } else {
-          if (type == ncclProxyMsgStop) {
-            stop = 1;
+      if (fds[s] == -1) continue;
+      if (revents[s] & EPOLLIN) {
+        // Drain the requests already received, so that they progress concurrently
+        for (int first=1; res == ncclSuccess && closeConn == 0; first=0) {
+          if (peer->pendingType || peer->nAsyncOps == NCCL_PROXY_MAX_ASYNC_OPS) break;
+          int avail = 0;
+          if (!first && (ioctl(fds[s], FIONREAD, &avail) != 0 || avail < (int)sizeof(int))) break;
+          int closed;
+          if (ncclSocketTryRecv(sock, &type, sizeof(int), &closed) != ncclSuccess) {
+            WARN("[Service thread] Could not receive type from localRank %d", peer->localRank);
             closeConn = 1;
-          } else if (type == ncclProxyMsgClose) {
+          } else if (closed) {
+            INFO(NCCL_INIT|NCCL_NET, "[Service thread] Connection closed by localRank %d", peer->localRank);
             closeConn = 1;
-          } else if (type == ncclProxyMsgInit) {
-            res = proxyConnInit(peers+s, &connectionPool, comm);
-          } else if (type == ncclProxyMsgSharedInit) {
-            res = proxyConnSharedInit(peers+s, &connectionPool, comm);
           } else if (type == ncclProxyMsgSetup || type == ncclProxyMsgConnect) {
-            res = proxyConnSetupConnect(type, peers+s, &connectionPool, comm, &asyncOpCount);
+            res = proxyConnSetupConnect(type, peer, &connectionPool, comm, &asyncOpCount);
+          } else if (peer->nAsyncOps) {
+            peer->pendingType = type;
           } else {
-            WARN("[Service thread] Unknown command %d from localRank %d\n", type, peer->localRank);
-            closeConn = 1;
+            res = proxyServiceRequest(type, peer, &connectionPool, comm, &stop, &closeConn);
           }
         }
-      } else if (pollfds[s].revents & POLLHUP) {
+      } else if (revents[s] & (EPOLLHUP|EPOLLRDHUP|EPOLLERR)) {
         closeConn = 1;
-      } 
+      }
+      if (res == ncclSuccess && closeConn == 0 && peer->nAsyncOps) {
+        type = proxyPeerAsyncOp(peer, 0)->type;
+        res = proxyProgressPeer(peer, comm, &asyncOpCount);
+      }
+      if (res == ncclSuccess && closeConn == 0 && peer->pendingType && peer->nAsyncOps == 0) {
+        type = peer->pendingType;
+        peer->pendingType = 0;
+        res = proxyServiceRequest(type, peer, &connectionPool, comm, &stop, &closeConn);
+      }
       if (res != ncclSuccess) {
         WARN("[Proxy Service %d] Failed to execute operation %s from rank %d, retcode %d", comm->rank, ncclProxyMsgTypeStr[type], comm->localRankToRank[peer->localRank], res);
         closeConn = 1;
       }
       if (closeConn) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fds[s], NULL);
         ncclSocketClose(sock);
-        if (op->reqBuff) {
-          free(op->reqBuff);
-          op->reqBuff = NULL;
+        for (int i=0; i<peer->nAsyncOps; i++) {
+          struct ncclProxyAsyncOp* op = proxyPeerAsyncOp(peer, i);
+          if (op->done == 0) asyncOpCount--;
+          proxyAsyncOpFree(op);
         }
-        if (op->respBuff) {
-          free(op->respBuff);
-          op->respBuff = NULL;
-        }
-        op->type = 0;
-        pollfds[s].fd = -1;
+        peer->nAsyncOps = 0;
+        peer->pendingType = 0;
+        fds[s] = -1;
         npeers--;
       }
     }
@@ -1186,6 +1827,7 @@ void* ncclProxyService(void* _args) {
   for (int s=0; s<maxnpeers; s++) {
     ncclSocketClose(&peers[s].sock);
   }
+  close(epollFd);
   ncclProxyFreeConnections(&connectionPool, comm);
   ncclSocketClose(comm->proxyState.listenSock);
   proxyOpsFree(comm);
@@ -1237,7 +1879,14 @@ ncclResult_t ncclProxyDestroy(struct ncclComm* comm) {
         NCCLCHECK(ncclSocketClose(state->peerSocks + i));
       }
     }
+    for (int i=0; i<comm->localRanks; i++) {
+      struct ncclProxyPendingCalls* pending = state->pendingCalls+i;
+      for (int d=0; d<pending->deferredCount; d++) free(pending->deferred[(pending->deferredHead+d)%pending->deferredSize].reqBuff);
+      free(pending->deferred);
+      free(pending->calls);
+    }
     free(state->peerSocks);
+    free(state->pendingCalls);
     free(state->proxyOps);
     free(state->sharedDevMems);
   }
@@ -0,0 +1,78 @@
+/*************************************************************************
+ * Copyright (c) 2016-2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include "proxy.h"
+#include "alloc.h"
+#include "debug.h"
+#include "align.h"
+
+// Sub args are carved from slabs, with one free list per power of two number of subs.
+// Most ops only have a few subs, so this keeps ncclProxyArgs small and the active list
+// compact, instead of embedding NCCL_PROXY_MAX_SUBS subs in each of them.
+#define PROXY_SUBS_SLAB_SIZE (64*1024)
+struct ncclProxySubsSlab {
+  struct ncclProxySubsSlab* next;
+};
+struct ncclProxySubsBlock {
+  struct ncclProxySubsBlock* next;
+};
+
+static ncclResult_t proxySubsAlloc(struct ncclProxyShard* shard, int subsClass, struct ncclProxySubArgs** subs) {
+  if (shard->freeSubs[subsClass] == NULL) {
+    const size_t blockSize = sizeof(struct ncclProxySubArgs) << subsClass;
+    const int nBlocks = std::max((size_t)1, PROXY_SUBS_SLAB_SIZE/blockSize);
+    // Keep blocks aligned like ncclProxySubArgs after the slab header
+    const size_t headerSize = alignUp(sizeof(struct ncclProxySubsSlab), alignof(struct ncclProxySubArgs));
+    char* mem;
+    NCCLCHECK(ncclCalloc(&mem, headerSize+nBlocks*blockSize));
+    struct ncclProxySubsSlab* slab = (struct ncclProxySubsSlab*)mem;
+    slab->next = shard->subsSlabs;
+    shard->subsSlabs = slab;
+    for (int b=nBlocks-1; b>=0; b--) {
+      struct ncclProxySubsBlock* block = (struct ncclProxySubsBlock*)(mem+headerSize+b*blockSize);
+      block->next = shard->freeSubs[subsClass];
+      shard->freeSubs[subsClass] = block;
+    }
+  }
+  struct ncclProxySubsBlock* block = shard->freeSubs[subsClass];
+  shard->freeSubs[subsClass] = block->next;
+  *subs = (struct ncclProxySubArgs*)block;
+  return ncclSuccess;
+}
+
+void ncclProxySubsFree(struct ncclProxyShard* shard, struct ncclProxyArgs* args) {
+  if (args->subs == NULL) return;
+  struct ncclProxySubsBlock* block = (struct ncclProxySubsBlock*)args->subs;
+  int subsClass = __builtin_ctz(args->maxSubs);
+  block->next = shard->freeSubs[subsClass];
+  shard->freeSubs[subsClass] = block;
+  args->subs = NULL;
+  args->maxSubs = 0;
+}
+
+// Make room for sub args up to subIndex. Subs are only appended while the op is not
+// running yet, so we can still move them.
+ncclResult_t ncclProxySubsReserve(struct ncclProxyShard* shard, struct ncclProxyArgs* args, int subIndex) {
+  if (subIndex < args->maxSubs) return ncclSuccess;
+  int subsClass = 0;
+  while ((1<<subsClass) <= subIndex) subsClass++;
+  struct ncclProxySubArgs* subs;
+  NCCLCHECK(proxySubsAlloc(shard, subsClass, &subs));
+  if (subIndex) memcpy(subs, args->subs, subIndex*sizeof(struct ncclProxySubArgs));
+  ncclProxySubsFree(shard, args);
+  args->subs = subs;
+  args->maxSubs = 1<<subsClass;
+  return ncclSuccess;
+}
+
+void ncclProxySubsDestroy(struct ncclProxyShard* shard) {
+  while (shard->subsSlabs != NULL) {
+    struct ncclProxySubsSlab* next = shard->subsSlabs->next;
+    free(shard->subsSlabs);
+    shard->subsSlabs = next;
+  }
+  for (int c=0; c<NCCL_PROXY_SUBS_CLASSES; c++) shard->freeSubs[c] = NULL;
+}
@@ -0,0 +1,271 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// Proxy progress loop micro-benchmark.
+//
+// Keeps a number of ops active on a progress list, each with a number of subs, and
+// walks the list like progressOps does: every visit reads and updates the sub args
+// the way the net progress functions do, ops complete after a number of steps and
+// are freed and replaced by new ones. The same workload runs on the sub args slabs
+// used by the proxy and on a copy of the previous layout, where every ncclProxyArgs
+// embedded NCCL_PROXY_MAX_SUBS sub args. No GPU or NIC is needed.
+//
+// Usage: nccl_proxy_bench [-o ops,...] [-s subs,...] [-n steps] [-t seconds]
+
+#include "core.h"
+#include "proxy.h"
+#include <unistd.h>
+
+// ncclProxyArgs before sub args were moved to slabs
+struct benchEmbeddedArgs {
+  struct ncclProxySubArgs subs[NCCL_PROXY_MAX_SUBS];
+  proxyProgressFunc_t progress;
+  int nsubs;
+  int done;
+  uint64_t opCount;
+  int sliceSteps;
+  int chunkSteps;
+  int chunkSize;
+  uint8_t dtype;
+  uint8_t redOp;
+  uint8_t pattern;
+  uint8_t protocol;
+  int state;
+  char* sharedBuff[NCCL_STEPS];
+  int sharedSize[NCCL_STEPS];
+  int idle;
+  struct benchEmbeddedArgs* next;
+  struct benchEmbeddedArgs* nextPeer;
+  struct benchEmbeddedArgs** proxyAppendPtr;
+};
+
+static ncclResult_t benchSubsReserve(struct ncclProxyShard* shard, struct benchEmbeddedArgs* args, int subIndex) { return ncclSuccess; }
+static void benchSubsFree(struct ncclProxyShard* shard, struct benchEmbeddedArgs* args) {}
+static ncclResult_t benchSubsReserve(struct ncclProxyShard* shard, struct ncclProxyArgs* args, int subIndex) { return ncclProxySubsReserve(shard, args, subIndex); }
+static void benchSubsFree(struct ncclProxyShard* shard, struct ncclProxyArgs* args) { ncclProxySubsFree(shard, args); }
+
+// Args are allocated in blocks of NCCL_MAX_OPS, as allocateArgs does
+template <typename Args>
+struct benchPool {
+  struct benchPool* next;
+  Args elems[NCCL_MAX_OPS];
+};
+
+template <typename Args>
+struct benchState {
+  struct ncclProxyShard shard;
+  Args* active;
+  Args* last;
+  Args* pool;
+  struct benchPool<Args>* pools;
+  int nsubs;
+  int nsteps;
+  uint64_t opCount;
+  uint64_t completed;
+};
+
+template <typename Args>
+static ncclResult_t benchAllocateArgs(struct benchState<Args>* state, Args** argsPtr) {
+  if (state->pool == NULL) {
+    struct benchPool<Args>* newPool;
+    NCCLCHECK(ncclCalloc(&newPool, 1));
+    for (int i=0; i+1<NCCL_MAX_OPS; i++) newPool->elems[i].next = newPool->elems+i+1;
+    state->pool = newPool->elems;
+    newPool->next = state->pools;
+    state->pools = newPool;
+  }
+  Args* args = state->pool;
+  state->pool = args->next;
+  args->next = args->nextPeer = NULL;
+  *argsPtr = args;
+  return ncclSuccess;
+}
+
+// Subs are added one at a time, like ProxyAppend aggregating ops into the same args
+template <typename Args>
+static ncclResult_t benchAppendOp(struct benchState<Args>* state) {
+  Args* args;
+  NCCLCHECK(benchAllocateArgs(state, &args));
+  for (int s=0; s<state->nsubs; s++) {
+    NCCLCHECK(benchSubsReserve(&state->shard, args, s));
+    struct ncclProxySubArgs* sub = args->subs+s;
+    memset(sub, 0, sizeof(struct ncclProxySubArgs));
+    sub->channelId = s;
+    sub->nsteps = state->nsteps;
+    sub->nbytes = 1<<20;
+    sub->peer = s;
+  }
+  args->nsubs = state->nsubs;
+  args->opCount = state->opCount++;
+  args->sliceSteps = args->chunkSteps = 1;
+  args->done = 0;
+  args->state = ncclProxyOpReady;
+  args->idle = 0;
+  if (state->active == NULL) state->active = args;
+  else state->last->next = args;
+  state->last = args;
+  return ncclSuccess;
+}
+
+// Every other poll of a request completes it, the others find the network busy
+static inline bool benchTest(struct ncclProxySubArgs* sub) {
+  return (sub->received++ & 1) == 1;
+}
+
+// Same accesses as a send progress function: post buffers, test requests, mark done
+template <typename Args>
+static void benchProgress(Args* args) {
+  if (args->state == ncclProxyOpReady) {
+    for (int s=0; s<args->nsubs; s++) {
+      struct ncclProxySubArgs* sub = args->subs+s;
+      sub->base = args->opCount;
+      sub->posted = sub->received = sub->transmitted = sub->done = 0;
+      sub->end = sub->nsteps;
+    }
+    args->state = ncclProxyOpProgress;
+  }
+  args->idle = 1;
+  for (int s=0; s<args->nsubs; s++) {
+    struct ncclProxySubArgs* sub = args->subs+s;
+    if (sub->done == sub->end) continue;
+    if (sub->posted < sub->end && sub->posted < sub->done+NCCL_STEPS) {
+      sub->requests[sub->posted%NCCL_STEPS] = sub;
+      sub->posted += args->sliceSteps;
+      args->idle = 0;
+    } else if (sub->transmitted < sub->posted) {
+      sub->transmitted += args->sliceSteps;
+      args->idle = 0;
+    } else if (sub->done < sub->transmitted && benchTest(sub)) {
+      sub->requests[sub->done%NCCL_STEPS] = NULL;
+      sub->done += args->sliceSteps;
+      if (sub->done == sub->end) args->done++;
+      args->idle = 0;
+    }
+  }
+  if (args->done == args->nsubs) args->state = ncclProxyOpNone;
+}
+
+// Walk the active list like progressOps, replacing completed ops with new ones
+template <typename Args>
+static ncclResult_t benchWalk(struct benchState<Args>* state) {
+  Args* prev = NULL;
+  Args* op = state->active;
+  int removed = 0;
+  while (op) {
+    benchProgress(op);
+    if (op->state == ncclProxyOpNone) {
+      Args* next = op->next;
+      if (prev) prev->next = next; else state->active = next;
+      if (state->last == op) state->last = prev;
+      benchSubsFree(&state->shard, op);
+      op->next = state->pool;
+      state->pool = op;
+      op = next;
+      removed++;
+    } else {
+      prev = op;
+      op = op->next;
+    }
+  }
+  for (int r=0; r<removed; r++) NCCLCHECK(benchAppendOp(state));
+  state->completed += removed;
+  return ncclSuccess;
+}
+
+static double benchTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+template <typename Args>
+static ncclResult_t benchRun(int nops, int nsubs, int nsteps, double seconds, double* walksPerSec, double* nsPerOp, double* opsPerSec) {
+  struct benchState<Args>* state;
+  NCCLCHECK(ncclCalloc(&state, 1));
+  state->nsubs = nsubs;
+  state->nsteps = nsteps;
+  for (int o=0; o<nops; o++) NCCLCHECK(benchAppendOp(state));
+  // Warm up, then time batches of walks until we ran for long enough
+  for (int w=0; w<1000; w++) NCCLCHECK(benchWalk(state));
+  state->completed = 0;
+  uint64_t walks = 0;
+  double start = benchTime(), elapsed;
+  do {
+    for (int w=0; w<256; w++) NCCLCHECK(benchWalk(state));
+    walks += 256;
+    elapsed = benchTime()-start;
+  } while (elapsed < seconds);
+  *walksPerSec = walks/elapsed;
+  *nsPerOp = elapsed*1e9/(walks*nops);
+  *opsPerSec = state->completed/elapsed;
+  ncclProxySubsDestroy(&state->shard);
+  while (state->pools) {
+    struct benchPool<Args>* next = state->pools->next;
+    free(state->pools);
+    state->pools = next;
+  }
+  free(state);
+  return ncclSuccess;
+}
+
+static int benchParseList(const char* str, int* values, int maxValues) {
+  int n = 0;
+  while (*str && n < maxValues) {
+    char* end;
+    values[n++] = strtol(str, &end, 0);
+    if (*end != ',') break;
+    str = end+1;
+  }
+  return n;
+}
+
+static void benchUsage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-o ops,...] [-s subs,...] [-n steps] [-t seconds]\n", argv0);
+}
+
+int main(int argc, char* argv[]) {
+  int ops[16] = { 2, 16, 128, 1024 };
+  int nOps = 4;
+  int subs[16] = { 1, 2, 8, 32 };
+  int nSubs = 4;
+  int nsteps = 64;
+  double seconds = 0.2;
+  int opt;
+  while ((opt = getopt(argc, argv, "o:s:n:t:h")) != -1) {
+    switch (opt) {
+      case 'o': nOps = benchParseList(optarg, ops, 16); break;
+      case 's': nSubs = benchParseList(optarg, subs, 16); break;
+      case 'n': nsteps = atoi(optarg); break;
+      case 't': seconds = atof(optarg); break;
+      default: benchUsage(argv[0]); return 1;
+    }
+  }
+  if (nOps == 0 || nSubs == 0 || nsteps < 1 || seconds <= 0) {
+    benchUsage(argv[0]);
+    return 1;
+  }
+  for (int s=0; s<nSubs; s++) {
+    if (subs[s] < 1 || subs[s] > NCCL_PROXY_MAX_SUBS) {
+      fprintf(stderr, "Number of subs must be between 1 and %d\n", NCCL_PROXY_MAX_SUBS);
+      return 1;
+    }
+  }
+  printf("%d steps per sub, ncclProxyArgs %zu bytes embedded, %zu bytes + %zu bytes per sub with slabs\n",
+      nsteps, sizeof(struct benchEmbeddedArgs), sizeof(struct ncclProxyArgs), sizeof(struct ncclProxySubArgs));
+  printf("%6s %5s | %12s %10s %12s | %12s %10s %12s | %7s\n", "ops", "subs",
+      "walks/s", "ns/op", "completed/s", "walks/s", "ns/op", "completed/s", "speedup");
+  printf("%12s | %36s | %36s |\n", "", "embedded subs", "sub args slabs");
+  for (int o=0; o<nOps; o++) {
+    for (int s=0; s<nSubs; s++) {
+      double embedded[3], slabs[3];
+      NCCLCHECK(benchRun<struct benchEmbeddedArgs>(ops[o], subs[s], nsteps, seconds, embedded+0, embedded+1, embedded+2));
+      NCCLCHECK(benchRun<struct ncclProxyArgs>(ops[o], subs[s], nsteps, seconds, slabs+0, slabs+1, slabs+2));
+      printf("%6d %5d | %12.0f %10.1f %12.0f | %12.0f %10.1f %12.0f | %6.2fx\n", ops[o], subs[s],
+          embedded[0], embedded[1], embedded[2], slabs[0], slabs[1], slabs[2], slabs[0]/embedded[0]);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,221 @@
+/*************************************************************************
+ * Copyright (c) 2022, NVIDIA CORPORATION. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// Offline topology search and tuning simulator.
+//
+// Loads a topology XML (as produced by NCCL_TOPO_DUMP_FILE), runs the same graph
+// search and tuning model as communicator init for a simulated number of nodes,
+// and prints the graphs and the algorithm/protocol chosen for each size. Only
+// the graph code is linked, so it runs on machines without GPUs or NICs.
+//
+// Usage: nccl_topo_sim [-n nodes] [-b minbytes] [-e maxbytes] [-f factor] [topo.xml]
+// The XML file defaults to NCCL_TOPO_FILE. NCCL_GRAPH_FILE and the other NCCL_*
+// graph and tuning variables are honored as in the library.
+
+#include "core.h"
+#include "graph.h"
+#include "graph/topo.h"
+#include "graph/xml.h"
+#include "info.h"
+#include "nvmlwrap.h"
+#include "transport.h"
+#include "channel.h"
+#include "net.h"
+#include <unistd.h>
+
+/* Entry points the graph code references but never reaches without a communicator */
+struct ncclTransport* ncclTransports[NTRANSPORTS];
+ncclResult_t initChannel(struct ncclComm* comm, int channelid) { return ncclInternalError; }
+int ncclNetVersion(struct ncclComm* comm) { return 0; }
+
+const char* ncclFuncStr[NCCL_NUM_FUNCTIONS] = { "Broadcast", "Reduce", "AllGather", "ReduceScatter", "AllReduce" };
+const char* ncclAlgoStr[NCCL_NUM_ALGORITHMS] = { "Tree", "Ring", "CollNetDirect", "CollNetChain" };
+const char* ncclProtoStr[NCCL_NUM_PROTOCOLS] = { "LL", "LL128", "Simple" };
+
+// Detection sets rank and keep on the GPUs and NICs of the communicator. Do the
+// same for every device of the file, using the NVML index as local rank.
+static ncclResult_t simPrepareXml(struct ncclXml* xml) {
+  for (int i=0; i<xml->maxIndex; i++) {
+    struct ncclXmlNode* node = xml->nodes+i;
+    int index;
+    NCCLCHECK(xmlGetAttrIndex(node, "dev", &index));
+    if (index == -1) continue;
+    if (strcmp(node->name, "gpu") == 0) {
+      int dev;
+      NCCLCHECK(xmlGetAttrInt(node, "dev", &dev));
+      NCCLCHECK(xmlSetAttrInt(node, "rank", dev));
+      NCCLCHECK(xmlSetAttrInt(node, "keep", 1));
+    } else if (strcmp(node->name, "net") == 0) {
+      NCCLCHECK(xmlSetAttrInt(node, "keep", 1));
+    }
+  }
+  NCCLCHECK(ncclTopoTrimXml(xml));
+  return ncclSuccess;
+}
+
+static void simPrintGraph(const char* name, struct ncclTopoSystem* system, struct ncclTopoGraph* graph) {
+  int ngpus = system->nodes[GPU].count;
+  printf("%s : pattern %d, crossNic %d, nChannels %d, bw %.1f/%.1f, type %s/%s, sameChannels %d\n", name,
+      graph->pattern, graph->crossNic, graph->nChannels, graph->bwIntra, graph->bwInter,
+      topoPathTypeStr[graph->typeIntra], topoPathTypeStr[graph->typeInter], graph->sameChannels);
+  for (int c=0; c<graph->nChannels; c++) {
+    printf("  %2d :", c);
+    if (system->nodes[NET].count > 0) printf(" %s/%d", topoNodeTypeStr[NET], graph->inter[2*c]);
+    for (int i=0; i<ngpus; i++) printf(" %s/%d", topoNodeTypeStr[GPU], graph->intra[ngpus*c+i]);
+    if (system->nodes[NET].count > 0) printf(" %s/%d", topoNodeTypeStr[NET], graph->inter[2*c+1]);
+    printf("\n");
+  }
+}
+
+static double simTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+static ncclResult_t simCompute(struct ncclTopoSystem* system, struct ncclTopoGraph* graph, const char* name) {
+  double start = simTime();
+  NCCLCHECK(ncclTopoCompute(system, graph));
+  double elapsed = simTime() - start;
+  simPrintGraph(name, system, graph);
+  printf("  search time %.1f ms\n", elapsed);
+  return ncclSuccess;
+}
+
+// Sizes accept K, M and G suffixes
+static size_t simParseSize(const char* str) {
+  char* end;
+  size_t size = strtoull(str, &end, 0);
+  switch (*end) {
+    case 'G': case 'g': size <<= 10; // fall through
+    case 'M': case 'm': size <<= 10; // fall through
+    case 'K': case 'k': size <<= 10;
+  }
+  return size;
+}
+
+static void simUsage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [-n nodes] [-b minbytes] [-e maxbytes] [-f factor] [topo.xml]\n", argv0);
+}
+
+int main(int argc, char* argv[]) {
+  int nNodes = 1;
+  size_t minBytes = 8, maxBytes = 1ULL<<30;
+  int factor = 2;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:b:e:f:h")) != -1) {
+    switch (opt) {
+      case 'n': nNodes = atoi(optarg); break;
+      case 'b': minBytes = simParseSize(optarg); break;
+      case 'e': maxBytes = simParseSize(optarg); break;
+      case 'f': factor = atoi(optarg); break;
+      default: simUsage(argv[0]); return 1;
+    }
+  }
+  const char* xmlTopoFile = optind < argc ? argv[optind] : getenv("NCCL_TOPO_FILE");
+  if (xmlTopoFile == NULL || nNodes < 1 || factor < 2 || minBytes == 0) {
+    simUsage(argv[0]);
+    return 1;
+  }
+  // There is no NVML to confirm P2P connectivity; trust the topology file.
+  setenv("NCCL_IGNORE_DISABLED_P2P", "2", 0);
+
+  struct ncclXml* xml;
+  NCCLCHECK(ncclCalloc(&xml, 1));
+  NCCLCHECK(ncclTopoGetXmlFromFile(xmlTopoFile, xml, 1));
+  if (xml->maxIndex == 0) {
+    fprintf(stderr, "%s : no topology found\n", xmlTopoFile);
+    return 1;
+  }
+  NCCLCHECK(simPrepareXml(xml));
+  struct ncclTopoSystem* system;
+  NCCLCHECK(ncclTopoGetSystemFromXml(xml, &system));
+  free(xml);
+
+  int ngpus = system->nodes[GPU].count;
+  if (ngpus == 0) {
+    fprintf(stderr, "%s : no GPU found\n", xmlTopoFile);
+    return 1;
+  }
+  // Same as ncclTopoTrimSystem : NICs are not used when everything fits on one node
+  NCCLCHECK(ncclTopoComputePaths(system, NULL));
+  if (nNodes == 1) {
+    for (int n=system->nodes[NET].count-1; n>=0; n--) NCCLCHECK(ncclTopoRemoveNode(system, NET, n));
+    NCCLCHECK(ncclTopoComputePaths(system, NULL));
+  }
+  NCCLCHECK(ncclTopoSearchInit(system));
+  printf("Topology %s : %d GPUs, %d NICs per node, %d nodes, %d ranks, maxBw %.1f totalBw %.1f\n", xmlTopoFile,
+      ngpus, system->nodes[NET].count, nNodes, ngpus*nNodes, system->maxBw, system->totalBw);
+
+  // Same searches as initTransportsRank
+  struct ncclTopoGraph ringGraph, treeGraph, collNetGraph;
+  memset(&ringGraph, 0, sizeof(ringGraph));
+  ringGraph.id = 0;
+  ringGraph.pattern = NCCL_TOPO_PATTERN_RING;
+  ringGraph.collNet = 0;
+  ringGraph.minChannels = 1;
+  ringGraph.maxChannels = MAXCHANNELS/2;
+  NCCLCHECK(simCompute(system, &ringGraph, "Ring"));
+
+  memset(&treeGraph, 0, sizeof(treeGraph));
+  treeGraph.id = 1;
+  treeGraph.pattern = NCCL_TOPO_PATTERN_BALANCED_TREE;
+  treeGraph.collNet = 0;
+  treeGraph.minChannels = 1;
+  treeGraph.maxChannels = ringGraph.nChannels;
+  NCCLCHECK(simCompute(system, &treeGraph, "Tree"));
+
+  memset(&collNetGraph, 0, sizeof(collNetGraph));
+  collNetGraph.id = 2;
+  collNetGraph.pattern = NCCL_TOPO_PATTERN_TREE;
+  collNetGraph.collNet = 1;
+  collNetGraph.minChannels = collNetGraph.maxChannels = ringGraph.nChannels;
+  NCCLCHECK(simCompute(system, &collNetGraph, "CollNet"));
+
+  if (ngpus*nNodes == 1) return 0;
+
+  struct ncclComm* comm;
+  NCCLCHECK(ncclCalloc(&comm, 1));
+  comm->topo = system;
+  comm->rank = -1; // Keep the tuning model quiet, we print our own table
+  comm->nRanks = ngpus*nNodes;
+  comm->nNodes = nNodes;
+  comm->nChannels = std::min(treeGraph.nChannels, ringGraph.nChannels);
+  comm->collNetSupport = nNodes > 1 && collNetGraph.nChannels > 0 ? 1 : 0;
+  // CollNet channel tuning depends on the number of heads, as set by connectCollNet
+  comm->channels[0].collnetDirect.nHeads = collNetGraph.nChannels;
+  int minCompCap, maxCompCap;
+  NCCLCHECK(ncclTopoGetCompCap(system, &minCompCap, &maxCompCap));
+  NCCLCHECK(ncclTopoTuneModel(comm, minCompCap, maxCompCap, &treeGraph, &ringGraph, &collNetGraph));
+
+  // Same selection as the library, for a single operation. CollNet is assumed to
+  // support every reduction, the network plugin is not loaded.
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    printf("\n%s\n%14s %14s %8s %9s %8s %12s %11s\n", ncclFuncStr[c], "size(B)", "algorithm", "protocol", "channels", "threads", "time(us)", "algbw(GB/s)");
+    for (size_t bytes = minBytes; bytes <= maxBytes; bytes *= factor) {
+      struct ncclInfo info;
+      memset(&info, 0, sizeof(info));
+      info.comm = comm;
+      info.coll = (ncclFunc_t)c;
+      info.nBytes = bytes;
+      if (ncclTopoGetAlgoInfo(&info, comm->collNetSupport, 1) != ncclSuccess) {
+        printf("%14zu %14s %8s %9s %8s %12s %11s\n", bytes, "-", "-", "-", "-", "-", "-");
+        continue;
+      }
+      // Model time on all channels, as used for the choice
+      struct ncclInfo timeInfo = info;
+      timeInfo.nChannels = 0;
+      float time;
+      NCCLCHECK(ncclTopoGetAlgoTime(&timeInfo, info.algorithm, info.protocol, 1, &time));
+      printf("%14zu %14s %8s %9d %8d %12.2f %11.2f\n", bytes, ncclAlgoStr[info.algorithm], ncclProtoStr[info.protocol],
+          info.nChannels, info.nThreads, time, bytes/(time*1e3));
+    }
+  }
+  ncclTopoFreeAlgoTables(comm);
+  free(comm);
+  ncclTopoFree(system);
+  return 0;
+}
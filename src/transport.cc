@@ -30,9 +30,9 @@ static ncclResult_t selectTransport(struct ncclComm* comm, struct ncclTopoGraph*
     NCCLCHECK(transport->canConnect(&ret, comm->topo, graph, myInfo, peerInfo));
     if (ret) {
       connector->transportComm = transportComm;
-      NCCLCHECK(transportComm->setup(comm, graph, myInfo, peerInfo, connect, connector, channelId, connIndex));
       if (transportType) *transportType = t;
-      return ncclSuccess;
+      // Pass ncclInProgress on, the setup is finished by calling it again
+      return transportComm->setup(comm, graph, myInfo, peerInfo, connect, connector, channelId, connIndex);
     }
   }
   WARN("No transport found for rank %d[%lx] -> rank %d[%lx]", myInfo->rank, myInfo->busId, peerInfo->rank, peerInfo->busId);
@@ -65,87 +65,174 @@ void dumpData(struct ncclConnect* data, int ndata) {
   }
 }
 
+// Number of peers whose connections are set up together: the proxy calls of all their
+// connectors are sent before waiting for the responses.
+NCCL_PARAM(ConnectRoundMaxPeers, "CONNECT_ROUND_MAX_PEERS", 128);
+
 ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph* graph, int connIndex, int* highestTransportType/*=NULL*/) {
   // Stream used during transport setup; need for P2P pre-connect + CUDA Graph
   ncclResult_t ret = ncclSuccess;
   int highestType = TRANSPORT_P2P;  // track highest transport type
-  struct ncclConnect data[2*MAXCHANNELS];
+  int maxPeers = std::max(1, std::min((int)ncclParamConnectRoundMaxPeers(), comm->nRanks-1));
+  // Per peer of a round: connect info of all its channels, where the received send/recv
+  // data is, and the connectors still in progress
+  struct ncclConnect* data = NULL;
+  struct ncclConnect** recvData = NULL;
+  struct ncclConnect** sendData = NULL;
+  uint64_t* recvPending = NULL;
+  uint64_t* sendPending = NULL;
+  bool inProgress;
 
   NCCLCHECKGOTO(ncclStrongStreamAcquireUncaptured(&comm->hostStream), ret, fail);
-  for (int i=1; i<comm->nRanks; i++) {
-    int bootstrapTag = (i<<8) + (graph ? graph->id+1 : 0);
-    int recvPeer = (comm->rank - i + comm->nRanks) % comm->nRanks;
-    int sendPeer = (comm->rank + i) % comm->nRanks;
-    uint64_t recvMask = comm->connectRecv[recvPeer];
-    uint64_t sendMask = comm->connectSend[sendPeer];
+  NCCLCHECKGOTO(ncclCalloc(&data, maxPeers*2*MAXCHANNELS), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&recvData, maxPeers), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&sendData, maxPeers), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&recvPending, maxPeers), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&sendPending, maxPeers), ret, fail);
+  for (int first=1; first<comm->nRanks; first+=maxPeers) {
+    int last = std::min(first+maxPeers, comm->nRanks);
 
-    struct ncclConnect* recvData = data;
-    int sendChannels = 0, recvChannels = 0;
-    int type;
+    // Setup all connectors, calling again those which are in progress once the proxies responded
     TIME_START(0);
-    for (int c=0; c<MAXCHANNELS; c++) {
-      if (recvMask & (1UL<<c)) {
-        NCCLCHECKGOTO(selectTransport<0>(comm, graph, recvData+recvChannels++, c, recvPeer, connIndex, &type), ret, fail);
-        if (type > highestType) highestType = type;
+    for (int pass=0; ; pass++) {
+      inProgress = false;
+      for (int i=first; i<last; i++) {
+        int p = i-first;
+        int recvPeer = (comm->rank - i + comm->nRanks) % comm->nRanks;
+        int sendPeer = (comm->rank + i) % comm->nRanks;
+        uint64_t recvMask = pass ? recvPending[p] : comm->connectRecv[recvPeer];
+        uint64_t sendMask = pass ? sendPending[p] : comm->connectSend[sendPeer];
+        // Channels are packed in order, recv first, with all channels of the peer
+        int recvChannels = __builtin_popcountll(comm->connectRecv[recvPeer]);
+        struct ncclConnect* peerData = data+p*2*MAXCHANNELS;
+        int type;
+        recvPending[p] = sendPending[p] = 0UL;
+        for (int c=0; c<MAXCHANNELS; c++) {
+          if (recvMask & (1UL<<c)) {
+            struct ncclConnect* connect = peerData+__builtin_popcountll(comm->connectRecv[recvPeer] & ((1UL<<c)-1));
+            if (pass == 0) {
+              NCCLCHECKGOTO(selectTransport<0>(comm, graph, connect, c, recvPeer, connIndex, &type), ret, fail);
+              if (type > highestType) highestType = type;
+            } else {
+              struct ncclConnector* conn = comm->channels[c].peers[recvPeer].recv + connIndex;
+              NCCLCHECKGOTO(conn->transportComm->setup(comm, graph, comm->peerInfo+comm->rank, comm->peerInfo+recvPeer, connect, conn, c, connIndex), ret, fail);
+            }
+            if (ret == ncclInProgress) recvPending[p] |= 1UL<<c;
+          }
+        }
+        for (int c=0; c<MAXCHANNELS; c++) {
+          if (sendMask & (1UL<<c)) {
+            struct ncclConnect* connect = peerData+recvChannels+__builtin_popcountll(comm->connectSend[sendPeer] & ((1UL<<c)-1));
+            if (pass == 0) {
+              NCCLCHECKGOTO(selectTransport<1>(comm, graph, connect, c, sendPeer, connIndex, &type), ret, fail);
+              if (type > highestType) highestType = type;
+            } else {
+              struct ncclConnector* conn = comm->channels[c].peers[sendPeer].send + connIndex;
+              NCCLCHECKGOTO(conn->transportComm->setup(comm, graph, comm->peerInfo+comm->rank, comm->peerInfo+sendPeer, connect, conn, c, connIndex), ret, fail);
+            }
+            if (ret == ncclInProgress) sendPending[p] |= 1UL<<c;
+          }
+        }
+        if (recvPending[p] | sendPending[p]) inProgress = true;
       }
+      NCCLCHECKGOTO(ncclProxyCallWaitAll(comm), ret, fail);
+      if (!inProgress) break;
     }
     TIME_STOP(0);
-    TIME_START(1);
-    struct ncclConnect* sendData = recvData+recvChannels;
-    for (int c=0; c<MAXCHANNELS; c++) {
-      if (sendMask & (1UL<<c)) {
-        NCCLCHECKGOTO(selectTransport<1>(comm, graph, sendData+sendChannels++, c, sendPeer, connIndex, &type), ret, fail);
-        if (type > highestType) highestType = type;
-      }
-    }
-    TIME_STOP(1);
 
     TIME_START(2);
-    if (sendPeer == recvPeer) {
-      if (recvChannels+sendChannels) {
-         NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, recvPeer, bootstrapTag, data, sizeof(struct ncclConnect)*(recvChannels+sendChannels)), ret, fail);
-         NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, recvPeer, bootstrapTag, data, sizeof(struct ncclConnect)*(recvChannels+sendChannels)), ret, fail);
-         sendData = data;
-         recvData = data+sendChannels;
+    for (int i=first; i<last; i++) {
+      int p = i-first;
+      int bootstrapTag = (i<<8) + (graph ? graph->id+1 : 0);
+      int recvPeer = (comm->rank - i + comm->nRanks) % comm->nRanks;
+      int sendPeer = (comm->rank + i) % comm->nRanks;
+      int recvChannels = __builtin_popcountll(comm->connectRecv[recvPeer]);
+      int sendChannels = __builtin_popcountll(comm->connectSend[sendPeer]);
+      struct ncclConnect* peerData = data+p*2*MAXCHANNELS;
+      recvData[p] = peerData;
+      sendData[p] = peerData+recvChannels;
+      if (sendPeer == recvPeer) {
+        if (recvChannels+sendChannels) {
+           NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, recvPeer, bootstrapTag, peerData, sizeof(struct ncclConnect)*(recvChannels+sendChannels)), ret, fail);
+           NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, recvPeer, bootstrapTag, peerData, sizeof(struct ncclConnect)*(recvChannels+sendChannels)), ret, fail);
+           sendData[p] = peerData;
+           recvData[p] = peerData+sendChannels;
+        }
+      } else {
+        if (recvChannels) NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, recvPeer, bootstrapTag, recvData[p], sizeof(struct ncclConnect)*recvChannels), ret, fail);
+        if (sendChannels) NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, sendPeer, bootstrapTag, sendData[p], sizeof(struct ncclConnect)*sendChannels), ret, fail);
+        if (sendChannels) NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, sendPeer, bootstrapTag, sendData[p], sizeof(struct ncclConnect)*sendChannels), ret, fail);
+        if (recvChannels) NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, recvPeer, bootstrapTag, recvData[p], sizeof(struct ncclConnect)*recvChannels), ret, fail);
       }
-    } else {
-      if (recvChannels) NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, recvPeer, bootstrapTag, recvData, sizeof(struct ncclConnect)*recvChannels), ret, fail);
-      if (sendChannels) NCCLCHECKGOTO(bootstrapSend(comm->bootstrap, sendPeer, bootstrapTag, sendData, sizeof(struct ncclConnect)*sendChannels), ret, fail);
-      if (sendChannels) NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, sendPeer, bootstrapTag, sendData, sizeof(struct ncclConnect)*sendChannels), ret, fail);
-      if (recvChannels) NCCLCHECKGOTO(bootstrapRecv(comm->bootstrap, recvPeer, bootstrapTag, recvData, sizeof(struct ncclConnect)*recvChannels), ret, fail);
     }
     TIME_STOP(2);
 
+    // Connect all connectors the same way, send then recv for each peer
     TIME_START(3);
-    for (int c=0; c<MAXCHANNELS; c++) {
-      if (sendMask & (1UL<<c)) {
-        struct ncclConnector* conn = comm->channels[c].peers[sendPeer].send + connIndex;
-        NCCLCHECKGOTO(conn->transportComm->connect(comm, sendData++, 1, comm->rank, conn), ret, fail);
-        conn->connected = 1;
-        CUDACHECKGOTO(cudaMemcpyAsync(&comm->channels[c].devPeers[sendPeer].send[connIndex], &conn->conn, sizeof(struct ncclConnInfo), cudaMemcpyHostToDevice, comm->hostStream.cudaStream), ret, fail);
+    for (int pass=0; ; pass++) {
+      inProgress = false;
+      for (int i=first; i<last; i++) {
+        int p = i-first;
+        int recvPeer = (comm->rank - i + comm->nRanks) % comm->nRanks;
+        int sendPeer = (comm->rank + i) % comm->nRanks;
+        uint64_t sendMask = pass ? sendPending[p] : comm->connectSend[sendPeer];
+        uint64_t recvMask = pass ? recvPending[p] : comm->connectRecv[recvPeer];
+        recvPending[p] = sendPending[p] = 0UL;
+        for (int c=0; c<MAXCHANNELS; c++) {
+          if (sendMask & (1UL<<c)) {
+            struct ncclConnector* conn = comm->channels[c].peers[sendPeer].send + connIndex;
+            struct ncclConnect* connect = sendData[p]+__builtin_popcountll(comm->connectSend[sendPeer] & ((1UL<<c)-1));
+            NCCLCHECKGOTO(conn->transportComm->connect(comm, connect, 1, comm->rank, conn), ret, fail);
+            if (ret == ncclInProgress) {
+              sendPending[p] |= 1UL<<c;
+            } else {
+              conn->connected = 1;
+              CUDACHECKGOTO(cudaMemcpyAsync(&comm->channels[c].devPeers[sendPeer].send[connIndex], &conn->conn, sizeof(struct ncclConnInfo), cudaMemcpyHostToDevice, comm->hostStream.cudaStream), ret, fail);
+            }
+          }
+        }
+        for (int c=0; c<MAXCHANNELS; c++) {
+          if (recvMask & (1UL<<c)) {
+            struct ncclConnector* conn = comm->channels[c].peers[recvPeer].recv + connIndex;
+            struct ncclConnect* connect = recvData[p]+__builtin_popcountll(comm->connectRecv[recvPeer] & ((1UL<<c)-1));
+            NCCLCHECKGOTO(conn->transportComm->connect(comm, connect, 1, comm->rank, conn), ret, fail);
+            if (ret == ncclInProgress) {
+              recvPending[p] |= 1UL<<c;
+            } else {
+              conn->connected = 1;
+              CUDACHECKGOTO(cudaMemcpyAsync(&comm->channels[c].devPeers[recvPeer].recv[connIndex], &conn->conn, sizeof(struct ncclConnInfo), cudaMemcpyHostToDevice, comm->hostStream.cudaStream), ret, fail);
+            }
+          }
+        }
+        if (recvPending[p] | sendPending[p]) inProgress = true;
       }
+      if (!inProgress) break;
+      NCCLCHECKGOTO(ncclProxyCallWaitAll(comm), ret, fail);
     }
     TIME_STOP(3);
-    TIME_START(4);
-    for (int c=0; c<MAXCHANNELS; c++) {
-      if (recvMask & (1UL<<c)) {
-        struct ncclConnector* conn = comm->channels[c].peers[recvPeer].recv + connIndex;
-        NCCLCHECKGOTO(conn->transportComm->connect(comm, recvData++, 1, comm->rank, conn), ret, fail);
-        conn->connected = 1;
-        CUDACHECKGOTO(cudaMemcpyAsync(&comm->channels[c].devPeers[recvPeer].recv[connIndex], &conn->conn, sizeof(struct ncclConnInfo), cudaMemcpyHostToDevice, comm->hostStream.cudaStream), ret, fail);
-      }
+
+    for (int i=first; i<last; i++) {
+      int recvPeer = (comm->rank - i + comm->nRanks) % comm->nRanks;
+      int sendPeer = (comm->rank + i) % comm->nRanks;
+      comm->connectRecv[recvPeer] = comm->connectSend[sendPeer] = 0UL;
     }
-    TIME_STOP(4);
-    comm->connectRecv[recvPeer] = comm->connectSend[sendPeer] = 0UL;
   }
+  ret = ncclSuccess;
 
   if (highestTransportType != NULL) *highestTransportType = highestType;
   TIME_PRINT("P2P Setup/Connect");
 exit:
+  free(data);
+  free(recvData);
+  free(sendData);
+  free(recvPending);
+  free(sendPending);
   NCCLCHECK(ncclStrongStreamWaitStream(ncclCudaGraphNone(), &comm->deviceStream, &comm->hostStream));
   NCCLCHECK(ncclStrongStreamRelease(ncclCudaGraphNone(), &comm->hostStream));
   return ret;
 fail:
+  // Responses still in flight point into data
+  ncclProxyCallWaitAll(comm);
   goto exit;
 }
 
@@ -285,7 +285,7 @@ static ncclResult_t sendProxySetup(struct ncclProxyConnection* connection, struc
   connection->transportResources = resources;
   connection->shared = 1;
 
-  resources->netDev = req->netDev;
+  resources->netDev = connection->netDev = req->netDev;
   resources->useGdr = req->useGdr;
   ncclNetProperties_t props;
   NCCLCHECK(collNetGetProperties(comm, req->netDev, &props));
@@ -394,7 +394,7 @@ static ncclResult_t recvProxySetup(struct ncclProxyConnection* connection, struc
   connection->transportResources = resources;
   connection->shared = 1;
 
-  resources->netDev = req->netDev;
+  resources->netDev = connection->netDev = req->netDev;
   resources->useGdr = req->useGdr;
   resources->needFlush = req->needFlush;
   ncclNetProperties_t props;
@@ -678,6 +678,7 @@ static ncclResult_t sendProxyProgress(struct ncclComm* comm, struct ncclProxyArg
           // Make sure size is reset to zero before we update the head.
           __sync_synchronize();
           sub->transmitted += args->sliceSteps;
+          ncclProxyNetPosted(args);
           args->idle = 0;
           continue;
         }
@@ -695,6 +696,7 @@ static ncclResult_t sendProxyProgress(struct ncclComm* comm, struct ncclProxyArg
           __sync_synchronize();
           reqFifo[group][buffSlot].recvBuff = NULL; // Notify recvProxy
           for (int i=group*COLLNET_GROUP_NSUBS; i<=s; i++) args->subs[i].done += args->sliceSteps;
+          ncclProxyNetCompleted(args);
           args->idle = 0;
           int allDone = 1;
           for (int i=0; i<args->nsubs; i++) {
@@ -775,6 +777,7 @@ static ncclResult_t recvProxyProgress(struct ncclComm* comm, struct ncclProxyArg
               int offset;
               NCCLCHECK(sharedBuffersGet(comm, 1, sharedBuffSlot, startChannel, &offset));
               NCCLCHECK(collNetIflush(comm, resources->collNetComm, localBuff + offset, totalSize, mhandle, sub->requests+buffSlot));
+              if (sub->requests[buffSlot]) ncclProxyNetPosted(args);
             }
           } else {
             for (int i=group*COLLNET_GROUP_NSUBS; i<=s; i++) args->subs[i].flushed += args->sliceSteps;
@@ -791,6 +794,7 @@ static ncclResult_t recvProxyProgress(struct ncclComm* comm, struct ncclProxyArg
         if (sub->requests[buffSlot]) NCCLCHECK(collNetTest(comm, sub->requests[buffSlot], &done, NULL));
         if (done) {
           TRACE(NCCL_NET, "recvProxy [%d/%d/%d] flushed", sub->flushed, group, buffSlot);
+          if (sub->requests[buffSlot]) ncclProxyNetCompleted(args);
           for (int i=group*COLLNET_GROUP_NSUBS; i<=s; i++) args->subs[i].flushed += args->sliceSteps;
           args->idle = 0;
           //continue;
@@ -9,12 +9,15 @@
 #include "socket.h"
 #include "net.h"
 #include "param.h"
+#include "iouring.h"
 
 #include <pthread.h>
 #include <stdlib.h>
 #include <poll.h>
 #include <limits.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 /* Init functions */
 static int ncclNetIfs = -1;
@@ -27,6 +30,31 @@ static struct ncclNetSocketDev ncclNetSocketDevs[MAX_IFS];
 
 pthread_mutex_t ncclNetSocketLock = PTHREAD_MUTEX_INITIALIZER;
 
+// Engine used by helper threads to drive data sockets
+enum ncclNetSocketEngine {
+  ncclNetSocketEngineEpoll = 0,
+  ncclNetSocketEngineIoUring = 1
+};
+static enum ncclNetSocketEngine ncclNetSocketEngine = ncclNetSocketEngineEpoll;
+
+static void ncclNetSocketInitEngine() {
+  char* env = getenv("NCCL_SOCKET_ENGINE");
+  if (env == NULL || strcasecmp(env, "epoll") == 0) return;
+  if (strcasecmp(env, "io_uring") == 0 || strcasecmp(env, "iouring") == 0) {
+    // Make sure io_uring is usable here before committing to it
+    struct ncclIoUring ring;
+    if (ncclIoUringInit(&ring, 4) == ncclSuccess) {
+      ncclIoUringDestroy(&ring);
+      ncclNetSocketEngine = ncclNetSocketEngineIoUring;
+      INFO(NCCL_INIT|NCCL_NET, "NET/Socket : Using io_uring engine");
+    } else {
+      INFO(NCCL_INIT|NCCL_NET, "NET/Socket : io_uring not available, using epoll engine");
+    }
+  } else {
+    WARN("NET/Socket : unknown NCCL_SOCKET_ENGINE %s, using epoll", env);
+  }
+}
+
 static ncclResult_t ncclNetSocketGetPciPath(char* devName, char** pciPath) {
   char devicePath[PATH_MAX];
   snprintf(devicePath, PATH_MAX, "/sys/class/net/%s/device", devName);
@@ -60,6 +88,7 @@ ncclResult_t ncclNetSocketInit(ncclDebugLogger_t logFunction) {
         }
         line[MAX_LINE_LEN] = '\0';
         INFO(NCCL_INIT|NCCL_NET,"NET/Socket : Using%s", line);
+        ncclNetSocketInitEngine();
       }
     }
     pthread_mutex_unlock(&ncclNetSocketLock);
@@ -113,6 +142,7 @@ ncclResult_t ncclNetSocketGetProperties(int dev, ncclNetProperties_t* props) {
 
 NCCL_PARAM(SocketNsocksPerThread, "NSOCKS_PERTHREAD", -2);
 NCCL_PARAM(SocketNthreads, "SOCKET_NTHREADS", -2);
+NCCL_PARAM(SocketZeroCopy, "SOCKET_ZEROCOPY", 0);
 
 enum ncclNetSocketCommState {
   ncclNetSocketCommStateStart = 0,
@@ -137,14 +167,16 @@ struct ncclNetSocketHandle {
   struct ncclNetSocketCommStage stage;
 };
 
-struct ncclNetSocketTask {
-  int op;
-  void* data;
-  int size;
-  struct ncclSocket* sock;
-  int offset;
-  int used;
-  ncclResult_t result;
+// Data sockets carry a sequence of chunks, each preceded by a header telling
+// the receiver which request and which part of the message it belongs to.
+// This lets senders assign chunks to sockets dynamically, and since the header
+// also carries the message size, requests don't need to exchange their size
+// over the control socket before data can flow.
+struct ncclNetSocketChunkHeader {
+  uint32_t seq;    // Request sequence number within the comm
+  uint32_t offset; // Offset of the chunk within the message
+  uint32_t size;   // Chunk size in bytes
+  uint32_t total;  // Message size
 };
 
 struct ncclNetSocketRequest {
@@ -155,22 +187,80 @@ struct ncclNetSocketRequest {
   int offset;
   int used;
   struct ncclNetSocketComm* comm;
-  struct ncclNetSocketTask* tasks[MAX_SOCKETS];
-  int nSubs;
+  uint32_t seq;
+  // Send side: (seq << 32) | first byte not yet assigned to a socket.
+  // Tagging the cursor with seq makes a stale claim on a recycled request fail.
+  uint64_t cursor;
+  int done; // Bytes transferred (and released by the kernel) over all data sockets
+  int msgSize; // Message size; receives learn it from the first chunk header (-1 until then)
+};
+
+#define NCCL_NET_SOCKET_ZC_PENDING 16
+
+struct ncclNetSocketZcPending {
+  uint32_t seq; // Zero-copy sequence number to wait for
+  int bytes;
+  struct ncclNetSocketRequest* req;
+};
+
+// Per data socket state. Each socket is owned by a single helper thread.
+struct ncclNetSocketSockState {
+  struct ncclNetSocketChunkHeader hdr; // Header of the current chunk
+  int hdrOffset;
+  struct ncclNetSocketRequest* req; // Request the current chunk belongs to, NULL when idle
+  int offset; // Payload bytes of the current chunk transferred so far
+  int zc; // Current chunk payload is sent with MSG_ZEROCOPY
+  // Scheduler statistics
+  uint64_t chunkStart;
+  uint64_t bw; // Moving average of the measured throughput in bytes/s
+  uint64_t bytes; // Total payload bytes transferred
+  // epoll engine
+  int ready; // Edge-triggered readiness, cleared when the socket returns EAGAIN
+  // io_uring engine
+  int busy; // A send/recv is in flight on the socket
+  int* xferOffset;
+  int closed; // The peer closed the connection between two chunks
+  // Zero-copy
+  int zcReady; // Error queue may hold completions
+  uint32_t zcNext; // Sequence number of the next zero-copy send
+  uint32_t zcDone; // All sequence numbers below this one have completed
+  int zcHead, zcTail;
+  struct ncclNetSocketZcPending zcPending[NCCL_NET_SOCKET_ZC_PENDING];
+};
+
+struct ncclNetSocketRequestRef {
+  struct ncclNetSocketRequest* req;
+  uint32_t seq; // Lets the helper thread detect that the request was completed and recycled
 };
 
-struct ncclNetSocketTaskQueue {
-  int next;
-  int len;
-  struct ncclNetSocketTask* tasks;
+// Single-producer/single-consumer ring handing published requests from the
+// caller to one helper thread. Head and tail live on separate cache lines.
+#define NCCL_NET_SOCKET_RING_SIZE MAX_REQUESTS
+struct ncclNetSocketRequestRing {
+  uint32_t tail; // Written by the caller
+  char pad1[CACHE_LINE_SIZE-sizeof(uint32_t)];
+  uint32_t head; // Written by the helper thread
+  char pad2[CACHE_LINE_SIZE-sizeof(uint32_t)];
+  struct ncclNetSocketRequestRef slots[NCCL_NET_SOCKET_RING_SIZE];
 };
 
 struct ncclNetSocketThreadResources {
-  struct ncclNetSocketTaskQueue threadTaskQueue;
+  struct ncclNetSocketRequestRing reqRing;
+  // Requests taken from reqRing, oldest first. Only accessed by the helper thread.
+  struct ncclNetSocketRequestRef active[2*MAX_REQUESTS];
+  int nActive;
+  int tid;
   int stop;
   struct ncclNetSocketComm* comm;
-  pthread_mutex_t threadLock;
-  pthread_cond_t  threadCond;
+  // The helper thread waits on the sockets it owns plus an eventfd used by
+  // the caller to signal new requests or stop.
+  int eventFd;
+  int sleeping; // Set while the helper thread is (about to be) blocked, see ncclNetSocketPublish
+  // epoll engine state
+  int epollFd;
+  // io_uring engine state
+  struct ncclIoUring ring;
+  uint64_t eventCount; // Target of the in-flight eventfd read
 };
 
 struct ncclNetSocketListenComm {
@@ -188,47 +278,468 @@ struct ncclNetSocketComm {
   int cudaDev;
   int nSocks;
   int nThreads;
-  int nextSock;
+  int op;
+  int zeroCopy;
+  ncclResult_t threadResult; // First error hit by a helper thread
+  int nClosed; // Sockets closed by the peer, see ncclNetSocketSockClosed
+  uint32_t nextSeq; // Sequence number of the next request posted
+  uint32_t pubSeq; // Sequence number of the next request to hand to the helper threads
   struct ncclNetSocketRequest requests[MAX_REQUESTS];
+  struct ncclNetSocketSockState sockState[MAX_SOCKETS];
   pthread_t helperThread[MAX_THREADS];
   struct ncclNetSocketThreadResources threadResources[MAX_THREADS];
 };
 
+// Pick the size of the next chunk for socket s. We use guided self-scheduling:
+// chunks shrink as the message drains so that fast sockets can pick up the
+// tail, and each chunk is scaled by how fast the socket has been compared to
+// the others.
+static int ncclNetSocketChunkSize(struct ncclNetSocketComm* comm, int s, int remaining) {
+  uint64_t chunk = DIVUP(remaining, 2*comm->nSocks);
+  uint64_t bw = __atomic_load_n(&comm->sockState[s].bw, __ATOMIC_RELAXED);
+  if (bw) {
+    uint64_t bwSum = 0;
+    int nMeasured = 0;
+    for (int i=0; i<comm->nSocks; i++) {
+      uint64_t b = __atomic_load_n(&comm->sockState[i].bw, __ATOMIC_RELAXED);
+      if (b) { bwSum += b; nMeasured++; }
+    }
+    uint64_t avg = bwSum / nMeasured;
+    chunk = std::min(4*chunk, std::max(chunk/4, chunk*bw/avg));
+  }
+  chunk = std::max(chunk, (uint64_t)MIN_CHUNKSIZE);
+  return (int)std::min(chunk, (uint64_t)remaining);
+}
+
+// Empty messages still send one (empty) chunk so that the receiver learns about them
+static uint32_t ncclNetSocketClaimEnd(struct ncclNetSocketRequest* r) {
+  return r->size ? r->size : 1;
+}
+
+static bool ncclNetSocketRefValid(struct ncclNetSocketRequestRef* ref) {
+  struct ncclNetSocketRequest* r = ref->req;
+  if (__atomic_load_n(&r->used, __ATOMIC_ACQUIRE) != 2 || r->seq != ref->seq) return false;
+  return __atomic_load_n(&r->used, __ATOMIC_ACQUIRE) == 2; // Recycled while we were looking
+}
+
+// Helper thread: drop requests which no longer need this thread and pull newly
+// published requests from the ring.
+static void ncclNetSocketUpdateActive(struct ncclNetSocketThreadResources* res) {
+  struct ncclNetSocketComm* comm = res->comm;
+  int n = 0;
+  for (int i=0; i<res->nActive; i++) {
+    struct ncclNetSocketRequestRef* ref = res->active+i;
+    if (!ncclNetSocketRefValid(ref)) continue;
+    struct ncclNetSocketRequest* r = ref->req;
+    if (comm->op == NCCL_SOCKET_SEND) {
+      // Sockets hold on to the request of their current chunk, we only need it to claim more chunks
+      uint64_t cursor = __atomic_load_n(&r->cursor, __ATOMIC_ACQUIRE);
+      if ((uint32_t)(cursor >> 32) != ref->seq || (uint32_t)(cursor & 0xffffffff) >= ncclNetSocketClaimEnd(r)) continue;
+    } else {
+      // Any of our sockets may still receive a chunk until the request is complete
+      if (__atomic_load_n(&r->done, __ATOMIC_ACQUIRE) == __atomic_load_n(&r->msgSize, __ATOMIC_ACQUIRE)) continue;
+    }
+    res->active[n++] = *ref;
+  }
+  res->nActive = n;
+  struct ncclNetSocketRequestRing* ring = &res->reqRing;
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  while (head != tail && res->nActive < 2*MAX_REQUESTS) {
+    res->active[res->nActive++] = ring->slots[head%NCCL_NET_SOCKET_RING_SIZE];
+    head++;
+  }
+  __atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+}
+
+// Send side: claim the next chunk from the oldest published request which still has unassigned bytes.
+static void ncclNetSocketClaimChunk(struct ncclNetSocketComm* comm, int s) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  struct ncclNetSocketThreadResources* res = comm->threadResources+(s%comm->nThreads);
+  for (int i=0; i<res->nActive; i++) {
+    struct ncclNetSocketRequestRef* ref = res->active+i;
+    if (!ncclNetSocketRefValid(ref)) continue;
+    struct ncclNetSocketRequest* oldest = ref->req;
+    uint64_t cursor = __atomic_load_n(&oldest->cursor, __ATOMIC_ACQUIRE);
+    if ((uint32_t)(cursor >> 32) != ref->seq || (uint32_t)(cursor & 0xffffffff) >= ncclNetSocketClaimEnd(oldest)) continue;
+    uint32_t offset = cursor & 0xffffffff;
+    // Empty sends complete as soon as they are claimed, so don't look at the request past the CAS.
+    int total = oldest->size;
+    int size = total ? ncclNetSocketChunkSize(comm, s, total - offset) : 0;
+    // Another socket may have claimed this range, or the request may have been recycled; retry.
+    if (!__atomic_compare_exchange_n(&oldest->cursor, &cursor, cursor+std::max(size, 1), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      i--;
+      continue;
+    }
+    ss->req = oldest;
+    ss->hdr.seq = cursor >> 32;
+    ss->hdr.offset = offset;
+    ss->hdr.size = size;
+    ss->hdr.total = total;
+    ss->hdrOffset = 0;
+    ss->offset = 0;
+    ss->zc = __atomic_load_n(&comm->zeroCopy, __ATOMIC_RELAXED);
+    ss->chunkStart = clockNano();
+    return;
+  }
+}
+
+static void ncclNetSocketSockAdvance(struct ncclNetSocketComm* comm, int s);
+
+// Return the next transfer socket s has to perform, either a chunk header or
+// a chunk payload, or set *ptr to NULL when the socket has nothing to do.
+static ncclResult_t ncclNetSocketSockNext(struct ncclNetSocketComm* comm, int s, char** ptr, int* size, int** offset) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  *ptr = NULL;
+  if (comm->op == NCCL_SOCKET_SEND) {
+    if (ss->req == NULL) {
+      // Don't take more work while too many zero-copy completions are outstanding
+      if (ss->zcTail - ss->zcHead == NCCL_NET_SOCKET_ZC_PENDING) return ncclSuccess;
+      ncclNetSocketClaimChunk(comm, s);
+      if (ss->req == NULL) return ncclSuccess;
+    }
+  } else if (ss->hdrOffset == sizeof(struct ncclNetSocketChunkHeader) && ss->req == NULL) {
+    struct ncclNetSocketThreadResources* res = comm->threadResources+(s%comm->nThreads);
+    struct ncclNetSocketRequest* r = NULL;
+    for (int i=0; i<res->nActive; i++) {
+      if (res->active[i].seq == ss->hdr.seq && ncclNetSocketRefValid(res->active+i)) r = res->active[i].req;
+    }
+    // The matching receive has not been posted yet; leave the payload in the socket.
+    if (r == NULL) return ncclSuccess;
+    char line[SOCKET_NAME_MAXLEN+1];
+    // Check size is less or equal to the size provided by the user
+    if (ss->hdr.total > (uint32_t)r->size) {
+      WARN("NET/Socket : peer %s message truncated : receiving %u bytes instead of %d. If you believe your socket network is in healthy state, \
+          there may be a mismatch in collective sizes or environment settings (e.g. NCCL_PROTO, NCCL_ALGO) between ranks",
+          ncclSocketToString(&comm->socks[s].addr, line), ss->hdr.total, r->size);
+      return ncclInvalidUsage;
+    }
+    if (ss->hdr.offset + (uint64_t)ss->hdr.size > ss->hdr.total) {
+      WARN("NET/Socket : peer %s sent chunk [%u,%u) beyond the message size %u",
+          ncclSocketToString(&comm->socks[s].addr, line), ss->hdr.offset, ss->hdr.offset+ss->hdr.size, ss->hdr.total);
+      return ncclInternalError;
+    }
+    int msgSize = -1;
+    if (!__atomic_compare_exchange_n(&r->msgSize, &msgSize, (int)ss->hdr.total, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) && msgSize != (int)ss->hdr.total) {
+      WARN("NET/Socket : peer %s sent inconsistent message sizes %d and %u", ncclSocketToString(&comm->socks[s].addr, line), msgSize, ss->hdr.total);
+      return ncclInternalError;
+    }
+    ss->req = r;
+    ss->offset = 0;
+    if (ss->hdr.size == 0) {
+      // Empty message, nothing to receive beyond the header
+      ncclNetSocketSockAdvance(comm, s);
+    }
+  }
+  if (ss->hdrOffset < sizeof(struct ncclNetSocketChunkHeader)) {
+    *ptr = (char*)&ss->hdr;
+    *size = sizeof(struct ncclNetSocketChunkHeader);
+    *offset = &ss->hdrOffset;
+  } else {
+    *ptr = (char*)ss->req->data + ss->hdr.offset;
+    *size = ss->hdr.size;
+    *offset = &ss->offset;
+  }
+  return ncclSuccess;
+}
+
+// Called when the transfer returned by ncclNetSocketSockNext has completed.
+static void ncclNetSocketSockAdvance(struct ncclNetSocketComm* comm, int s) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  if (ss->req == NULL || ss->hdrOffset < sizeof(struct ncclNetSocketChunkHeader) || ss->offset < ss->hdr.size) return;
+  // Chunk complete
+  if (comm->op == NCCL_SOCKET_SEND) {
+    uint64_t elapsed = clockNano() - ss->chunkStart;
+    if (elapsed) {
+      uint64_t sample = ss->hdr.size * 1000000000ULL / elapsed;
+      uint64_t bw = ss->bw ? (3*ss->bw + sample) / 4 : sample;
+      __atomic_store_n(&ss->bw, bw, __ATOMIC_RELAXED);
+    }
+  }
+  ss->bytes += ss->hdr.size;
+  if (comm->op == NCCL_SOCKET_SEND && ss->zc) {
+    // The kernel still references the payload; account for it once the completion is reaped.
+    struct ncclNetSocketZcPending* p = ss->zcPending+(ss->zcTail%NCCL_NET_SOCKET_ZC_PENDING);
+    p->seq = ss->zcNext;
+    p->bytes = ss->hdr.size;
+    p->req = ss->req;
+    ss->zcTail++;
+  } else {
+    __atomic_fetch_add(&ss->req->done, ss->hdr.size, __ATOMIC_RELEASE);
+  }
+  ss->req = NULL;
+  ss->hdrOffset = 0;
+}
+
+static void ncclNetSocketSetThreadError(struct ncclNetSocketComm* comm, ncclResult_t ret) {
+  ncclResult_t expected = ncclSuccess;
+  __atomic_compare_exchange_n(&comm->threadResult, &expected, ret, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+// Receive socket s reached EOF. Between two chunks this is how the peer ends the connection at
+// teardown; within a chunk the stream was cut.
+static ncclResult_t ncclNetSocketSockClosed(struct ncclNetSocketComm* comm, int s) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  if (ss->req != NULL || ss->hdrOffset != 0) {
+    char line[SOCKET_NAME_MAXLEN+1];
+    WARN("NET/Socket : Connection closed by remote peer %s", ncclSocketToString(&comm->socks[s].addr, line, 0));
+    return ncclRemoteError;
+  }
+  ss->closed = 1;
+  ss->ready = 0;
+  __atomic_fetch_add(&comm->nClosed, 1, __ATOMIC_RELEASE);
+  return ncclSuccess;
+}
+
+// Once the peer closed all sockets, pending requests can no longer complete. Sockets only
+// report EOF after all their data was received and accounted, so read nClosed first.
+static ncclResult_t ncclNetSocketCheckClosed(struct ncclNetSocketThreadResources* res) {
+  struct ncclNetSocketComm* comm = res->comm;
+  if (__atomic_load_n(&comm->nClosed, __ATOMIC_ACQUIRE) < comm->nSocks) return ncclSuccess;
+  ncclNetSocketUpdateActive(res);
+  if (res->nActive == 0) return ncclSuccess;
+  WARN("NET/Socket : Connection closed by remote peer with %d requests pending", res->nActive);
+  return ncclRemoteError;
+}
+
+static ncclResult_t ncclNetSocketReapZeroCopy(struct ncclNetSocketComm* comm, int s, int* attempted) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  if (ss->zcReady) {
+    int copied = 0, reaped;
+    NCCLCHECK(ncclSocketReapZeroCopy(comm->socks+s, &ss->zcDone, &copied, &reaped));
+    if (copied && __atomic_exchange_n(&comm->zeroCopy, 0, __ATOMIC_RELAXED)) {
+      INFO(NCCL_NET, "NET/Socket : kernel is copying zero-copy sends, falling back to regular sends");
+    }
+    // The error queue is drained, wait for EPOLLERR to signal new completions.
+    ss->zcReady = 0;
+    if (reaped) *attempted = 1;
+  }
+  // Only account for chunks once the kernel no longer references their pages
+  while (ss->zcHead != ss->zcTail) {
+    struct ncclNetSocketZcPending* p = ss->zcPending+(ss->zcHead%NCCL_NET_SOCKET_ZC_PENDING);
+    if ((int32_t)(ss->zcDone - p->seq) < 0) break;
+    __atomic_fetch_add(&p->req->done, p->bytes, __ATOMIC_RELEASE);
+    ss->zcHead++;
+  }
+  return ncclSuccess;
+}
+
+// Drive socket s as far as it can go without blocking.
+static ncclResult_t ncclNetSocketSockProgress(struct ncclNetSocketComm* comm, int s, int* attempted) {
+  struct ncclNetSocketSockState* ss = comm->sockState+s;
+  while (ss->ready && !ss->closed) {
+    char* ptr;
+    int size;
+    int* offset;
+    NCCLCHECK(ncclNetSocketSockNext(comm, s, &ptr, &size, &offset));
+    if (ptr == NULL) break;
+    if (comm->op == NCCL_SOCKET_SEND && ss->zc && offset == &ss->offset) {
+      NCCLCHECK(ncclSocketProgressZeroCopy(comm->socks+s, ptr, size, offset, &ss->zcNext));
+    } else {
+      int closed = 0;
+      NCCLCHECK(ncclSocketProgress(comm->op, comm->socks+s, ptr, size, offset, &closed));
+      if (closed) {
+        NCCLCHECK(ncclNetSocketSockClosed(comm, s));
+        break;
+      }
+    }
+    *attempted = 1;
+    // We stopped before the end of the transfer: the socket hit EAGAIN and
+    // we need to wait for the next edge before trying again.
+    if (*offset < size) {
+      ss->ready = 0;
+      break;
+    }
+    ncclNetSocketSockAdvance(comm, s);
+  }
+  if (ss->zcHead != ss->zcTail) NCCLCHECK(ncclNetSocketReapZeroCopy(comm, s, attempted));
+  return ncclSuccess;
+}
+
+#define NCCL_NET_SOCKET_EVENTFD_ID MAX_SOCKETS
+
 void* persistentSocketThread(void *args_) {
   struct ncclNetSocketThreadResources* resource = (struct ncclNetSocketThreadResources*)args_;
   struct ncclNetSocketComm* comm = resource->comm;
-  struct ncclNetSocketTaskQueue* myQueue = &resource->threadTaskQueue;
-  int nSocksPerThread = comm->nSocks / comm->nThreads;
+  struct epoll_event events[MAX_SOCKETS+1];
   while (1) {
-    int idle = 1;
-    int mark = myQueue->next; // mark newest task seen
-    for (int i=0; i<myQueue->len; i+=nSocksPerThread) {
-      int repeat;
-      do {
-        repeat = 0;
-        for (int j=0; j<nSocksPerThread; j++) {
-          struct ncclNetSocketTask* r = myQueue->tasks+i+j;
-          if (r != NULL && r->used == 1 && r->offset < r->size) {
-            r->result = ncclSocketProgress(r->op, r->sock, r->data, r->size, &r->offset);
-            if (r->result != ncclSuccess) {
-              WARN("NET/Socket : socket progress error");
-              return NULL;
-            }
-            idle = 0;
-            if (r->offset < r->size) repeat = 1;
+    int attempted = 0;
+    ncclNetSocketUpdateActive(resource);
+    ncclResult_t ret = ncclNetSocketCheckClosed(resource);
+    for (int s=resource->tid; ret == ncclSuccess && s<comm->nSocks; s+=comm->nThreads) {
+      ret = ncclNetSocketSockProgress(comm, s, &attempted);
+    }
+    if (ret != ncclSuccess) {
+      WARN("NET/Socket : socket progress error");
+      ncclNetSocketSetThreadError(comm, ret);
+      return NULL;
+    }
+    if (__atomic_load_n(&resource->stop, __ATOMIC_ACQUIRE)) return NULL;
+    if (attempted) continue;
+
+    // Nothing can make progress: block until a socket becomes ready or a new request is posted.
+    __atomic_store_n(&resource->sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&resource->reqRing.tail, __ATOMIC_SEQ_CST) == resource->reqRing.head && __atomic_load_n(&resource->stop, __ATOMIC_SEQ_CST) == 0) {
+      int nEvents = epoll_wait(resource->epollFd, events, MAX_SOCKETS+1, -1);
+      if (nEvents == -1 && errno != EINTR) {
+        WARN("NET/Socket : epoll_wait failed : %s", strerror(errno));
+        ncclNetSocketSetThreadError(comm, ncclSystemError);
+        return NULL;
+      }
+      for (int e=0; e<nEvents; e++) {
+        uint32_t id = events[e].data.u32;
+        if (id == NCCL_NET_SOCKET_EVENTFD_ID) {
+          uint64_t count;
+          // Coalesced wakeup: one read consumes all pending signals
+          if (read(resource->eventFd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+            WARN("NET/Socket : eventfd read failed : %s", strerror(errno));
+            ncclNetSocketSetThreadError(comm, ncclSystemError);
+            return NULL;
           }
+        } else {
+          comm->sockState[id].ready = 1;
+          // Zero-copy completions are reported through the socket error queue
+          if (events[e].events & EPOLLERR) comm->sockState[id].zcReady = 1;
         }
-      } while (repeat);
+      }
+    }
+    __atomic_store_n(&resource->sleeping, 0, __ATOMIC_RELAXED);
+  }
+}
+
+// io_uring engine: each loop iteration submits the next send/recv of every idle
+// socket as a single batch and then reaps all completions.
+// New requests and stop requests are signaled through a read on the eventfd kept in flight.
+#define NCCL_NET_SOCKET_URING_EVENT 0
+#define NCCL_NET_SOCKET_URING_ENTRIES 128
+static_assert(MAX_SOCKETS+1 <= NCCL_NET_SOCKET_URING_ENTRIES, "io_uring ring too small");
+
+static ncclResult_t ncclNetSocketIoUringProgress(struct ncclNetSocketThreadResources* resource, int* eventArmed) {
+  struct ncclNetSocketComm* comm = resource->comm;
+  struct ncclIoUring* ring = &resource->ring;
+  struct ncclIoUringCqe cqes[NCCL_NET_SOCKET_URING_ENTRIES];
+  ncclNetSocketUpdateActive(resource);
+  NCCLCHECK(ncclNetSocketCheckClosed(resource));
+  if (!*eventArmed) {
+    NCCLCHECK(ncclIoUringPrepRead(ring, resource->eventFd, &resource->eventCount, sizeof(uint64_t), NCCL_NET_SOCKET_URING_EVENT));
+    *eventArmed = 1;
+  }
+  for (int s=resource->tid; s<comm->nSocks; s+=comm->nThreads) {
+    struct ncclNetSocketSockState* ss = comm->sockState+s;
+    // One operation in flight per socket keeps the stream in order
+    if (ss->busy || ss->closed) continue;
+    char* ptr;
+    int size, fd;
+    NCCLCHECK(ncclNetSocketSockNext(comm, s, &ptr, &size, &ss->xferOffset));
+    if (ptr == NULL) continue;
+    NCCLCHECK(ncclSocketGetFd(comm->socks+s, &fd));
+    ptr += *ss->xferOffset;
+    size -= *ss->xferOffset;
+    if (comm->op == NCCL_SOCKET_SEND) {
+      NCCLCHECK(ncclIoUringPrepSend(ring, fd, ptr, size, s+1));
+    } else {
+      NCCLCHECK(ncclIoUringPrepRecv(ring, fd, ptr, size, s+1));
     }
-    if (idle) {
-      pthread_mutex_lock(&resource->threadLock);
-      while (mark == myQueue->next && resource->stop == 0) { // no new tasks, wait
-        pthread_cond_wait(&resource->threadCond, &resource->threadLock);
+    ss->busy = 1;
+  }
+  if (__atomic_load_n(&resource->stop, __ATOMIC_ACQUIRE)) return ncclSuccess;
+
+  // Only block if no new request was posted since we looked for work
+  __atomic_store_n(&resource->sleeping, 1, __ATOMIC_SEQ_CST);
+  int wait = (__atomic_load_n(&resource->reqRing.tail, __ATOMIC_SEQ_CST) == resource->reqRing.head && __atomic_load_n(&resource->stop, __ATOMIC_SEQ_CST) == 0);
+  NCCLCHECK(ncclIoUringSubmit(ring, wait));
+  __atomic_store_n(&resource->sleeping, 0, __ATOMIC_RELAXED);
+
+  int nCqes;
+  do {
+    NCCLCHECK(ncclIoUringReap(ring, cqes, NCCL_NET_SOCKET_URING_ENTRIES, &nCqes));
+    for (int c=0; c<nCqes; c++) {
+      if (cqes[c].userData == NCCL_NET_SOCKET_URING_EVENT) {
+        *eventArmed = 0;
+        continue;
       }
-      pthread_mutex_unlock(&resource->threadLock);
+      int s = cqes[c].userData-1;
+      struct ncclNetSocketSockState* ss = comm->sockState+s;
+      ss->busy = 0;
+      int res = cqes[c].res;
+      if (res == -EINTR || res == -EAGAIN) continue; // Retry on next iteration
+      if (res < 0) {
+        char line[SOCKET_NAME_MAXLEN+1];
+        WARN("NET/Socket : io_uring %s on %s failed : %s", comm->op == NCCL_SOCKET_SEND ? "send" : "recv", ncclSocketToString(&comm->socks[s].addr, line), strerror(-res));
+        return ncclRemoteError;
+      }
+      if (res == 0 && comm->op == NCCL_SOCKET_RECV) {
+        NCCLCHECK(ncclNetSocketSockClosed(comm, s));
+        continue;
+      }
+      *ss->xferOffset += res;
+      ncclNetSocketSockAdvance(comm, s);
+    }
+  } while (nCqes == NCCL_NET_SOCKET_URING_ENTRIES);
+  return ncclSuccess;
+}
+
+void* persistentSocketThreadIoUring(void *args_) {
+  struct ncclNetSocketThreadResources* resource = (struct ncclNetSocketThreadResources*)args_;
+  int eventArmed = 0;
+  while (__atomic_load_n(&resource->stop, __ATOMIC_ACQUIRE) == 0) {
+    ncclResult_t ret = ncclNetSocketIoUringProgress(resource, &eventArmed);
+    if (ret != ncclSuccess) {
+      WARN("NET/Socket : socket progress error");
+      ncclNetSocketSetThreadError(resource->comm, ret);
+      return NULL;
     }
-    if (resource->stop) return NULL;
   }
+  return NULL;
+}
+
+static ncclResult_t ncclNetSocketWakeThread(struct ncclNetSocketThreadResources* res) {
+  uint64_t one = 1;
+  SYSCHECK(write(res->eventFd, &one, sizeof(one)), "write");
+  return ncclSuccess;
+}
+
+// Create the epoll instance of a helper thread and register the data sockets it owns.
+// Sockets are spread round-robin, so thread tid owns sockets tid, tid+nThreads, ...
+static ncclResult_t ncclNetSocketThreadInitEpoll(struct ncclNetSocketComm* comm, int tid) {
+  struct ncclNetSocketThreadResources* res = comm->threadResources+tid;
+  struct epoll_event ev;
+  SYSCHECKVAL(epoll_create1(EPOLL_CLOEXEC), "epoll_create1", res->epollFd);
+  SYSCHECKVAL(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC), "eventfd", res->eventFd);
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = NCCL_NET_SOCKET_EVENTFD_ID;
+  SYSCHECK(epoll_ctl(res->epollFd, EPOLL_CTL_ADD, res->eventFd, &ev), "epoll_ctl");
+  for (int s=tid; s<comm->nSocks; s+=comm->nThreads) {
+    int fd;
+    NCCLCHECK(ncclSocketGetFd(comm->socks+s, &fd));
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (comm->op == NCCL_SOCKET_SEND ? EPOLLOUT : EPOLLIN) | EPOLLET;
+    ev.data.u32 = s;
+    SYSCHECK(epoll_ctl(res->epollFd, EPOLL_CTL_ADD, fd, &ev), "epoll_ctl");
+    // Sockets start as ready; the first EAGAIN will arm the edge trigger.
+    comm->sockState[s].ready = 1;
+    comm->sockState[s].zcReady = 1;
+  }
+  return ncclSuccess;
+}
+
+static ncclResult_t ncclNetSocketStartThreads(struct ncclNetSocketComm* comm) {
+  for (int tid=0; tid<comm->nThreads; tid++) {
+    struct ncclNetSocketThreadResources* res = comm->threadResources+tid;
+    res->tid = tid;
+    res->comm = comm;
+    if (ncclNetSocketEngine == ncclNetSocketEngineIoUring) {
+      SYSCHECKVAL(eventfd(0, EFD_CLOEXEC), "eventfd", res->eventFd);
+      NCCLCHECK(ncclIoUringInit(&comm->threadResources[tid].ring, NCCL_NET_SOCKET_URING_ENTRIES));
+      pthread_create(comm->helperThread+tid, NULL, persistentSocketThreadIoUring, res);
+    } else {
+      NCCLCHECK(ncclNetSocketThreadInitEpoll(comm, tid));
+      pthread_create(comm->helperThread+tid, NULL, persistentSocketThread, res);
+    }
+    ncclSetThreadName(comm->helperThread[tid], "NCCL Sock%c%1u%2u%2u", comm->op == NCCL_SOCKET_SEND ? 'S' : 'R', comm->dev, tid, comm->cudaDev);
+  }
+  return ncclSuccess;
 }
 
 ncclResult_t ncclNetSocketGetNsockNthread(int dev, int* ns, int* nt) {
@@ -342,6 +853,17 @@ socket_send:
     NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_SEND, sock, &i, sizeof(uint8_t), &done));
     if (done == 0) return ncclSuccess;
   }
+  if (ncclParamSocketZeroCopy() && comm->nSocks > 0 && ncclNetSocketEngine == ncclNetSocketEngineEpoll) {
+    // Zero-copy is only used on data sockets progressed by helper threads.
+    // Fall back to regular sends for the whole comm if any socket refuses it.
+    comm->zeroCopy = 1;
+    for (int s=0; s<comm->nSocks; s++) {
+      int enabled;
+      NCCLCHECK(ncclSocketEnableZeroCopy(comm->socks+s, &enabled));
+      if (!enabled) comm->zeroCopy = 0;
+    }
+    INFO(NCCL_NET, "NET/Socket : zero-copy sends %s", comm->zeroCopy ? "enabled" : "not supported, using regular sends");
+  }
   *sendComm = comm;
   return ncclSuccess;
 }
@@ -400,6 +922,8 @@ socket_recv:
   return ncclSuccess;
 }
 
+static ncclResult_t ncclNetSocketPublishPending(struct ncclNetSocketComm* comm);
+
 ncclResult_t ncclNetSocketGetRequest(struct ncclNetSocketComm* comm, int op, void* data, int size, struct ncclNetSocketRequest** req) {
   for (int i=0; i<MAX_REQUESTS; i++) {
     struct ncclNetSocketRequest* r = comm->requests+i;
@@ -408,10 +932,19 @@ ncclResult_t ncclNetSocketGetRequest(struct ncclNetSocketComm* comm, int op, voi
       r->data = data;
       r->size = size;
       r->ctrlSock = &comm->ctrlSock;
-      r->used = 1;
       r->comm = comm;
-      r->nSubs = 0;
+      // Requests are matched in order on both sides
+      r->seq = comm->nextSeq++;
+      r->msgSize = (op == NCCL_SOCKET_SEND) ? size : -1;
       *req = r;
+      if (comm->nSocks > 0) {
+        // Hand the request to the helper threads right away. If they are lagging,
+        // or an older request is still waiting, ncclNetSocketTest will retry.
+        r->used = 3;
+        NCCLCHECK(ncclNetSocketPublishPending(comm));
+      } else {
+        r->used = 1;
+      }
       return ncclSuccess;
     }
   }
@@ -419,43 +952,53 @@ ncclResult_t ncclNetSocketGetRequest(struct ncclNetSocketComm* comm, int op, voi
   return ncclInternalError;
 }
 
-ncclResult_t ncclNetSocketGetTask(struct ncclNetSocketComm* comm, int op, void* data, int size, struct ncclNetSocketTask** req) {
-  int tid = comm->nextSock % comm->nThreads;
-  struct ncclNetSocketThreadResources* res = comm->threadResources+tid;
-  struct ncclNetSocketTaskQueue* queue = &res->threadTaskQueue;
-  // create helper threads and prepare per-thread task queue
-  if (queue->tasks == NULL) {
-    // each request can be divided up to nSocks tasks, and
-    // these tasks are distributed to nThreads threads,
-    // we need to make sure each thread queue has enough slots for MAX_REQUESTS
-    queue->len = MAX_REQUESTS * DIVUP(comm->nSocks, comm->nThreads);
-    NCCLCHECK(ncclCalloc(&queue->tasks, queue->len));
-    queue->next = 0;
-    res->comm = comm;
-    pthread_mutex_init(&res->threadLock, NULL);
-    pthread_cond_init(&res->threadCond, NULL);
-    pthread_create(comm->helperThread+tid, NULL, persistentSocketThread, res);
-    ncclSetThreadName(comm->helperThread[tid], "NCCL Sock%c%1u%2u%2u", op == NCCL_SOCKET_SEND ? 'S' : 'R', comm->dev, tid, comm->cudaDev);
-  }
-  struct ncclNetSocketTask* r = queue->tasks+queue->next;
-  if (r->used == 0) {
-    r->op = op;
-    r->data = data;
-    r->size = size;
-    r->sock = comm->socks + comm->nextSock;
-    r->offset = 0;
-    r->result = ncclSuccess;
-    comm->nextSock = (comm->nextSock + 1) % comm->nSocks;
-    r->used = 1;
-    *req = r;
-    pthread_mutex_lock(&res->threadLock);
-    queue->next = (queue->next+1)%queue->len;
-    pthread_cond_signal(&res->threadCond);
-    pthread_mutex_unlock(&res->threadLock);
-    return ncclSuccess;
-  }
-  WARN("NET/Socket : unable to allocate subtasks");
-  return ncclInternalError;
+// Hand a request over to the helper threads, which split it into chunks across the data sockets.
+// Every thread needs to see the request, so we only publish once all rings have room.
+static ncclResult_t ncclNetSocketPublish(struct ncclNetSocketComm* comm, struct ncclNetSocketRequest* r, int* published) {
+  *published = 0;
+  if (comm->helperThread[0] == 0) {
+    comm->op = r->op;
+    NCCLCHECK(ncclNetSocketStartThreads(comm));
+  }
+  for (int t=0; t<comm->nThreads; t++) {
+    struct ncclNetSocketRequestRing* ring = &comm->threadResources[t].reqRing;
+    if (ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == NCCL_NET_SOCKET_RING_SIZE) return ncclSuccess;
+  }
+  r->done = 0;
+  __atomic_store_n(&r->cursor, ((uint64_t)r->seq) << 32, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->used, 2, __ATOMIC_RELEASE);
+  for (int t=0; t<comm->nThreads; t++) {
+    struct ncclNetSocketThreadResources* res = comm->threadResources+t;
+    struct ncclNetSocketRequestRing* ring = &res->reqRing;
+    uint32_t tail = ring->tail;
+    ring->slots[tail%NCCL_NET_SOCKET_RING_SIZE].req = r;
+    ring->slots[tail%NCCL_NET_SOCKET_RING_SIZE].seq = r->seq;
+    __atomic_store_n(&ring->tail, tail+1, __ATOMIC_SEQ_CST);
+    // Only wake the thread on an empty to non-empty transition, and only if it is parked.
+    // The thread sets sleeping before checking the ring is empty, so one of us sees the other.
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail && __atomic_load_n(&res->sleeping, __ATOMIC_SEQ_CST)) {
+      NCCLCHECK(ncclNetSocketWakeThread(comm->threadResources+t));
+    }
+  }
+  *published = 1;
+  return ncclSuccess;
+}
+
+// Publish waiting requests strictly in seq order. Helper threads frame chunks in
+// the order requests appear in their rings and the receiver matches headers by
+// seq, so a newer request must never overtake an older one.
+static ncclResult_t ncclNetSocketPublishPending(struct ncclNetSocketComm* comm) {
+  for (;;) {
+    struct ncclNetSocketRequest* r = NULL;
+    for (int i=0; i<MAX_REQUESTS; i++) {
+      if (comm->requests[i].used == 3 && comm->requests[i].seq == comm->pubSeq) { r = comm->requests+i; break; }
+    }
+    if (r == NULL) return ncclSuccess;
+    int published;
+    NCCLCHECK(ncclNetSocketPublish(comm, r, &published));
+    if (!published) return ncclSuccess;
+    comm->pubSeq++;
+  }
 }
 
 ncclResult_t ncclNetSocketTest(void* request, int* done, int* size) {
@@ -465,7 +1008,7 @@ ncclResult_t ncclNetSocketTest(void* request, int* done, int* size) {
     WARN("NET/Socket : test called with NULL request");
     return ncclInternalError;
   }
-  if (r->used == 1) { /* try to send/recv size */
+  if (r->used == 1) { /* try to send/recv size, only needed when data goes through the control socket */
     int data = r->size;
     int offset = 0;
     NCCLCHECK(ncclSocketProgress(r->op, r->ctrlSock, &data, sizeof(int), &offset));
@@ -488,35 +1031,22 @@ ncclResult_t ncclNetSocketTest(void* request, int* done, int* size) {
     r->size = data;
     r->offset = 0;
     r->used = 2; // done exchanging size
-    // divide into subtasks
-    int chunkOffset = 0, i = 0;
-    if (r->comm->nSocks > 0) {
-      // each request can be divided up to nSocks tasks
-      int taskSize = std::max(MIN_CHUNKSIZE, DIVUP(r->size, r->comm->nSocks));
-      while (chunkOffset < r->size) {
-        int chunkSize = std::min(taskSize, r->size-chunkOffset);
-        NCCLCHECK(ncclNetSocketGetTask(r->comm, r->op, (char*)(r->data)+chunkOffset, chunkSize, r->tasks+i++));
-        chunkOffset += chunkSize;
-      }
-    }
-    r->nSubs = i;
   }
-  if (r->used == 2) { // already exchanged size
-    if (r->nSubs > 0) {
-      int nCompleted = 0;
-      for (int i=0; i<r->nSubs; i++) {
-        struct ncclNetSocketTask* sub = r->tasks[i];
-        if (sub->result != ncclSuccess) return sub->result;
-        if (sub->offset == sub->size) nCompleted++;
-      }
-      if (nCompleted == r->nSubs) {
-        if (size) *size = r->size;
+  if (r->used == 3) {
+    NCCLCHECK(ncclNetSocketPublishPending(r->comm));
+    if (r->used == 3) return ncclSuccess; /* Helper threads are lagging or an older request is waiting -- retry later */
+  }
+  if (r->used == 2) { // already exchanged size or handed to the helper threads
+    if (r->comm->nSocks > 0) {
+      ncclResult_t ret = __atomic_load_n(&r->comm->threadResult, __ATOMIC_ACQUIRE);
+      if (ret != ncclSuccess) return ret;
+      int complete = __atomic_load_n(&r->done, __ATOMIC_ACQUIRE) == __atomic_load_n(&r->msgSize, __ATOMIC_ACQUIRE);
+      // Empty sends are complete once their header has been claimed by a socket, it no longer references the request
+      if (r->op == NCCL_SOCKET_SEND && r->size == 0) complete = (__atomic_load_n(&r->cursor, __ATOMIC_ACQUIRE) & 0xffffffff) != 0;
+      if (complete) {
+        if (size) *size = r->msgSize;
         *done = 1;
         r->used = 0;
-        for (int i=0; i<r->nSubs; i++) {
-          struct ncclNetSocketTask* sub = r->tasks[i];
-          sub->used = 0;
-        }
       }
     } else { // progress request using main thread
       if (r->offset < r->size) {
@@ -572,13 +1102,16 @@ ncclResult_t ncclNetSocketClose(void* opaqueComm) {
     for (int i=0; i<comm->nThreads; i++) {
       struct ncclNetSocketThreadResources* res = comm->threadResources+i;
       if (comm->helperThread[i]) {
-        pthread_mutex_lock(&res->threadLock);
-        res->stop = 1;
-        pthread_cond_signal(&res->threadCond);
-        pthread_mutex_unlock(&res->threadLock);
+        __atomic_store_n(&res->stop, 1, __ATOMIC_SEQ_CST);
+        NCCLCHECK(ncclNetSocketWakeThread(comm->threadResources+i));
         pthread_join(comm->helperThread[i], NULL);
+        if (ncclNetSocketEngine == ncclNetSocketEngineIoUring) {
+          NCCLCHECK(ncclIoUringDestroy(&comm->threadResources[i].ring));
+        } else {
+          close(res->epollFd);
+        }
+        close(res->eventFd);
       }
-      free(res->threadTaskQueue.tasks);
     }
     int ready;
     NCCLCHECK(ncclSocketReady(&comm->ctrlSock, &ready));